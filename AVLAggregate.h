@@ -0,0 +1,123 @@
+#ifndef _AVL_AGGREGATE_H_
+#define _AVL_AGGREGATE_H_
+
+#include <limits>
+#include <type_traits>
+
+namespace avl
+{
+    /*
+    an aggregate policy describes a monoid that every node of the tree caches for its subtree:
+
+    struct Policy
+    {
+        typedef ... value_type;
+        static value_type identity();                                      // combine(identity(), x) == x
+        static value_type lift(const DATA_t &data);                        // the value of a single element
+        static value_type combine(const value_type &, const value_type &); // has to be associative
+    };
+
+    combine is always called with the values in the (in-order) order of the elements, so it doesn't have to be commutative
+    */
+
+    // the default policy, nodes don't cache anything (and don't pay any space for it)
+    struct NoAggregate
+    {
+        struct value_type
+        {
+        };
+        static value_type identity() { return value_type(); }
+        template <typename DATA_t>
+        static value_type lift(const DATA_t &) { return value_type(); }
+        static value_type combine(const value_type &, const value_type &) { return value_type(); }
+    };
+
+    template <typename T>
+    struct SumAggregate
+    {
+        typedef T value_type;
+        static value_type identity() { return T(); }
+        template <typename DATA_t>
+        static value_type lift(const DATA_t &data) { return T(data); }
+        static value_type combine(const value_type &first, const value_type &second) { return first + second; }
+    };
+
+    // assumes T has operator < and std::numeric_limits<T>
+    template <typename T>
+    struct MinAggregate
+    {
+        typedef T value_type;
+        static value_type identity() { return std::numeric_limits<T>::max(); }
+        template <typename DATA_t>
+        static value_type lift(const DATA_t &data) { return T(data); }
+        static value_type combine(const value_type &first, const value_type &second) { return (second < first) ? second : first; }
+    };
+
+    // assumes T has operator < and std::numeric_limits<T>
+    template <typename T>
+    struct MaxAggregate
+    {
+        typedef T value_type;
+        static value_type identity() { return std::numeric_limits<T>::lowest(); }
+        template <typename DATA_t>
+        static value_type lift(const DATA_t &data) { return T(data); }
+        static value_type combine(const value_type &first, const value_type &second) { return (first < second) ? second : first; }
+    };
+
+    // lift(data) combined with itself count (>= 1) times, for a key that occurs count times in a counted multiset.
+    // by doubling since combine is associative, O(log count)
+    template <typename Aggregate, typename DATA_t>
+    typename Aggregate::value_type lift_repeated(const DATA_t &data, int count)
+    {
+        typename Aggregate::value_type value = Aggregate::lift(data);
+        if (count == 1)
+        {
+            return value;
+        }
+        typename Aggregate::value_type result = Aggregate::identity();
+        for (; count > 0; count >>= 1)
+        {
+            if (count & 1)
+            {
+                result = Aggregate::combine(result, value);
+            }
+            value = Aggregate::combine(value, value);
+        }
+        return result;
+    }
+
+    // the base of the tree nodes that holds the cached aggregate of the subtree,
+    // it is empty (and adds nothing to the node) for NoAggregate
+    template <typename Aggregate, bool = std::is_same<Aggregate, NoAggregate>::value>
+    struct AggregateStorage
+    {
+        typename Aggregate::value_type __aggregate;
+
+        AggregateStorage() : __aggregate(Aggregate::identity()) {}
+
+        // count is the number of occurrences of data
+        template <typename DATA_t>
+        void updateAggregate(const DATA_t &data, const AggregateStorage *left, const AggregateStorage *right, int count = 1)
+        {
+            __aggregate = Aggregate::combine(
+                Aggregate::combine(left != nullptr ? left->__aggregate : Aggregate::identity(), lift_repeated<Aggregate>(data, count)),
+                right != nullptr ? right->__aggregate : Aggregate::identity());
+        }
+
+        static typename Aggregate::value_type aggregateOf(const AggregateStorage *node)
+        {
+            return node != nullptr ? node->__aggregate : Aggregate::identity();
+        }
+    };
+
+    template <typename Aggregate>
+    struct AggregateStorage<Aggregate, true>
+    {
+        template <typename DATA_t>
+        void updateAggregate(const DATA_t &, const AggregateStorage *, const AggregateStorage *, int = 1) {}
+
+        static typename Aggregate::value_type aggregateOf(const AggregateStorage *) { return Aggregate::identity(); }
+    };
+};
+
+#endif // _AVL_AGGREGATE_H_
@@ -0,0 +1,327 @@
+#ifndef _AVL_ALLOCATOR_H_
+#define _AVL_ALLOCATOR_H_
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace avl
+{
+    /*
+    an allocator policy is a class template over the type of object it creates:
+
+    template <typename T>
+    class Policy
+    {
+    public:
+        static constexpr bool BULK_RELEASE;  // whether release_all() frees objects without visiting them
+        template <typename... Args>
+        T *create(Args &&...args);
+        void destroy(T *object);
+        void release_all();                  // gives up the memory of the allocator (after all objects were destroyed,
+                                             // or without destroying them if BULK_RELEASE and T is trivially destructible)
+        void merge(Policy &other);           // afterwards each of the two can destroy the objects created by the other
+        bool exclusive();                    // whether no other allocator shares the memory (after merge()), only then
+                                             // may release_all() drop objects that are still alive
+        void swap(Policy &other);            // exchanges the memory (and objects) of the two allocators
+    };
+    */
+
+    // allocates every object on its own with new / delete
+    template <typename T>
+    class HeapAllocator
+    {
+    public:
+        // HeapAllocator can't drop all of its objects at once, each one has to be destroyed
+        static constexpr bool BULK_RELEASE = false;
+
+        template <typename... Args>
+        T *create(Args &&...args)
+        {
+            return new T(std::forward<Args>(args)...);
+        }
+
+        void destroy(T *object)
+        {
+            delete object;
+        }
+
+        void release_all() {}
+
+        void merge(HeapAllocator &) {}
+
+        bool exclusive() { return true; }
+
+        void swap(HeapAllocator &) {}
+    };
+
+    // hands out objects from contiguous chunks that are owned by the allocator (one allocator per tree),
+    // destroyed objects go to a free list and are reused before the chunks grow.
+    // the chunks double in size (up to MAX_CHUNK_CAPACITY objects) so small trees stay small.
+    //
+    // trees that exchange nodes (join, split, set operations) merge their allocators, after that they share
+    // one pool of chunks which is freed once none of them uses it anymore. sharing is NOT thread safe
+    template <typename T>
+    class SlabAllocator
+    {
+    public:
+        // release_all() gives all the memory back without visiting the objects,
+        // for trivially destructible objects that is a valid way to destroy them
+        static constexpr bool BULK_RELEASE = true;
+
+        SlabAllocator() : __pool(nullptr) {}
+
+        ~SlabAllocator()
+        {
+            release_all();
+        }
+
+        SlabAllocator(const SlabAllocator &) = delete;
+        SlabAllocator &operator=(const SlabAllocator &) = delete;
+
+        template <typename... Args>
+        T *create(Args &&...args)
+        {
+            Pool *pool = root();
+            if (pool == nullptr)
+            {
+                pool = __pool = new Pool();
+            }
+            Slot *slot = pool->take_slot();
+            try
+            {
+                return new (slot->__storage) T(std::forward<Args>(args)...);
+            }
+            catch (...)
+            {
+                pool->give_slot(slot);
+                throw;
+            }
+        }
+
+        void destroy(T *object)
+        {
+            object->~T();
+            root()->give_slot(reinterpret_cast<Slot *>(object));
+        }
+
+        // stops using the chunks, objects that are still alive are NOT destroyed. the chunks are freed
+        // right away unless they are shared with another allocator that still uses them
+        void release_all()
+        {
+            if (__pool != nullptr)
+            {
+                unref(__pool);
+                __pool = nullptr;
+            }
+        }
+
+        // whether the pool is used by this allocator alone. when it is shared, release_all() only lets go of it
+        // and the objects that are still alive keep their slots until every allocator let go
+        bool exclusive()
+        {
+            Pool *pool = root();
+            return pool == nullptr || pool->__references == 1;
+        }
+
+        // makes both allocators use the same pool, so each of them can destroy the objects created by the other
+        void merge(SlabAllocator &other)
+        {
+            Pool *mine = root();
+            Pool *theirs = other.root();
+            if (mine == theirs)
+            {
+                return;
+            }
+            if (mine == nullptr || theirs == nullptr)
+            {
+                SlabAllocator &empty = (mine == nullptr) ? *this : other;
+                Pool *shared = (mine == nullptr) ? theirs : mine;
+                empty.__pool = shared;
+                shared->__references++;
+                return;
+            }
+            // the chunks of their pool move into mine, their pool forwards to mine from now on
+            // (other allocators may still point to it)
+            mine->absorb(*theirs);
+            theirs->__merged_into = mine;
+            mine->__references++;
+            other.point_to(mine);
+        }
+
+        void swap(SlabAllocator &other)
+        {
+            Pool *temp = __pool;
+            __pool = other.__pool;
+            other.__pool = temp;
+        }
+
+    private:
+        static constexpr std::size_t MIN_CHUNK_CAPACITY = 32;
+        static constexpr std::size_t MAX_CHUNK_CAPACITY = 4096;
+
+        union Slot
+        {
+            Slot *__next;
+            alignas(T) unsigned char __storage[sizeof(T)];
+        };
+
+        struct Chunk
+        {
+            Chunk *__next;
+        };
+
+        // the slots of a chunk start right after its header, rounded up to the alignment of a slot
+        static constexpr std::size_t HEADER_SIZE = (sizeof(Chunk) + alignof(Slot) - 1) / alignof(Slot) * alignof(Slot);
+        static_assert(alignof(Slot) <= alignof(std::max_align_t), "over-aligned types are not supported by SlabAllocator");
+
+        // the memory shared by merged allocators, a pool that was merged into another one owns
+        // no chunks and only forwards to it (__merged_into)
+        struct Pool
+        {
+            Chunk *__chunks;
+            Chunk *__last_chunk;
+            Slot *__free_list;
+            Slot *__last_free;
+            Slot *__next_slot; // bump pointer inside the newest chunk
+            Slot *__end_slot;
+            std::size_t __next_capacity;
+            int __references;
+            Pool *__merged_into;
+
+            Pool() : __chunks(nullptr), __last_chunk(nullptr), __free_list(nullptr), __last_free(nullptr),
+                     __next_slot(nullptr), __end_slot(nullptr), __next_capacity(MIN_CHUNK_CAPACITY),
+                     __references(1), __merged_into(nullptr)
+            {
+            }
+
+            ~Pool()
+            {
+                while (__chunks != nullptr)
+                {
+                    Chunk *next = __chunks->__next;
+                    ::operator delete(__chunks);
+                    __chunks = next;
+                }
+            }
+
+            Slot *take_slot()
+            {
+                if (__free_list != nullptr)
+                {
+                    Slot *slot = __free_list;
+                    __free_list = slot->__next;
+                    if (__free_list == nullptr)
+                    {
+                        __last_free = nullptr;
+                    }
+                    return slot;
+                }
+                if (__next_slot == __end_slot)
+                {
+                    grow();
+                }
+                return __next_slot++;
+            }
+
+            void give_slot(Slot *slot)
+            {
+                slot->__next = __free_list;
+                if (__free_list == nullptr)
+                {
+                    __last_free = slot;
+                }
+                __free_list = slot;
+            }
+
+            void grow()
+            {
+                void *memory = ::operator new(HEADER_SIZE + __next_capacity * sizeof(Slot)); // beware of bad_alloc
+                Chunk *chunk = static_cast<Chunk *>(memory);
+                chunk->__next = __chunks;
+                if (__chunks == nullptr)
+                {
+                    __last_chunk = chunk;
+                }
+                __chunks = chunk;
+                __next_slot = reinterpret_cast<Slot *>(static_cast<unsigned char *>(memory) + HEADER_SIZE);
+                __end_slot = __next_slot + __next_capacity;
+                if (__next_capacity < MAX_CHUNK_CAPACITY)
+                {
+                    __next_capacity *= 2;
+                }
+            }
+
+            // takes over the chunks and the free slots of other, in O(1) plus the unused part of its newest chunk
+            void absorb(Pool &other)
+            {
+                if (other.__chunks != nullptr)
+                {
+                    if (__chunks == nullptr)
+                    {
+                        __chunks = other.__chunks;
+                    }
+                    else
+                    {
+                        __last_chunk->__next = other.__chunks;
+                    }
+                    __last_chunk = other.__last_chunk;
+                }
+                if (other.__free_list != nullptr)
+                {
+                    other.__last_free->__next = __free_list;
+                    if (__free_list == nullptr)
+                    {
+                        __last_free = other.__last_free;
+                    }
+                    __free_list = other.__free_list;
+                }
+                // the rest of their bump region is not lost, it goes to the free list
+                while (other.__next_slot != other.__end_slot)
+                {
+                    give_slot(other.__next_slot++);
+                }
+                other.__chunks = other.__last_chunk = nullptr;
+                other.__free_list = other.__last_free = nullptr;
+                other.__next_slot = other.__end_slot = nullptr;
+            }
+        };
+
+        Pool *__pool;
+
+        static void unref(Pool *pool)
+        {
+            while (pool != nullptr && --pool->__references == 0)
+            {
+                Pool *next = pool->__merged_into;
+                delete pool;
+                pool = next;
+            }
+        }
+
+        void point_to(Pool *pool)
+        {
+            pool->__references++;
+            unref(__pool);
+            __pool = pool;
+        }
+
+        // the pool that owns the memory, shortcuts pools that were merged into others
+        Pool *root()
+        {
+            if (__pool == nullptr || __pool->__merged_into == nullptr)
+            {
+                return __pool;
+            }
+            Pool *root = __pool;
+            while (root->__merged_into != nullptr)
+            {
+                root = root->__merged_into;
+            }
+            point_to(root);
+            return root;
+        }
+    };
+};
+
+#endif // _AVL_ALLOCATOR_H_
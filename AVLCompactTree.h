@@ -0,0 +1,481 @@
+#ifndef _AVL_COMPACT_TREE_H_
+#define _AVL_COMPACT_TREE_H_
+
+#include <cassert>
+#include <cstdint>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "Stack.h"
+#include "AVLUtility.h"
+
+namespace avl
+{
+    // an AVL tree with a compact node layout for large numbers of small elements: instead of an int height every
+    // node keeps a 2 bit balance factor, and instead of pointers its children are 32 bit indices into an arena
+    // (a vector of nodes) that the balance factor is packed into, so a node costs sizeof(DATA_t) + 8 bytes
+    // (rounded up to the alignment of DATA_t). it holds up to MAX_SIZE elements.
+    // removed nodes go to a free list and keep their element until the node is reused
+    template <typename DATA_t, typename Compare = ThreeWayCompare<DATA_t>>
+    class CompactTree : private CompareStorage<Compare>
+    {
+    public:
+        static constexpr std::uint32_t MAX_SIZE = (std::uint32_t(1) << 30) - 1;
+
+        CompactTree();
+        explicit CompactTree(const Compare &compare);
+
+        using CompareStorage<Compare>::comparator;
+
+        void insert(const DATA_t &data);
+        void remove(const DATA_t &data);
+
+        void clear();
+        const bool isEmpty() const;
+        const int size() const;
+
+        const DATA_t &find(const DATA_t &data) const;
+        const DATA_t &getMin() const;
+        const DATA_t &getMax() const;
+
+        // the number of bytes held by the node arena
+        std::size_t memory_usage() const;
+        static constexpr std::size_t node_size() { return sizeof(Node); }
+
+        template <typename FunctionObject>
+        void in_order_traversal(FunctionObject do_something) const
+        {
+            in_order_traversal_aux_recursive(__root, do_something);
+        }
+
+        template <typename FunctionObject>
+        void reverse_in_order_traversal(FunctionObject do_something) const
+        {
+            reverse_in_order_traversal_aux_recursive(__root, do_something);
+        }
+
+        // error classes
+        class NoSuchElementException : public std::exception
+        {
+        public:
+            const char *what() const noexcept override { return "There is no such element"; }
+        };
+        class ElementAlreadyExistsException : public std::exception
+        {
+        public:
+            const char *what() const noexcept override { return "Element already exists"; }
+        };
+
+    private:
+        typedef std::uint32_t Index;
+        static constexpr Index NIL = MAX_SIZE; // the "nullptr" of the indices
+        static constexpr Index INDEX_MASK = MAX_SIZE;
+        static constexpr int BALANCE_SHIFT = 30;
+
+        struct Node
+        {
+            DATA_t __data;
+            Index __left;  // the low 30 bits are the index of the left child, the high 2 bits hold balanceFactor() + 1
+            Index __right; // the index of the right child (the next free node while the node is on the free list)
+
+            Node(const DATA_t &data) : __data(data), __left(NIL | (Index(1) << BALANCE_SHIFT)), __right(NIL) {}
+
+            Index left() const { return __left & INDEX_MASK; }
+            Index right() const { return __right; }
+            void setLeft(Index index) { __left = (__left & ~INDEX_MASK) | index; }
+            void setRight(Index index) { __right = index; }
+
+            // the height of the left subtree minus the height of the right subtree, -1, 0 or 1
+            int balanceFactor() const { return int(__left >> BALANCE_SHIFT) - 1; }
+            void setBalanceFactor(int balance_factor)
+            {
+                assert(balance_factor >= -1 && balance_factor <= 1);
+                __left = (__left & INDEX_MASK) | (Index(balance_factor + 1) << BALANCE_SHIFT);
+            }
+        };
+
+        // an AVL tree with 2^30 nodes is less than 45 levels high
+        static constexpr int MAX_PATH_LENGTH = 48;
+
+        // the nodes from the root down and the direction taken at each of them (true is left)
+        struct Path
+        {
+            FixedStack<Index, MAX_PATH_LENGTH> __nodes;
+            FixedStack<bool, MAX_PATH_LENGTH> __went_left;
+
+            void push_back(Index node, bool went_left)
+            {
+                __nodes.push_back(node);
+                __went_left.push_back(went_left);
+            }
+        };
+
+        std::vector<Node> __nodes;
+        Index __root;
+        Index __free_list;
+        int __size;
+
+        Node &node(Index index) { return __nodes[index]; }
+        const Node &node(Index index) const { return __nodes[index]; }
+
+        Index create_node(const DATA_t &data)
+        {
+            if (__free_list != NIL)
+            {
+                Index index = __free_list;
+                __free_list = node(index).right();
+                node(index) = Node(data);
+                return index;
+            }
+            if (__nodes.size() >= MAX_SIZE)
+            {
+                throw std::length_error("CompactTree is full");
+            }
+            __nodes.push_back(Node(data)); // beware of bad_alloc
+            return Index(__nodes.size() - 1);
+        }
+
+        void destroy_node(Index index)
+        {
+            node(index).setRight(__free_list);
+            __free_list = index;
+        }
+
+        // makes child the child of the last node on the path (on the side the path went), or the root
+        void replace_child(Path &path, Index child)
+        {
+            if (path.__nodes.isEmpty())
+            {
+                __root = child;
+            }
+            else if (path.__went_left.back())
+            {
+                node(path.__nodes.back()).setLeft(child);
+            }
+            else
+            {
+                node(path.__nodes.back()).setRight(child);
+            }
+        }
+
+        // the subtree of x is too high on the left (a balance factor of +2), returns its new root.
+        // height_decreased tells whether the subtree is now lower than it was before the rotation
+        Index fix_left_heavy(Index x, bool &height_decreased)
+        {
+            Index l = node(x).left();
+            if (node(l).balanceFactor() >= 0)
+            { // left - left
+                node(x).setLeft(node(l).right());
+                node(l).setRight(x);
+                if (node(l).balanceFactor() == 1)
+                {
+                    node(x).setBalanceFactor(0);
+                    node(l).setBalanceFactor(0);
+                    height_decreased = true;
+                }
+                else
+                { // only possible after a removal
+                    node(x).setBalanceFactor(1);
+                    node(l).setBalanceFactor(-1);
+                    height_decreased = false;
+                }
+                return l;
+            }
+            // left - right
+            Index lr = node(l).right();
+            int lr_balance = node(lr).balanceFactor();
+            node(l).setRight(node(lr).left());
+            node(x).setLeft(node(lr).right());
+            node(lr).setLeft(l);
+            node(lr).setRight(x);
+            node(x).setBalanceFactor(lr_balance == 1 ? -1 : 0);
+            node(l).setBalanceFactor(lr_balance == -1 ? 1 : 0);
+            node(lr).setBalanceFactor(0);
+            height_decreased = true;
+            return lr;
+        }
+
+        // the mirror image of fix_left_heavy (a balance factor of -2)
+        Index fix_right_heavy(Index x, bool &height_decreased)
+        {
+            Index r = node(x).right();
+            if (node(r).balanceFactor() <= 0)
+            { // right - right
+                node(x).setRight(node(r).left());
+                node(r).setLeft(x);
+                if (node(r).balanceFactor() == -1)
+                {
+                    node(x).setBalanceFactor(0);
+                    node(r).setBalanceFactor(0);
+                    height_decreased = true;
+                }
+                else
+                { // only possible after a removal
+                    node(x).setBalanceFactor(-1);
+                    node(r).setBalanceFactor(1);
+                    height_decreased = false;
+                }
+                return r;
+            }
+            // right - left
+            Index rl = node(r).left();
+            int rl_balance = node(rl).balanceFactor();
+            node(r).setLeft(node(rl).right());
+            node(x).setRight(node(rl).left());
+            node(rl).setRight(r);
+            node(rl).setLeft(x);
+            node(x).setBalanceFactor(rl_balance == -1 ? 1 : 0);
+            node(r).setBalanceFactor(rl_balance == 1 ? -1 : 0);
+            node(rl).setBalanceFactor(0);
+            height_decreased = true;
+            return rl;
+        }
+
+        // the subtree below the last node of the path grew by one level, walks up until the growth is absorbed
+        void retrace_insert(Path &path)
+        {
+            while (!path.__nodes.isEmpty())
+            {
+                Index parent = path.__nodes.back();
+                bool went_left = path.__went_left.back();
+                path.__nodes.pop_back();
+                path.__went_left.pop_back();
+
+                int balance_factor = node(parent).balanceFactor() + (went_left ? 1 : -1);
+                if (balance_factor == 0)
+                {
+                    node(parent).setBalanceFactor(0);
+                    return;
+                }
+                if (balance_factor == 1 || balance_factor == -1)
+                {
+                    node(parent).setBalanceFactor(balance_factor);
+                    continue;
+                }
+                // after an insertion a rotation always restores the previous height
+                bool height_decreased = false;
+                replace_child(path, went_left ? fix_left_heavy(parent, height_decreased) : fix_right_heavy(parent, height_decreased));
+                return;
+            }
+        }
+
+        // the subtree below the last node of the path shrank by one level, walks up until the change is absorbed
+        void retrace_remove(Path &path)
+        {
+            while (!path.__nodes.isEmpty())
+            {
+                Index parent = path.__nodes.back();
+                bool went_left = path.__went_left.back();
+                path.__nodes.pop_back();
+                path.__went_left.pop_back();
+
+                int balance_factor = node(parent).balanceFactor() + (went_left ? -1 : 1);
+                if (balance_factor == 1 || balance_factor == -1)
+                {
+                    node(parent).setBalanceFactor(balance_factor);
+                    return;
+                }
+                if (balance_factor == 0)
+                {
+                    node(parent).setBalanceFactor(0);
+                    continue;
+                }
+                bool height_decreased = false;
+                replace_child(path, balance_factor == 2 ? fix_left_heavy(parent, height_decreased) : fix_right_heavy(parent, height_decreased));
+                if (!height_decreased)
+                {
+                    return;
+                }
+            }
+        }
+
+        Index find_index(const DATA_t &data) const
+        {
+            Index temp = __root;
+            while (temp != NIL)
+            {
+                Comparison result = three_way(comparator(), data, node(temp).__data);
+                if (result == Comparison::less)
+                {
+                    temp = node(temp).left();
+                }
+                else if (result == Comparison::greater)
+                {
+                    temp = node(temp).right();
+                }
+                else
+                {
+                    return temp;
+                }
+            }
+            return NIL;
+        }
+
+        template <typename FunctionObject>
+        void in_order_traversal_aux_recursive(Index root, FunctionObject &do_something) const
+        {
+            if (root == NIL)
+            {
+                return;
+            }
+            in_order_traversal_aux_recursive(node(root).left(), do_something);
+            do_something(node(root).__data);
+            in_order_traversal_aux_recursive(node(root).right(), do_something);
+        }
+
+        template <typename FunctionObject>
+        void reverse_in_order_traversal_aux_recursive(Index root, FunctionObject &do_something) const
+        {
+            if (root == NIL)
+            {
+                return;
+            }
+            reverse_in_order_traversal_aux_recursive(node(root).right(), do_something);
+            do_something(node(root).__data);
+            reverse_in_order_traversal_aux_recursive(node(root).left(), do_something);
+        }
+    };
+
+    template <typename DATA_t, typename Compare>
+    CompactTree<DATA_t, Compare>::CompactTree() : CompactTree(Compare())
+    {
+    }
+
+    template <typename DATA_t, typename Compare>
+    CompactTree<DATA_t, Compare>::CompactTree(const Compare &compare) : CompareStorage<Compare>(compare), __root(NIL), __free_list(NIL), __size(0)
+    {
+    }
+
+    template <typename DATA_t, typename Compare>
+    void CompactTree<DATA_t, Compare>::insert(const DATA_t &data)
+    {
+        Path path;
+        Index temp = __root;
+        while (temp != NIL)
+        {
+            Comparison result = three_way(comparator(), data, node(temp).__data);
+            if (result == Comparison::equal)
+            {
+                throw ElementAlreadyExistsException();
+            }
+            bool went_left = (result == Comparison::less);
+            path.push_back(temp, went_left);
+            temp = went_left ? node(temp).left() : node(temp).right();
+        }
+        replace_child(path, create_node(data));
+        __size++;
+        retrace_insert(path);
+    }
+
+    template <typename DATA_t, typename Compare>
+    void CompactTree<DATA_t, Compare>::remove(const DATA_t &data)
+    {
+        Path path;
+        Index temp = __root;
+        while (temp != NIL)
+        {
+            Comparison result = three_way(comparator(), data, node(temp).__data);
+            if (result == Comparison::equal)
+            {
+                break;
+            }
+            bool went_left = (result == Comparison::less);
+            path.push_back(temp, went_left);
+            temp = went_left ? node(temp).left() : node(temp).right();
+        }
+        if (temp == NIL)
+        {
+            throw NoSuchElementException();
+        }
+
+        if (node(temp).left() != NIL && node(temp).right() != NIL)
+        { // the successor's data moves into this node and the successor's node is removed instead
+            Index target = temp;
+            path.push_back(temp, false);
+            temp = node(temp).right();
+            while (node(temp).left() != NIL)
+            {
+                path.push_back(temp, true);
+                temp = node(temp).left();
+            }
+            std::swap(node(target).__data, node(temp).__data);
+        }
+        // temp has at most one child
+        replace_child(path, node(temp).left() != NIL ? node(temp).left() : node(temp).right());
+        destroy_node(temp);
+        __size--;
+        retrace_remove(path);
+    }
+
+    template <typename DATA_t, typename Compare>
+    void CompactTree<DATA_t, Compare>::clear()
+    {
+        __nodes.clear();
+        __root = NIL;
+        __free_list = NIL;
+        __size = 0;
+    }
+
+    template <typename DATA_t, typename Compare>
+    const bool CompactTree<DATA_t, Compare>::isEmpty() const
+    {
+        return (__root == NIL);
+    }
+
+    template <typename DATA_t, typename Compare>
+    const int CompactTree<DATA_t, Compare>::size() const
+    {
+        return __size;
+    }
+
+    template <typename DATA_t, typename Compare>
+    const DATA_t &CompactTree<DATA_t, Compare>::find(const DATA_t &data) const
+    {
+        Index index = find_index(data);
+        if (index == NIL)
+        {
+            throw NoSuchElementException();
+        }
+        return node(index).__data;
+    }
+
+    template <typename DATA_t, typename Compare>
+    const DATA_t &CompactTree<DATA_t, Compare>::getMin() const
+    {
+        if (__root == NIL)
+        {
+            throw NoSuchElementException();
+        }
+        Index temp = __root;
+        while (node(temp).left() != NIL)
+        {
+            temp = node(temp).left();
+        }
+        return node(temp).__data;
+    }
+
+    template <typename DATA_t, typename Compare>
+    const DATA_t &CompactTree<DATA_t, Compare>::getMax() const
+    {
+        if (__root == NIL)
+        {
+            throw NoSuchElementException();
+        }
+        Index temp = __root;
+        while (node(temp).right() != NIL)
+        {
+            temp = node(temp).right();
+        }
+        return node(temp).__data;
+    }
+
+    template <typename DATA_t, typename Compare>
+    std::size_t CompactTree<DATA_t, Compare>::memory_usage() const
+    {
+        return __nodes.capacity() * sizeof(Node);
+    }
+};
+
+#endif // _AVL_COMPACT_TREE_H_
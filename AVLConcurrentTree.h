@@ -0,0 +1,1110 @@
+#ifndef _AVL_CONCURRENT_TREE_H_
+#define _AVL_CONCURRENT_TREE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <type_traits>
+
+#include "AVLEpoch.h"
+#include "AVLParallel.h"
+#include "AVLStats.h"
+#include "AVLUtility.h"
+#include "Stack.h"
+
+namespace avl
+{
+    // an AVL tree that any number of threads read and write at once, after the optimistic relaxed balance tree of
+    // Bronson, Casper, Chafi and Olukotun (A Practical Concurrent Binary Search Tree, PPoPP 2010):
+    //  - readers take no locks: every node carries a version that a rotation changes before it moves the node down
+    //    (which is when a search could miss a key below it), and a search checks the version of the node it comes
+    //    from after reading the link to the next one, going back up one level when it changed
+    //  - writers lock only the nodes they change, parents before children. a removed element whose node has two
+    //    children stays in the tree as a routing node (without an element) and is unlinked once it has one child,
+    //    or replaced by a new node with the element when an equal one is inserted
+    //  - every write repairs the heights and the balance on its way up, one node at a time with the same single and
+    //    double rotations as Tree, so the tree is an AVL tree again whenever no write is under way
+    //  - unlinked nodes are destroyed through the epochs of EpochDomain (see AVLEpoch.h), once no search can
+    //    reach them anymore
+    // every operation is linearizable except size() and the traversals
+    template <typename DATA_t, typename Compare = ThreeWayCompare<DATA_t>>
+    class ConcurrentTree : private CompareStorage<Compare>
+    {
+    public:
+        ConcurrentTree();
+        explicit ConcurrentTree(const Compare &compare);
+        ~ConcurrentTree();
+        ConcurrentTree(const ConcurrentTree &) = delete;
+        ConcurrentTree &operator=(const ConcurrentTree &) = delete;
+
+        using CompareStorage<Compare>::comparator;
+
+        void insert(const DATA_t &data);
+        void remove(const DATA_t &data);
+        // the same without exceptions, they return whether the element was inserted or erased
+        bool try_insert(const DATA_t &data) { return update(data, true); }
+        bool try_erase(const DATA_t &data) { return update(data, false); }
+        bool contains(const DATA_t &data) const;
+
+        // the number of elements, exact only while no other thread writes
+        int size() const { return int(__size.get()); }
+        bool isEmpty() const { return size() == 0; }
+        // removes every element, while no other thread uses the tree
+        void clear();
+
+        // calls do_something on the elements in order, by searching the next element after the last one visited
+        // (O(log n) each). the elements that stay in the tree during the traversal are all visited, those inserted
+        // or removed meanwhile may or may not be. no node is destroyed until it returns, so keep it short
+        template <typename FunctionObject>
+        void in_order_traversal(FunctionObject do_something) const;
+
+        // the shape of the tree while no other thread writes, the routing nodes count as nodes (but not in size)
+        TreeShapeReport tree_shape_report() const;
+
+        // error classes
+        class NoSuchElementException : public std::exception
+        {
+        public:
+            const char *what() const noexcept override { return "There is no such element"; }
+        };
+        class ElementAlreadyExistsException : public std::exception
+        {
+        public:
+            const char *what() const noexcept override { return "Element already exists"; }
+        };
+
+    private:
+        // the bits of the versions: the node was unlinked (for good), the node is being moved down by a rotation,
+        // and the count of the rotations that moved it down
+        static constexpr unsigned long long UNLINKED = 1;
+        static constexpr unsigned long long SHRINKING = 2;
+        static constexpr unsigned long long SHRINK_COUNT = 4;
+        // how many times a reader checks a shrinking node before it waits for the lock of the rotation
+        static constexpr int SPIN_COUNT = 100;
+        // how many parents of rotations a repair remembers to check again, more are left to later repairs
+        static constexpr int PENDING_CAPACITY = 32;
+
+        // the results of the attempts, RETRY goes back up one level
+        enum Result
+        {
+            NO = 0,
+            YES = 1,
+            RETRY = 2
+        };
+        // what a node needs, besides a new height (node_condition() returns that otherwise)
+        static constexpr int UNLINK_REQUIRED = -1;
+        static constexpr int REBALANCE_REQUIRED = -2;
+        static constexpr int NOTHING_REQUIRED = -3;
+
+        struct Node
+        {
+            std::atomic<Node *> __left, __right, __parent;
+            std::atomic<unsigned long long> __version;
+            std::atomic<int> __height; // 0 for an empty subtree, 1 for a leaf
+            std::atomic<bool> __present; // false for a routing node
+            SpinLock __lock;
+            // the element, constructed for every node but the holder
+            typename std::aligned_storage<sizeof(DATA_t), alignof(DATA_t)>::type __storage;
+
+            explicit Node(Node *parent) : __left(nullptr), __right(nullptr), __parent(parent), __version(0), __height(1), __present(true) {}
+
+            const DATA_t &data() const { return *reinterpret_cast<const DATA_t *>(&__storage); }
+
+            std::atomic<Node *> &child(bool right) { return right ? __right : __left; }
+        };
+
+        // the holder of the root (its right child), it has no element and no parent
+        Node *__holder;
+        StripedCounter __size;
+
+        Comparison compare(const DATA_t &left, const DATA_t &right) const { return three_way(comparator(), left, right); }
+
+        static Node *create_node(const DATA_t &data, Node *parent)
+        {
+            Node *node = new Node(parent);
+            try
+            {
+                new (&node->__storage) DATA_t(data);
+            }
+            catch (...)
+            {
+                delete node;
+                throw;
+            }
+            return node;
+        }
+
+        static void destroy_node(void *pointer)
+        {
+            Node *node = static_cast<Node *>(pointer);
+            node->data().~DATA_t();
+            delete node;
+        }
+
+        static void destroy_subtree(Node *node);
+
+        static int height(const Node *node) { return (node == nullptr) ? 0 : node->__height.load(std::memory_order_acquire); }
+        static bool is_changing(unsigned long long version) { return (version & (UNLINKED | SHRINKING)) != 0; }
+        static bool is_unlinked(const Node *node) { return (node->__version.load(std::memory_order_acquire) & UNLINKED) != 0; }
+        static void wait_until_not_changing(Node *node);
+
+        // the searches, from node (whose version was node_version) down the side of key
+        Result attempt_get(const DATA_t &key, Node *node, bool right, unsigned long long node_version) const;
+        // the first element after key (the first one if key is nullptr) in the subtree of node
+        Result attempt_next(const DATA_t *key, Node *node, unsigned long long node_version, const Node *&next) const;
+        Result attempt_next_child(const DATA_t *key, Node *node, bool right, unsigned long long node_version, const Node *&next) const;
+        const Node *next_node(const DATA_t *key) const;
+
+        bool update(const DATA_t &key, bool insert);
+        Result attempt_update(const DATA_t &key, bool insert, Node *parent, Node *node, unsigned long long node_version);
+        Result attempt_node_update(const DATA_t &key, bool insert, Node *parent, Node *node);
+        Result attempt_revive(Node *parent, Node *node, Node *revived);
+        // the functions that end with _nl expect the caller to hold the locks of the nodes they change
+        bool attempt_unlink_nl(Node *parent, Node *node);
+        bool attempt_replace_nl(Node *parent, Node *node, Node *replacement);
+
+        // the balancing, the functions return the next node to repair (nullptr when done)
+        static int node_condition(Node *node);
+        void fix_height_and_rebalance(Node *node);
+        Node *fix_height_nl(Node *node);
+        Node *rebalance_nl(Node *parent, Node *node);
+        Node *rebalance_to_right_nl(Node *parent, Node *node, Node *left, int right_height);
+        Node *rebalance_to_left_nl(Node *parent, Node *node, Node *right, int left_height);
+        Node *rotate_right_nl(Node *parent, Node *node, Node *left, int right_height, int left_left_height, Node *left_right, int left_right_height);
+        Node *rotate_left_nl(Node *parent, Node *node, int left_height, Node *right, Node *right_left, int right_left_height, int right_right_height);
+        Node *rotate_right_over_left_nl(Node *parent, Node *node, Node *left, int right_height, int left_left_height, Node *left_right, int left_right_left_height);
+        Node *rotate_left_over_right_nl(Node *parent, Node *node, int left_height, Node *right, Node *right_left, int right_right_height, int right_left_right_height);
+
+        int shape_aux(const Node *node, int depth, TreeShapeReport &report, long long &depths) const;
+    };
+
+    template <typename DATA_t, typename Compare>
+    ConcurrentTree<DATA_t, Compare>::ConcurrentTree() : ConcurrentTree(Compare()) {}
+
+    template <typename DATA_t, typename Compare>
+    ConcurrentTree<DATA_t, Compare>::ConcurrentTree(const Compare &compare) : CompareStorage<Compare>(compare), __holder(new Node(nullptr))
+    {
+        __holder->__present.store(false, std::memory_order_relaxed);
+    }
+
+    template <typename DATA_t, typename Compare>
+    ConcurrentTree<DATA_t, Compare>::~ConcurrentTree()
+    {
+        destroy_subtree(__holder->__right.load(std::memory_order_acquire));
+        delete __holder;
+    }
+
+    template <typename DATA_t, typename Compare>
+    void ConcurrentTree<DATA_t, Compare>::destroy_subtree(Node *node)
+    {
+        while (node != nullptr)
+        {
+            destroy_subtree(node->__left.load(std::memory_order_relaxed));
+            Node *right = node->__right.load(std::memory_order_relaxed);
+            destroy_node(node);
+            node = right;
+        }
+    }
+
+    template <typename DATA_t, typename Compare>
+    void ConcurrentTree<DATA_t, Compare>::clear()
+    {
+        destroy_subtree(__holder->__right.exchange(nullptr));
+        __size.reset();
+    }
+
+    template <typename DATA_t, typename Compare>
+    void ConcurrentTree<DATA_t, Compare>::insert(const DATA_t &data)
+    {
+        if (!try_insert(data))
+        {
+            throw ElementAlreadyExistsException();
+        }
+    }
+
+    template <typename DATA_t, typename Compare>
+    void ConcurrentTree<DATA_t, Compare>::remove(const DATA_t &data)
+    {
+        if (!try_erase(data))
+        {
+            throw NoSuchElementException();
+        }
+    }
+
+    template <typename DATA_t, typename Compare>
+    void ConcurrentTree<DATA_t, Compare>::wait_until_not_changing(Node *node)
+    {
+        unsigned long long version = node->__version.load(std::memory_order_acquire);
+        if ((version & SHRINKING) != 0)
+        {
+            for (int i = 0; i < SPIN_COUNT && node->__version.load(std::memory_order_acquire) == version; i++)
+            {
+            }
+            if (node->__version.load(std::memory_order_acquire) == version)
+            {
+                // the rotation holds the lock of the node until it's done
+                node->__lock.lock();
+                node->__lock.unlock();
+            }
+        }
+    }
+
+    template <typename DATA_t, typename Compare>
+    bool ConcurrentTree<DATA_t, Compare>::contains(const DATA_t &data) const
+    {
+        EpochGuard guard;
+        for (;;)
+        {
+            Node *root = __holder->__right.load(std::memory_order_acquire);
+            if (root == nullptr)
+            {
+                return false;
+            }
+            Comparison result = compare(data, root->data());
+            if (result == Comparison::equal)
+            {
+                return root->__present.load(std::memory_order_acquire);
+            }
+            unsigned long long version = root->__version.load(std::memory_order_acquire);
+            if (is_changing(version))
+            {
+                wait_until_not_changing(root);
+            }
+            else if (root == __holder->__right.load(std::memory_order_acquire))
+            {
+                Result found = attempt_get(data, root, result == Comparison::greater, version);
+                if (found != RETRY)
+                {
+                    return found == YES;
+                }
+            }
+        }
+    }
+
+    template <typename DATA_t, typename Compare>
+    typename ConcurrentTree<DATA_t, Compare>::Result ConcurrentTree<DATA_t, Compare>::attempt_get(const DATA_t &key, Node *node, bool right, unsigned long long node_version) const
+    {
+        for (;;)
+        {
+            Node *child = node->child(right).load(std::memory_order_acquire);
+            // the link is valid if the node didn't move down since the version was read
+            if (node->__version.load(std::memory_order_acquire) != node_version)
+            {
+                return RETRY;
+            }
+            if (child == nullptr)
+            {
+                return NO;
+            }
+            Comparison result = compare(key, child->data());
+            if (result == Comparison::equal)
+            {
+                return child->__present.load(std::memory_order_acquire) ? YES : NO;
+            }
+            unsigned long long child_version = child->__version.load(std::memory_order_acquire);
+            if (is_changing(child_version))
+            {
+                wait_until_not_changing(child);
+            }
+            else if (child == node->child(right).load(std::memory_order_acquire))
+            {
+                if (node->__version.load(std::memory_order_acquire) != node_version)
+                {
+                    return RETRY;
+                }
+                Result found = attempt_get(key, child, result == Comparison::greater, child_version);
+                if (found != RETRY)
+                {
+                    return found;
+                }
+            }
+            if (node->__version.load(std::memory_order_acquire) != node_version)
+            {
+                return RETRY;
+            }
+        }
+    }
+
+    template <typename DATA_t, typename Compare>
+    template <typename FunctionObject>
+    void ConcurrentTree<DATA_t, Compare>::in_order_traversal(FunctionObject do_something) const
+    {
+        EpochGuard guard;
+        for (const Node *node = next_node(nullptr); node != nullptr; node = next_node(&node->data()))
+        {
+            do_something(node->data());
+        }
+    }
+
+    template <typename DATA_t, typename Compare>
+    const typename ConcurrentTree<DATA_t, Compare>::Node *ConcurrentTree<DATA_t, Compare>::next_node(const DATA_t *key) const
+    {
+        for (;;)
+        {
+            Node *root = __holder->__right.load(std::memory_order_acquire);
+            if (root == nullptr)
+            {
+                return nullptr;
+            }
+            unsigned long long version = root->__version.load(std::memory_order_acquire);
+            if (is_changing(version))
+            {
+                wait_until_not_changing(root);
+            }
+            else if (root == __holder->__right.load(std::memory_order_acquire))
+            {
+                const Node *next = nullptr;
+                if (attempt_next(key, root, version, next) != RETRY)
+                {
+                    return next;
+                }
+            }
+        }
+    }
+
+    template <typename DATA_t, typename Compare>
+    typename ConcurrentTree<DATA_t, Compare>::Result ConcurrentTree<DATA_t, Compare>::attempt_next(const DATA_t *key, Node *node, unsigned long long node_version, const Node *&next) const
+    {
+        if (key != nullptr && compare(*key, node->data()) != Comparison::less)
+        {
+            return attempt_next_child(key, node, true, node_version, next);
+        }
+        // the left subtree first, then the node, then the smallest element of the right subtree
+        Result found = attempt_next_child(key, node, false, node_version, next);
+        if (found != NO)
+        {
+            return found;
+        }
+        if (node->__present.load(std::memory_order_acquire))
+        {
+            next = node;
+            return YES;
+        }
+        // bounded by the node rather than searching for the smallest element: a node of the right subtree can move
+        // up above this one meanwhile, with this one in its left subtree
+        return attempt_next_child(&node->data(), node, true, node_version, next);
+    }
+
+    template <typename DATA_t, typename Compare>
+    typename ConcurrentTree<DATA_t, Compare>::Result ConcurrentTree<DATA_t, Compare>::attempt_next_child(const DATA_t *key, Node *node, bool right, unsigned long long node_version, const Node *&next) const
+    {
+        for (;;)
+        {
+            Node *child = node->child(right).load(std::memory_order_acquire);
+            if (node->__version.load(std::memory_order_acquire) != node_version)
+            {
+                return RETRY;
+            }
+            if (child == nullptr)
+            {
+                return NO;
+            }
+            unsigned long long child_version = child->__version.load(std::memory_order_acquire);
+            if (is_changing(child_version))
+            {
+                wait_until_not_changing(child);
+            }
+            else if (child == node->child(right).load(std::memory_order_acquire))
+            {
+                if (node->__version.load(std::memory_order_acquire) != node_version)
+                {
+                    return RETRY;
+                }
+                Result found = attempt_next(key, child, child_version, next);
+                // nothing in the subtree counts only if the node didn't move down while it was searched
+                if (found == YES || (found == NO && node->__version.load(std::memory_order_acquire) == node_version))
+                {
+                    return found;
+                }
+            }
+            if (node->__version.load(std::memory_order_acquire) != node_version)
+            {
+                return RETRY;
+            }
+        }
+    }
+
+    template <typename DATA_t, typename Compare>
+    bool ConcurrentTree<DATA_t, Compare>::update(const DATA_t &key, bool insert)
+    {
+        EpochGuard guard;
+        for (;;)
+        {
+            Node *root = __holder->__right.load(std::memory_order_acquire);
+            if (root == nullptr)
+            {
+                if (!insert)
+                {
+                    return false;
+                }
+                std::lock_guard<SpinLock> lock(__holder->__lock);
+                if (__holder->__right.load(std::memory_order_relaxed) == nullptr)
+                {
+                    __holder->__right.store(create_node(key, __holder), std::memory_order_release);
+                    __size.add(1);
+                    return true;
+                }
+            }
+            else
+            {
+                unsigned long long version = root->__version.load(std::memory_order_acquire);
+                if (is_changing(version))
+                {
+                    wait_until_not_changing(root);
+                }
+                else if (root == __holder->__right.load(std::memory_order_acquire))
+                {
+                    Result updated = attempt_update(key, insert, __holder, root, version);
+                    if (updated != RETRY)
+                    {
+                        return updated == YES;
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename DATA_t, typename Compare>
+    typename ConcurrentTree<DATA_t, Compare>::Result ConcurrentTree<DATA_t, Compare>::attempt_update(const DATA_t &key, bool insert, Node *parent, Node *node, unsigned long long node_version)
+    {
+        Comparison result = compare(key, node->data());
+        if (result == Comparison::equal)
+        {
+            return attempt_node_update(key, insert, parent, node);
+        }
+        bool right = (result == Comparison::greater);
+        for (;;)
+        {
+            Node *child = node->child(right).load(std::memory_order_acquire);
+            if (node->__version.load(std::memory_order_acquire) != node_version)
+            {
+                return RETRY;
+            }
+            if (child == nullptr)
+            {
+                if (!insert)
+                {
+                    return NO;
+                }
+                Node *damaged;
+                {
+                    std::lock_guard<SpinLock> lock(node->__lock);
+                    if (node->__version.load(std::memory_order_relaxed) != node_version)
+                    {
+                        return RETRY;
+                    }
+                    if (node->child(right).load(std::memory_order_relaxed) != nullptr)
+                    {
+                        // another thread inserted there first
+                        continue;
+                    }
+                    node->child(right).store(create_node(key, node), std::memory_order_release);
+                    damaged = fix_height_nl(node);
+                }
+                __size.add(1);
+                fix_height_and_rebalance(damaged);
+                return YES;
+            }
+            unsigned long long child_version = child->__version.load(std::memory_order_acquire);
+            if (is_changing(child_version))
+            {
+                wait_until_not_changing(child);
+            }
+            else if (child == node->child(right).load(std::memory_order_acquire))
+            {
+                if (node->__version.load(std::memory_order_acquire) != node_version)
+                {
+                    return RETRY;
+                }
+                Result updated = attempt_update(key, insert, node, child, child_version);
+                if (updated != RETRY)
+                {
+                    return updated;
+                }
+            }
+        }
+    }
+
+    template <typename DATA_t, typename Compare>
+    typename ConcurrentTree<DATA_t, Compare>::Result ConcurrentTree<DATA_t, Compare>::attempt_node_update(const DATA_t &key, bool insert, Node *parent, Node *node)
+    {
+        if (insert)
+        {
+            if (node->__present.load(std::memory_order_acquire))
+            {
+                return NO;
+            }
+            // a routing node gets an element again, in a new node that takes its place: the old element compares
+            // equal to key but may differ from it, and the searches read it without locks
+            Node *revived = create_node(key, parent); // beware of bad_alloc
+            Result result = attempt_revive(parent, node, revived);
+            if (result != YES)
+            {
+                destroy_node(revived);
+                return result;
+            }
+            __size.add(1);
+            // a repair that reached the old node stopped there
+            fix_height_and_rebalance(revived);
+            return YES;
+        }
+        if (!node->__present.load(std::memory_order_acquire))
+        {
+            return NO;
+        }
+        if (node->__left.load(std::memory_order_acquire) == nullptr || node->__right.load(std::memory_order_acquire) == nullptr)
+        {
+            // the node can go, which changes its parent as well
+            Node *damaged;
+            {
+                std::lock_guard<SpinLock> parent_lock(parent->__lock);
+                if (is_unlinked(parent) || node->__parent.load(std::memory_order_relaxed) != parent)
+                {
+                    return RETRY;
+                }
+                std::lock_guard<SpinLock> lock(node->__lock);
+                if (!node->__present.load(std::memory_order_relaxed))
+                {
+                    return NO;
+                }
+                if (!attempt_unlink_nl(parent, node))
+                {
+                    return RETRY;
+                }
+                damaged = fix_height_nl(parent);
+            }
+            __size.add(-1);
+            fix_height_and_rebalance(damaged);
+            return YES;
+        }
+        std::lock_guard<SpinLock> lock(node->__lock);
+        if (is_unlinked(node))
+        {
+            return RETRY;
+        }
+        if (!node->__present.load(std::memory_order_relaxed))
+        {
+            return NO;
+        }
+        if (node->__left.load(std::memory_order_relaxed) == nullptr || node->__right.load(std::memory_order_relaxed) == nullptr)
+        {
+            // it lost a child meanwhile, it can be unlinked after all
+            return RETRY;
+        }
+        node->__present.store(false, std::memory_order_release);
+        __size.add(-1);
+        return YES;
+    }
+
+    template <typename DATA_t, typename Compare>
+    typename ConcurrentTree<DATA_t, Compare>::Result ConcurrentTree<DATA_t, Compare>::attempt_revive(Node *parent, Node *node, Node *revived)
+    {
+        std::lock_guard<SpinLock> parent_lock(parent->__lock);
+        if (is_unlinked(parent) || node->__parent.load(std::memory_order_relaxed) != parent)
+        {
+            return RETRY;
+        }
+        std::lock_guard<SpinLock> lock(node->__lock);
+        if (is_unlinked(node))
+        {
+            return RETRY;
+        }
+        if (node->__present.load(std::memory_order_relaxed))
+        {
+            return NO;
+        }
+        return attempt_replace_nl(parent, node, revived) ? YES : RETRY;
+    }
+
+    template <typename DATA_t, typename Compare>
+    bool ConcurrentTree<DATA_t, Compare>::attempt_replace_nl(Node *parent, Node *node, Node *replacement)
+    {
+        Node *parent_left = parent->__left.load(std::memory_order_relaxed);
+        if (parent_left != node && parent->__right.load(std::memory_order_relaxed) != node)
+        {
+            return false;
+        }
+        Node *left = node->__left.load(std::memory_order_relaxed);
+        Node *right = node->__right.load(std::memory_order_relaxed);
+        replacement->__left.store(left, std::memory_order_relaxed);
+        replacement->__right.store(right, std::memory_order_relaxed);
+        replacement->__height.store(node->__height.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        if (left != nullptr)
+        {
+            left->__parent.store(replacement, std::memory_order_release);
+        }
+        if (right != nullptr)
+        {
+            right->__parent.store(replacement, std::memory_order_release);
+        }
+        (parent_left == node ? parent->__left : parent->__right).store(replacement, std::memory_order_release);
+        node->__version.store(UNLINKED, std::memory_order_release);
+        // after the version, so that the searches that read a child of the old node afterwards go back up. without
+        // children it is an unlinked routing node like the others for the repairs that still hold it
+        node->__left.store(nullptr, std::memory_order_release);
+        node->__right.store(nullptr, std::memory_order_release);
+        EpochDomain::instance().retire(node, &destroy_node);
+        return true;
+    }
+
+    template <typename DATA_t, typename Compare>
+    bool ConcurrentTree<DATA_t, Compare>::attempt_unlink_nl(Node *parent, Node *node)
+    {
+        Node *parent_left = parent->__left.load(std::memory_order_relaxed);
+        Node *parent_right = parent->__right.load(std::memory_order_relaxed);
+        if (parent_left != node && parent_right != node)
+        {
+            return false;
+        }
+        Node *left = node->__left.load(std::memory_order_relaxed);
+        Node *right = node->__right.load(std::memory_order_relaxed);
+        if (left != nullptr && right != nullptr)
+        {
+            return false;
+        }
+        Node *splice = (left != nullptr) ? left : right;
+        (parent_left == node ? parent->__left : parent->__right).store(splice, std::memory_order_release);
+        if (splice != nullptr)
+        {
+            splice->__parent.store(parent, std::memory_order_release);
+        }
+        node->__version.store(UNLINKED, std::memory_order_release);
+        node->__present.store(false, std::memory_order_release);
+        EpochDomain::instance().retire(node, &destroy_node);
+        return true;
+    }
+
+    template <typename DATA_t, typename Compare>
+    int ConcurrentTree<DATA_t, Compare>::node_condition(Node *node)
+    {
+        Node *left = node->__left.load(std::memory_order_acquire);
+        Node *right = node->__right.load(std::memory_order_acquire);
+        if ((left == nullptr || right == nullptr) && !node->__present.load(std::memory_order_acquire))
+        {
+            return UNLINK_REQUIRED;
+        }
+        int node_height = node->__height.load(std::memory_order_acquire);
+        int left_height = height(left), right_height = height(right);
+        int new_height = 1 + std::max(left_height, right_height);
+        if (left_height - right_height < -1 || left_height - right_height > 1)
+        {
+            return REBALANCE_REQUIRED;
+        }
+        return (node_height != new_height) ? new_height : NOTHING_REQUIRED;
+    }
+
+    template <typename DATA_t, typename Compare>
+    void ConcurrentTree<DATA_t, Compare>::fix_height_and_rebalance(Node *node)
+    {
+        // a rotation that leaves work below the node it moved up stores the height of that node already, so the
+        // repair coming back up stops there and the parent above the rotation has to be checked again afterwards
+        FixedStack<Node *, PENDING_CAPACITY> pending;
+        while (true)
+        {
+            // the holder (without a parent) needs nothing
+            if (node == nullptr || node->__parent.load(std::memory_order_acquire) == nullptr || is_unlinked(node))
+            {
+                if (pending.isEmpty())
+                {
+                    return;
+                }
+                node = pending.back();
+                pending.pop_back();
+                continue;
+            }
+            int condition = node_condition(node);
+            if (condition == NOTHING_REQUIRED)
+            {
+                node = nullptr;
+            }
+            else if (condition != UNLINK_REQUIRED && condition != REBALANCE_REQUIRED)
+            {
+                std::lock_guard<SpinLock> lock(node->__lock);
+                node = fix_height_nl(node);
+            }
+            else
+            {
+                Node *parent = node->__parent.load(std::memory_order_acquire);
+                std::lock_guard<SpinLock> parent_lock(parent->__lock);
+                if (!is_unlinked(parent) && node->__parent.load(std::memory_order_relaxed) == parent)
+                {
+                    std::lock_guard<SpinLock> lock(node->__lock);
+                    node = rebalance_nl(parent, node);
+                    if (node != nullptr && node != parent && pending.size() < PENDING_CAPACITY)
+                    {
+                        pending.push_back(parent);
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename DATA_t, typename Compare>
+    typename ConcurrentTree<DATA_t, Compare>::Node *ConcurrentTree<DATA_t, Compare>::fix_height_nl(Node *node)
+    {
+        int condition = node_condition(node);
+        switch (condition)
+        {
+        case REBALANCE_REQUIRED:
+        case UNLINK_REQUIRED:
+            // the caller repairs it with its parent locked
+            return node;
+        case NOTHING_REQUIRED:
+            return nullptr;
+        default:
+            node->__height.store(condition, std::memory_order_release);
+            // acquire, the parent may be a node that just replaced a routing node
+            return node->__parent.load(std::memory_order_acquire);
+        }
+    }
+
+    template <typename DATA_t, typename Compare>
+    typename ConcurrentTree<DATA_t, Compare>::Node *ConcurrentTree<DATA_t, Compare>::rebalance_nl(Node *parent, Node *node)
+    {
+        Node *left = node->__left.load(std::memory_order_relaxed);
+        Node *right = node->__right.load(std::memory_order_relaxed);
+        if ((left == nullptr || right == nullptr) && !node->__present.load(std::memory_order_relaxed))
+        {
+            return attempt_unlink_nl(parent, node) ? fix_height_nl(parent) : node;
+        }
+        int node_height = node->__height.load(std::memory_order_relaxed);
+        int left_height = height(left), right_height = height(right);
+        int new_height = 1 + std::max(left_height, right_height);
+        int balance = left_height - right_height;
+        if (balance > 1)
+        {
+            return rebalance_to_right_nl(parent, node, left, right_height);
+        }
+        else if (balance < -1)
+        {
+            return rebalance_to_left_nl(parent, node, right, left_height);
+        }
+        else if (new_height != node_height)
+        {
+            node->__height.store(new_height, std::memory_order_release);
+            return fix_height_nl(parent);
+        }
+        return nullptr;
+    }
+
+    template <typename DATA_t, typename Compare>
+    typename ConcurrentTree<DATA_t, Compare>::Node *ConcurrentTree<DATA_t, Compare>::rebalance_to_right_nl(Node *parent, Node *node, Node *left, int right_height)
+    {
+        std::lock_guard<SpinLock> left_lock(left->__lock);
+        int left_height = left->__height.load(std::memory_order_relaxed);
+        if (left_height - right_height <= 1)
+        {
+            // it changed before the lock, start over from node
+            return node;
+        }
+        Node *left_right = left->__right.load(std::memory_order_relaxed);
+        int left_left_height = height(left->__left.load(std::memory_order_relaxed));
+        int left_right_height = height(left_right);
+        if (left_left_height >= left_right_height)
+        {
+            return rotate_right_nl(parent, node, left, right_height, left_left_height, left_right, left_right_height);
+        }
+        {
+            std::lock_guard<SpinLock> left_right_lock(left_right->__lock);
+            left_right_height = left_right->__height.load(std::memory_order_relaxed);
+            if (left_left_height >= left_right_height)
+            {
+                return rotate_right_nl(parent, node, left, right_height, left_left_height, left_right, left_right_height);
+            }
+            int left_right_left_height = height(left_right->__left.load(std::memory_order_relaxed));
+            int balance = left_left_height - left_right_left_height;
+            if (balance >= -1 && balance <= 1 &&
+                !((left_left_height == 0 || left_right_left_height == 0) && !left->__present.load(std::memory_order_relaxed)))
+            {
+                return rotate_right_over_left_nl(parent, node, left, right_height, left_left_height, left_right, left_right_left_height);
+            }
+            // the double rotation would leave left out of balance (or a routing node with one child), so left is
+            // rotated on its own and node is rebalanced on the next round
+            int left_right_right_height = height(left_right->__right.load(std::memory_order_relaxed));
+            return rotate_left_nl(node, left, left_left_height, left_right, left_right->__left.load(std::memory_order_relaxed),
+                                  left_right_left_height, left_right_right_height);
+        }
+    }
+
+    template <typename DATA_t, typename Compare>
+    typename ConcurrentTree<DATA_t, Compare>::Node *ConcurrentTree<DATA_t, Compare>::rebalance_to_left_nl(Node *parent, Node *node, Node *right, int left_height)
+    {
+        std::lock_guard<SpinLock> right_lock(right->__lock);
+        int right_height = right->__height.load(std::memory_order_relaxed);
+        if (left_height - right_height >= -1)
+        {
+            return node;
+        }
+        Node *right_left = right->__left.load(std::memory_order_relaxed);
+        int right_left_height = height(right_left);
+        int right_right_height = height(right->__right.load(std::memory_order_relaxed));
+        if (right_right_height >= right_left_height)
+        {
+            return rotate_left_nl(parent, node, left_height, right, right_left, right_left_height, right_right_height);
+        }
+        {
+            std::lock_guard<SpinLock> right_left_lock(right_left->__lock);
+            right_left_height = right_left->__height.load(std::memory_order_relaxed);
+            if (right_right_height >= right_left_height)
+            {
+                return rotate_left_nl(parent, node, left_height, right, right_left, right_left_height, right_right_height);
+            }
+            int right_left_right_height = height(right_left->__right.load(std::memory_order_relaxed));
+            int balance = right_right_height - right_left_right_height;
+            if (balance >= -1 && balance <= 1 &&
+                !((right_right_height == 0 || right_left_right_height == 0) && !right->__present.load(std::memory_order_relaxed)))
+            {
+                return rotate_left_over_right_nl(parent, node, left_height, right, right_left, right_right_height, right_left_right_height);
+            }
+            int right_left_left_height = height(right_left->__left.load(std::memory_order_relaxed));
+            return rotate_right_nl(node, right, right_left, right_right_height, right_left_left_height,
+                                   right_left->__right.load(std::memory_order_relaxed), right_left_right_height);
+        }
+    }
+
+    template <typename DATA_t, typename Compare>
+    typename ConcurrentTree<DATA_t, Compare>::Node *ConcurrentTree<DATA_t, Compare>::rotate_right_nl(Node *parent, Node *node, Node *left, int right_height,
+                                                                                                      int left_left_height, Node *left_right, int left_right_height)
+    {
+        unsigned long long version = node->__version.load(std::memory_order_relaxed);
+        Node *parent_left = parent->__left.load(std::memory_order_relaxed);
+        // node moves down, the searches that passed it have to look again
+        node->__version.store(version | SHRINKING, std::memory_order_release);
+
+        node->__left.store(left_right, std::memory_order_release);
+        if (left_right != nullptr)
+        {
+            left_right->__parent.store(node, std::memory_order_release);
+        }
+        left->__right.store(node, std::memory_order_release);
+        node->__parent.store(left, std::memory_order_release);
+        (parent_left == node ? parent->__left : parent->__right).store(left, std::memory_order_release);
+        left->__parent.store(parent, std::memory_order_release);
+
+        int node_height = 1 + std::max(left_right_height, right_height);
+        node->__height.store(node_height, std::memory_order_release);
+        left->__height.store(1 + std::max(left_left_height, node_height), std::memory_order_release);
+        node->__version.store(version + SHRINK_COUNT, std::memory_order_release);
+
+        // the nodes that may need more work, bottom-up
+        int node_balance = left_right_height - right_height;
+        if (node_balance < -1 || node_balance > 1)
+        {
+            return node;
+        }
+        if ((left_right == nullptr || right_height == 0) && !node->__present.load(std::memory_order_relaxed))
+        {
+            return node;
+        }
+        int left_balance = left_left_height - node_height;
+        if (left_balance < -1 || left_balance > 1)
+        {
+            return left;
+        }
+        if (left_left_height == 0 && !left->__present.load(std::memory_order_relaxed))
+        {
+            return left;
+        }
+        return fix_height_nl(parent);
+    }
+
+    template <typename DATA_t, typename Compare>
+    typename ConcurrentTree<DATA_t, Compare>::Node *ConcurrentTree<DATA_t, Compare>::rotate_left_nl(Node *parent, Node *node, int left_height, Node *right,
+                                                                                                     Node *right_left, int right_left_height, int right_right_height)
+    {
+        unsigned long long version = node->__version.load(std::memory_order_relaxed);
+        Node *parent_left = parent->__left.load(std::memory_order_relaxed);
+        node->__version.store(version | SHRINKING, std::memory_order_release);
+
+        node->__right.store(right_left, std::memory_order_release);
+        if (right_left != nullptr)
+        {
+            right_left->__parent.store(node, std::memory_order_release);
+        }
+        right->__left.store(node, std::memory_order_release);
+        node->__parent.store(right, std::memory_order_release);
+        (parent_left == node ? parent->__left : parent->__right).store(right, std::memory_order_release);
+        right->__parent.store(parent, std::memory_order_release);
+
+        int node_height = 1 + std::max(left_height, right_left_height);
+        node->__height.store(node_height, std::memory_order_release);
+        right->__height.store(1 + std::max(node_height, right_right_height), std::memory_order_release);
+        node->__version.store(version + SHRINK_COUNT, std::memory_order_release);
+
+        int node_balance = right_left_height - left_height;
+        if (node_balance < -1 || node_balance > 1)
+        {
+            return node;
+        }
+        if ((right_left == nullptr || left_height == 0) && !node->__present.load(std::memory_order_relaxed))
+        {
+            return node;
+        }
+        int right_balance = right_right_height - node_height;
+        if (right_balance < -1 || right_balance > 1)
+        {
+            return right;
+        }
+        if (right_right_height == 0 && !right->__present.load(std::memory_order_relaxed))
+        {
+            return right;
+        }
+        return fix_height_nl(parent);
+    }
+
+    template <typename DATA_t, typename Compare>
+    typename ConcurrentTree<DATA_t, Compare>::Node *ConcurrentTree<DATA_t, Compare>::rotate_right_over_left_nl(Node *parent, Node *node, Node *left, int right_height,
+                                                                                                                int left_left_height, Node *left_right, int left_right_left_height)
+    {
+        unsigned long long version = node->__version.load(std::memory_order_relaxed);
+        unsigned long long left_version = left->__version.load(std::memory_order_relaxed);
+        Node *parent_left = parent->__left.load(std::memory_order_relaxed);
+        Node *left_right_left = left_right->__left.load(std::memory_order_relaxed);
+        Node *left_right_right = left_right->__right.load(std::memory_order_relaxed);
+        int left_right_right_height = height(left_right_right);
+        // node and left both move down
+        node->__version.store(version | SHRINKING, std::memory_order_release);
+        left->__version.store(left_version | SHRINKING, std::memory_order_release);
+
+        node->__left.store(left_right_right, std::memory_order_release);
+        if (left_right_right != nullptr)
+        {
+            left_right_right->__parent.store(node, std::memory_order_release);
+        }
+        left->__right.store(left_right_left, std::memory_order_release);
+        if (left_right_left != nullptr)
+        {
+            left_right_left->__parent.store(left, std::memory_order_release);
+        }
+        left_right->__left.store(left, std::memory_order_release);
+        left->__parent.store(left_right, std::memory_order_release);
+        left_right->__right.store(node, std::memory_order_release);
+        node->__parent.store(left_right, std::memory_order_release);
+        (parent_left == node ? parent->__left : parent->__right).store(left_right, std::memory_order_release);
+        left_right->__parent.store(parent, std::memory_order_release);
+
+        int node_height = 1 + std::max(left_right_right_height, right_height);
+        node->__height.store(node_height, std::memory_order_release);
+        int left_height = 1 + std::max(left_left_height, left_right_left_height);
+        left->__height.store(left_height, std::memory_order_release);
+        left_right->__height.store(1 + std::max(left_height, node_height), std::memory_order_release);
+        node->__version.store(version + SHRINK_COUNT, std::memory_order_release);
+        left->__version.store(left_version + SHRINK_COUNT, std::memory_order_release);
+
+        // left was checked before the rotation
+        int node_balance = left_right_right_height - right_height;
+        if (node_balance < -1 || node_balance > 1)
+        {
+            return node;
+        }
+        if ((left_right_right == nullptr || right_height == 0) && !node->__present.load(std::memory_order_relaxed))
+        {
+            return node;
+        }
+        int top_balance = left_height - node_height;
+        if (top_balance < -1 || top_balance > 1)
+        {
+            return left_right;
+        }
+        return fix_height_nl(parent);
+    }
+
+    template <typename DATA_t, typename Compare>
+    typename ConcurrentTree<DATA_t, Compare>::Node *ConcurrentTree<DATA_t, Compare>::rotate_left_over_right_nl(Node *parent, Node *node, int left_height, Node *right,
+                                                                                                                Node *right_left, int right_right_height, int right_left_right_height)
+    {
+        unsigned long long version = node->__version.load(std::memory_order_relaxed);
+        unsigned long long right_version = right->__version.load(std::memory_order_relaxed);
+        Node *parent_left = parent->__left.load(std::memory_order_relaxed);
+        Node *right_left_left = right_left->__left.load(std::memory_order_relaxed);
+        Node *right_left_right = right_left->__right.load(std::memory_order_relaxed);
+        int right_left_left_height = height(right_left_left);
+        node->__version.store(version | SHRINKING, std::memory_order_release);
+        right->__version.store(right_version | SHRINKING, std::memory_order_release);
+
+        node->__right.store(right_left_left, std::memory_order_release);
+        if (right_left_left != nullptr)
+        {
+            right_left_left->__parent.store(node, std::memory_order_release);
+        }
+        right->__left.store(right_left_right, std::memory_order_release);
+        if (right_left_right != nullptr)
+        {
+            right_left_right->__parent.store(right, std::memory_order_release);
+        }
+        right_left->__right.store(right, std::memory_order_release);
+        right->__parent.store(right_left, std::memory_order_release);
+        right_left->__left.store(node, std::memory_order_release);
+        node->__parent.store(right_left, std::memory_order_release);
+        (parent_left == node ? parent->__left : parent->__right).store(right_left, std::memory_order_release);
+        right_left->__parent.store(parent, std::memory_order_release);
+
+        int node_height = 1 + std::max(left_height, right_left_left_height);
+        node->__height.store(node_height, std::memory_order_release);
+        int right_height = 1 + std::max(right_left_right_height, right_right_height);
+        right->__height.store(right_height, std::memory_order_release);
+        right_left->__height.store(1 + std::max(node_height, right_height), std::memory_order_release);
+        node->__version.store(version + SHRINK_COUNT, std::memory_order_release);
+        right->__version.store(right_version + SHRINK_COUNT, std::memory_order_release);
+
+        int node_balance = right_left_left_height - left_height;
+        if (node_balance < -1 || node_balance > 1)
+        {
+            return node;
+        }
+        if ((right_left_left == nullptr || left_height == 0) && !node->__present.load(std::memory_order_relaxed))
+        {
+            return node;
+        }
+        int top_balance = right_height - node_height;
+        if (top_balance < -1 || top_balance > 1)
+        {
+            return right_left;
+        }
+        return fix_height_nl(parent);
+    }
+
+    template <typename DATA_t, typename Compare>
+    TreeShapeReport ConcurrentTree<DATA_t, Compare>::tree_shape_report() const
+    {
+        TreeShapeReport report;
+        long long depths = 0;
+        report.height = shape_aux(__holder->__right.load(std::memory_order_acquire), 0, report, depths) - 1;
+        int nodes = report.left_heavy + report.balanced + report.right_heavy + report.unbalanced;
+        report.size = size();
+        report.average_depth = (nodes != 0) ? double(depths) / nodes : 0.0;
+        return report;
+    }
+
+    // returns the height of the subtree counted from the nodes (1 for a leaf)
+    template <typename DATA_t, typename Compare>
+    int ConcurrentTree<DATA_t, Compare>::shape_aux(const Node *node, int depth, TreeShapeReport &report, long long &depths) const
+    {
+        if (node == nullptr)
+        {
+            return 0;
+        }
+        int left_height = shape_aux(node->__left.load(std::memory_order_acquire), depth + 1, report, depths);
+        int right_height = shape_aux(node->__right.load(std::memory_order_acquire), depth + 1, report, depths);
+        depths += depth;
+        switch (left_height - right_height)
+        {
+        case 1:
+            report.left_heavy++;
+            break;
+        case 0:
+            report.balanced++;
+            break;
+        case -1:
+            report.right_heavy++;
+            break;
+        default:
+            report.unbalanced++;
+        }
+        return 1 + std::max(left_height, right_height);
+    }
+};
+
+#endif // _AVL_CONCURRENT_TREE_H_
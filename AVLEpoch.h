@@ -0,0 +1,222 @@
+#ifndef _AVL_EPOCH_H_
+#define _AVL_EPOCH_H_
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace avl
+{
+    // epoch based reclamation, for lock-free readers of linked structures: a thread reads shared nodes only inside
+    // a critical section (an EpochGuard) and a node that was unlinked is retired rather than destroyed. the global
+    // epoch advances once every thread inside a critical section has seen the current one, and a node retired in
+    // epoch e is destroyed once the epoch reached e + 3, when no critical section that could have seen it is left.
+    //
+    // the domain is shared by the whole process. every thread keeps the nodes it retired in a list of its own and
+    // tries to advance the epoch and destroy what it can every RETIRE_BATCH retirements, the nodes of a thread
+    // that ends are handed over to the others. a thread that stays in a critical section holds back every
+    // destruction, so the critical sections should be short
+    class EpochDomain
+    {
+    public:
+        static constexpr int RETIRE_BATCH = 64;
+
+        static EpochDomain &instance()
+        {
+            static EpochDomain domain;
+            return domain;
+        }
+
+        // critical sections nest, only the outermost one counts
+        void enter()
+        {
+            ThreadState &state = thread_state();
+            if (state.__nesting++ == 0)
+            {
+                // the announcement has to be visible before the first shared node is read
+                state.__record->__state.store(__epoch.load(std::memory_order_relaxed) * 2 + 1, std::memory_order_seq_cst);
+            }
+        }
+
+        void exit()
+        {
+            ThreadState &state = thread_state();
+            if (--state.__nesting == 0)
+            {
+                state.__record->__state.store(0, std::memory_order_release);
+            }
+        }
+
+        // destroy(object) is called once no thread can reach object anymore, object must already be unlinked
+        void retire(void *object, void (*destroy)(void *))
+        {
+            ThreadState &state = thread_state();
+            state.__retired.push_back(Retired{__epoch.load(std::memory_order_seq_cst), object, destroy});
+            if (++state.__since_collect >= RETIRE_BATCH)
+            {
+                state.__since_collect = 0;
+                try_advance();
+                collect(state.__retired, state.__head);
+            }
+        }
+
+        EpochDomain(const EpochDomain &) = delete;
+        EpochDomain &operator=(const EpochDomain &) = delete;
+
+        ~EpochDomain()
+        {
+            // the process is ending, no thread reads anymore
+            for (Retired &retired : __orphans)
+            {
+                retired.__destroy(retired.__object);
+            }
+            for (Record *record = __records.load(); record != nullptr;)
+            {
+                Record *next = record->__next;
+                delete record;
+                record = next;
+            }
+        }
+
+    private:
+        // the announcement of a thread, records are reused by later threads and live as long as the domain
+        struct Record
+        {
+            std::atomic<unsigned long long> __state; // 0 outside of critical sections, epoch * 2 + 1 inside
+            std::atomic<bool> __in_use;
+            Record *__next;
+            char __padding[64];
+        };
+
+        struct Retired
+        {
+            unsigned long long __epoch;
+            void *__object;
+            void (*__destroy)(void *);
+        };
+
+        struct ThreadState
+        {
+            EpochDomain &__domain;
+            Record *__record;
+            int __nesting;
+            int __since_collect;
+            // the retired nodes in the order they were retired (by epoch), those before __head are destroyed
+            std::vector<Retired> __retired;
+            std::size_t __head;
+
+            explicit ThreadState(EpochDomain &domain) : __domain(domain), __record(domain.acquire_record()), __nesting(0), __since_collect(0), __head(0) {}
+
+            ~ThreadState()
+            {
+                __record->__state.store(0, std::memory_order_release);
+                __record->__in_use.store(false, std::memory_order_release);
+                __domain.adopt(__retired, __head);
+            }
+        };
+
+        std::atomic<unsigned long long> __epoch;
+        std::atomic<Record *> __records;
+        // the retired nodes of the threads that ended
+        std::mutex __orphans_lock;
+        std::vector<Retired> __orphans;
+        std::atomic<bool> __has_orphans;
+
+        EpochDomain() : __epoch(1), __records(nullptr), __has_orphans(false) {}
+
+        ThreadState &thread_state()
+        {
+            thread_local ThreadState state(*this);
+            return state;
+        }
+
+        Record *acquire_record()
+        {
+            for (Record *record = __records.load(std::memory_order_acquire); record != nullptr; record = record->__next)
+            {
+                bool in_use = false;
+                if (!record->__in_use.load(std::memory_order_relaxed) && record->__in_use.compare_exchange_strong(in_use, true))
+                {
+                    return record;
+                }
+            }
+            Record *record = new Record();
+            record->__state.store(0, std::memory_order_relaxed);
+            record->__in_use.store(true, std::memory_order_relaxed);
+            record->__next = __records.load(std::memory_order_relaxed);
+            while (!__records.compare_exchange_weak(record->__next, record, std::memory_order_release, std::memory_order_relaxed))
+            {
+            }
+            return record;
+        }
+
+        // advances the epoch if every thread inside a critical section announced the current one
+        void try_advance()
+        {
+            unsigned long long epoch = __epoch.load(std::memory_order_seq_cst);
+            for (Record *record = __records.load(std::memory_order_acquire); record != nullptr; record = record->__next)
+            {
+                unsigned long long state = record->__state.load(std::memory_order_seq_cst);
+                if ((state & 1) != 0 && (state >> 1) != epoch)
+                {
+                    return;
+                }
+            }
+            __epoch.compare_exchange_strong(epoch, epoch + 1);
+        }
+
+        // destroys the nodes of retired (from head on) that are old enough
+        void collect(std::vector<Retired> &retired, std::size_t &head)
+        {
+            unsigned long long epoch = __epoch.load(std::memory_order_seq_cst);
+            for (; head < retired.size() && retired[head].__epoch + 3 <= epoch; head++)
+            {
+                retired[head].__destroy(retired[head].__object);
+            }
+            if (head * 2 >= retired.size())
+            {
+                retired.erase(retired.begin(), retired.begin() + head);
+                head = 0;
+            }
+            if (__has_orphans.load(std::memory_order_relaxed))
+            {
+                // the orphans of several threads aren't in epoch order
+                std::lock_guard<std::mutex> guard(__orphans_lock);
+                std::size_t kept = 0;
+                for (Retired &orphan : __orphans)
+                {
+                    if (orphan.__epoch + 3 <= epoch)
+                        orphan.__destroy(orphan.__object);
+                    else
+                        __orphans[kept++] = orphan;
+                }
+                __orphans.resize(kept);
+                __has_orphans.store(kept != 0, std::memory_order_relaxed);
+            }
+        }
+
+        void adopt(std::vector<Retired> &retired, std::size_t head)
+        {
+            if (head == retired.size())
+            {
+                return;
+            }
+            std::lock_guard<std::mutex> guard(__orphans_lock);
+            __orphans.insert(__orphans.end(), retired.begin() + head, retired.end());
+            __has_orphans.store(true, std::memory_order_relaxed);
+        }
+    };
+
+    // a critical section of the epoch domain for the lifetime of the object
+    class EpochGuard
+    {
+    public:
+        EpochGuard() { EpochDomain::instance().enter(); }
+        ~EpochGuard() { EpochDomain::instance().exit(); }
+        EpochGuard(const EpochGuard &) = delete;
+        EpochGuard &operator=(const EpochGuard &) = delete;
+    };
+};
+
+#endif // _AVL_EPOCH_H_
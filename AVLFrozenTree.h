@@ -0,0 +1,406 @@
+#ifndef _AVL_FROZEN_TREE_H_
+#define _AVL_FROZEN_TREE_H_
+
+#include <cassert>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "AVLUtility.h"
+
+namespace avl
+{
+    // an immutable snapshot of a tree (see Tree::freeze()) laid out in one contiguous array for fast lookups.
+    //
+    // elements are stored in the Eytzinger (BFS) order of a perfectly balanced tree: the children of the element
+    // at index k are at 2k + 1 and 2k + 2, so the top levels share cache lines and a search is a branchless
+    // loop that prefetches the line 4 levels below where it is.
+    // arithmetic elements compared with the default comparator (or std::less) use a 17-ary variant of the same layout
+    // (a static B-tree, every block holds BLOCK_SIZE sorted elements and has BLOCK_SIZE + 1 implicit children)
+    // where the position inside a block is found with SIMD comparisons
+    template <typename DATA_t, typename Compare = ThreeWayCompare<DATA_t>>
+    class FrozenTree : private CompareStorage<Compare>
+    {
+    public:
+        FrozenTree();
+        // the range has to be sorted (strictly increasing)
+        template <typename Iterator>
+        FrozenTree(Iterator first, Iterator last, const Compare &compare = Compare());
+
+        using CompareStorage<Compare>::comparator;
+
+        const bool isEmpty() const;
+        const int size() const;
+
+        bool contains(const DATA_t &data) const;
+        const DATA_t &find(const DATA_t &data) const;
+        const DATA_t &getMin() const;
+        const DATA_t &getMax() const;
+
+        template <typename FunctionObject>
+        void in_order_traversal(FunctionObject do_something) const
+        {
+            int remaining = __size;
+            if (USE_BLOCKS)
+            {
+                blocks_traversal_aux_recursive(0, do_something, remaining);
+            }
+            else
+            {
+                eytzinger_traversal_aux_recursive(0, do_something);
+            }
+        }
+
+        template <typename FunctionObject>
+        void reverse_in_order_traversal(FunctionObject do_something) const
+        {
+            if (USE_BLOCKS)
+            {
+                int padding = int(__layout.size()) - __size;
+                reverse_blocks_traversal_aux_recursive(0, do_something, padding);
+            }
+            else
+            {
+                reverse_eytzinger_traversal_aux_recursive(0, do_something);
+            }
+        }
+
+        // error classes
+        class NoSuchElementException : public std::exception
+        {
+        public:
+            const char *what() const noexcept override { return "There is no such element"; }
+        };
+
+    private:
+        static constexpr bool USE_BLOCKS = std::is_arithmetic<DATA_t>::value &&
+                                           (std::is_same<Compare, ThreeWayCompare<DATA_t>>::value || std::is_same<Compare, ThreeWayCompare<>>::value ||
+                                            std::is_same<Compare, std::less<DATA_t>>::value || std::is_same<Compare, std::less<void>>::value);
+        static constexpr int BLOCK_SIZE = 16;
+
+        std::vector<DATA_t> __layout; // with blocks its size is a multiple of BLOCK_SIZE, the end is padded with the maximum
+        int __size;
+        int __min_index;
+        int __max_index;
+
+        bool less(const DATA_t &first, const DATA_t &second) const
+        {
+            return avl::less(comparator(), first, second);
+        }
+
+        int blocks() const
+        {
+            return int(__layout.size()) / BLOCK_SIZE;
+        }
+
+        static int child_block(int block, int i)
+        {
+            return block * (BLOCK_SIZE + 1) + i + 1;
+        }
+
+        // fills the layout in-order from the sorted elements, t is the number of elements used so far
+        void build_eytzinger(int k, const std::vector<DATA_t> &sorted, int &t)
+        {
+            if (k >= __size)
+            {
+                return;
+            }
+            build_eytzinger(2 * k + 1, sorted, t);
+            __layout[k] = sorted[t];
+            __min_index = (t == 0) ? k : __min_index;
+            __max_index = (t == __size - 1) ? k : __max_index;
+            t++;
+            build_eytzinger(2 * k + 2, sorted, t);
+        }
+
+        void build_blocks(int block, const std::vector<DATA_t> &sorted, int &t)
+        {
+            if (block >= blocks())
+            {
+                return;
+            }
+            for (int i = 0; i < BLOCK_SIZE; i++)
+            {
+                build_blocks(child_block(block, i), sorted, t);
+                int k = block * BLOCK_SIZE + i;
+                if (t < __size)
+                {
+                    __min_index = (t == 0) ? k : __min_index;
+                    __max_index = (t == __size - 1) ? k : __max_index;
+                    __layout[k] = sorted[t++];
+                }
+                else
+                { // padding, it comes after all the real elements in-order so the searches never stop at it first
+                    __layout[k] = sorted[__size - 1];
+                }
+            }
+            build_blocks(child_block(block, BLOCK_SIZE), sorted, t);
+        }
+
+        // returns the index of the first element that is not smaller than data, or -1 if there's none
+        int lower_bound_eytzinger(const DATA_t &data) const
+        {
+            const DATA_t *layout = __layout.data();
+            std::size_t n = __layout.size();
+            std::size_t k = 0;
+            while (k < n)
+            {
+                // the 16 descendants 4 levels below k are consecutive, fetch them while the next levels are compared
+                std::size_t ahead = 16 * k + 15;
+                __builtin_prefetch(layout + (ahead < n ? ahead : 0));
+                k = 2 * k + 1 + std::size_t(less(layout[k], data));
+            }
+            // the last left turn of the walk was at the answer, undo the right turns after it
+            std::size_t j = k + 1;
+            j >>= __builtin_ffsll(static_cast<long long>(~j));
+            return int(j) - 1;
+        }
+
+        // the number of elements in the block that are smaller than data
+        template <typename T>
+        static int block_rank(const T *block, const T &data)
+        {
+            int count = 0;
+            for (int i = 0; i < BLOCK_SIZE; i++)
+            {
+                count += (block[i] < data);
+            }
+            return count;
+        }
+
+#if defined(__AVX2__)
+        static int block_rank(const std::int32_t *block, const std::int32_t &data)
+        {
+            __m256i key = _mm256_set1_epi32(data);
+            __m256i first = _mm256_cmpgt_epi32(key, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block)));
+            __m256i second = _mm256_cmpgt_epi32(key, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + 8)));
+            unsigned mask = unsigned(_mm256_movemask_ps(_mm256_castsi256_ps(first))) |
+                            (unsigned(_mm256_movemask_ps(_mm256_castsi256_ps(second))) << 8);
+            return __builtin_popcount(mask);
+        }
+
+        static int block_rank(const std::int64_t *block, const std::int64_t &data)
+        {
+            __m256i key = _mm256_set1_epi64x(data);
+            unsigned mask = 0;
+            for (int i = 0; i < BLOCK_SIZE; i += 4)
+            {
+                __m256i smaller = _mm256_cmpgt_epi64(key, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + i)));
+                mask |= unsigned(_mm256_movemask_pd(_mm256_castsi256_pd(smaller))) << i;
+            }
+            return __builtin_popcount(mask);
+        }
+#elif defined(__SSE2__)
+        static int block_rank(const std::int32_t *block, const std::int32_t &data)
+        {
+            __m128i key = _mm_set1_epi32(data);
+            unsigned mask = 0;
+            for (int i = 0; i < BLOCK_SIZE; i += 4)
+            {
+                __m128i smaller = _mm_cmpgt_epi32(key, _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + i)));
+                mask |= unsigned(_mm_movemask_ps(_mm_castsi128_ps(smaller))) << i;
+            }
+            return __builtin_popcount(mask);
+        }
+#endif
+#if defined(__SSE2__)
+        static int block_rank(const float *block, const float &data)
+        {
+            __m128 key = _mm_set1_ps(data);
+            unsigned mask = 0;
+            for (int i = 0; i < BLOCK_SIZE; i += 4)
+            {
+                mask |= unsigned(_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(block + i), key))) << i;
+            }
+            return __builtin_popcount(mask);
+        }
+#endif
+
+        int lower_bound(const DATA_t &data, std::false_type /* use blocks */) const
+        {
+            return lower_bound_eytzinger(data);
+        }
+
+        int lower_bound(const DATA_t &data, std::true_type /* use blocks */) const
+        {
+            const DATA_t *layout = __layout.data();
+            int result = -1;
+            for (int block = 0; block < blocks();)
+            {
+                int i = block_rank(layout + block * BLOCK_SIZE, data);
+                result = (i < BLOCK_SIZE) ? block * BLOCK_SIZE + i : result;
+                block = child_block(block, i);
+            }
+            return result;
+        }
+
+        int find_index(const DATA_t &data) const
+        {
+            if (__size == 0)
+            {
+                return -1;
+            }
+            int index = lower_bound(data, std::integral_constant<bool, USE_BLOCKS>());
+            if (index < 0 || less(data, __layout[index]))
+            {
+                return -1;
+            }
+            return index;
+        }
+
+        template <typename FunctionObject>
+        void eytzinger_traversal_aux_recursive(int k, FunctionObject &do_something) const
+        {
+            if (k >= __size)
+            {
+                return;
+            }
+            eytzinger_traversal_aux_recursive(2 * k + 1, do_something);
+            do_something(__layout[k]);
+            eytzinger_traversal_aux_recursive(2 * k + 2, do_something);
+        }
+
+        template <typename FunctionObject>
+        void reverse_eytzinger_traversal_aux_recursive(int k, FunctionObject &do_something) const
+        {
+            if (k >= __size)
+            {
+                return;
+            }
+            reverse_eytzinger_traversal_aux_recursive(2 * k + 2, do_something);
+            do_something(__layout[k]);
+            reverse_eytzinger_traversal_aux_recursive(2 * k + 1, do_something);
+        }
+
+        // remaining is the number of real elements still to visit, the padding comes after them
+        template <typename FunctionObject>
+        void blocks_traversal_aux_recursive(int block, FunctionObject &do_something, int &remaining) const
+        {
+            if (block >= blocks())
+            {
+                return;
+            }
+            for (int i = 0; i < BLOCK_SIZE; i++)
+            {
+                blocks_traversal_aux_recursive(child_block(block, i), do_something, remaining);
+                if (remaining == 0)
+                {
+                    return;
+                }
+                do_something(__layout[block * BLOCK_SIZE + i]);
+                remaining--;
+            }
+            blocks_traversal_aux_recursive(child_block(block, BLOCK_SIZE), do_something, remaining);
+        }
+
+        // padding is the number of padding elements still to skip before the real ones
+        template <typename FunctionObject>
+        void reverse_blocks_traversal_aux_recursive(int block, FunctionObject &do_something, int &padding) const
+        {
+            if (block >= blocks())
+            {
+                return;
+            }
+            reverse_blocks_traversal_aux_recursive(child_block(block, BLOCK_SIZE), do_something, padding);
+            for (int i = BLOCK_SIZE - 1; i >= 0; i--)
+            {
+                if (padding > 0)
+                {
+                    padding--;
+                }
+                else
+                {
+                    do_something(__layout[block * BLOCK_SIZE + i]);
+                }
+                reverse_blocks_traversal_aux_recursive(child_block(block, i), do_something, padding);
+            }
+        }
+    };
+
+    template <typename DATA_t, typename Compare>
+    FrozenTree<DATA_t, Compare>::FrozenTree() : CompareStorage<Compare>(Compare()), __size(0), __min_index(-1), __max_index(-1)
+    {
+    }
+
+    template <typename DATA_t, typename Compare>
+    template <typename Iterator>
+    FrozenTree<DATA_t, Compare>::FrozenTree(Iterator first, Iterator last, const Compare &compare)
+        : CompareStorage<Compare>(compare), __size(0), __min_index(-1), __max_index(-1)
+    {
+        std::vector<DATA_t> sorted(first, last);
+        if (sorted.empty())
+        {
+            return;
+        }
+        __size = int(sorted.size());
+        int used = 0;
+        if (USE_BLOCKS)
+        {
+            __layout.assign((sorted.size() + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE, sorted.back());
+            build_blocks(0, sorted, used);
+        }
+        else
+        {
+            __layout = sorted;
+            build_eytzinger(0, sorted, used);
+        }
+        assert(used == __size);
+    }
+
+    template <typename DATA_t, typename Compare>
+    const bool FrozenTree<DATA_t, Compare>::isEmpty() const
+    {
+        return (__size == 0);
+    }
+
+    template <typename DATA_t, typename Compare>
+    const int FrozenTree<DATA_t, Compare>::size() const
+    {
+        return __size;
+    }
+
+    template <typename DATA_t, typename Compare>
+    bool FrozenTree<DATA_t, Compare>::contains(const DATA_t &data) const
+    {
+        return find_index(data) >= 0;
+    }
+
+    template <typename DATA_t, typename Compare>
+    const DATA_t &FrozenTree<DATA_t, Compare>::find(const DATA_t &data) const
+    {
+        int index = find_index(data);
+        if (index < 0)
+        {
+            throw NoSuchElementException();
+        }
+        return __layout[index];
+    }
+
+    template <typename DATA_t, typename Compare>
+    const DATA_t &FrozenTree<DATA_t, Compare>::getMin() const
+    {
+        if (__size == 0)
+        {
+            throw NoSuchElementException();
+        }
+        return __layout[__min_index];
+    }
+
+    template <typename DATA_t, typename Compare>
+    const DATA_t &FrozenTree<DATA_t, Compare>::getMax() const
+    {
+        if (__size == 0)
+        {
+            throw NoSuchElementException();
+        }
+        return __layout[__max_index];
+    }
+};
+
+#endif // _AVL_FROZEN_TREE_H_
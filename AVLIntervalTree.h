@@ -0,0 +1,160 @@
+#ifndef _AVL_INTERVAL_TREE_H_
+#define _AVL_INTERVAL_TREE_H_
+
+#include <cassert>
+#include <limits>
+
+#include "AVLTree.h"
+#include "AVLUtility.h"
+
+namespace avl
+{
+    // a closed interval [low, high], ordered by low and then by high
+    template <typename T>
+    struct Interval
+    {
+        T low;
+        T high;
+
+        Interval(const T &low, const T &high) : low(low), high(high) {}
+
+        bool overlaps(const T &other_low, const T &other_high) const { return !(other_high < low) && !(high < other_low); }
+        bool contains(const T &point) const { return overlaps(point, point); }
+    };
+
+    template <typename T>
+    bool operator<(const Interval<T> &left, const Interval<T> &right)
+    {
+        return (left.low < right.low) || (!(right.low < left.low) && left.high < right.high);
+    }
+
+    template <typename T>
+    bool operator>(const Interval<T> &left, const Interval<T> &right)
+    {
+        return right < left;
+    }
+
+    template <typename T>
+    bool operator==(const Interval<T> &left, const Interval<T> &right)
+    {
+        return !(left < right) && !(right < left);
+    }
+
+    // the aggregate of the interval trees, the largest high endpoint of a subtree.
+    // assumes T has operator < and std::numeric_limits<T>
+    template <typename T>
+    struct MaxEndpointAggregate
+    {
+        typedef T value_type;
+        static value_type identity()
+        {
+            return std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest();
+        }
+        static value_type lift(const Interval<T> &interval) { return interval.high; }
+        static value_type combine(const value_type &first, const value_type &second) { return (first < second) ? second : first; }
+    };
+
+    // a set of intervals on top of Tree (same nodes, same rebalancing), ordered by their low endpoints. every node
+    // also caches the largest high endpoint of its subtree (MaxEndpointAggregate), which the insertions, removals
+    // and rotations keep up to date like every aggregate. a search for the intervals that overlap [low, high] skips
+    // the subtrees whose largest endpoint is below low and everything that starts after high
+    template <typename T, template <typename> class Allocator = SlabAllocator>
+    class IntervalTree
+    {
+    public:
+        typedef Interval<T> IntervalType;
+        typedef Tree<IntervalType, ThreeWayCompare<IntervalType>, Allocator, MaxEndpointAggregate<T>> TreeType;
+        typedef typename TreeType::const_iterator const_iterator;
+        typedef typename TreeType::NoSuchElementException NoSuchElementException;
+        typedef typename TreeType::ElementAlreadyExistsException ElementAlreadyExistsException;
+
+        IntervalTree() {}
+
+        // low must not be greater than high. throws ElementAlreadyExistsException if the interval is already in
+        // the tree (two intervals with the same endpoints are the same)
+        void insert(const T &low, const T &high);
+        // throws NoSuchElementException if the interval isn't in the tree
+        void remove(const T &low, const T &high);
+        // the same without exceptions, they return whether the interval was inserted or erased
+        bool try_insert(const T &low, const T &high);
+        bool try_erase(const T &low, const T &high) { return __tree.try_erase(IntervalType(low, high)); }
+        bool contains(const T &low, const T &high) const { return __tree.contains(IntervalType(low, high)); }
+        void clear() { __tree.clear(); }
+
+        const bool isEmpty() const { return __tree.isEmpty(); }
+        const int size() const { return __tree.size(); }
+
+        // calls do_something on every interval that overlaps [low, high] (shares at least one point with it), in
+        // order, and stops early once do_something returns false. the subtrees without an overlapping interval
+        // are skipped, except those along the search path of high. Time Complexity: O(log n + k) for k intervals
+        // that are neighbours in the order of the tree, O(log n + k log(n / k)) at worst (when they are spread
+        // out between intervals that end earlier)
+        template <typename FunctionObject>
+        void find_overlapping(const T &low, const T &high, FunctionObject do_something) const;
+        // the stabbing query: calls do_something on every interval that contains point, like find_overlapping()
+        template <typename FunctionObject>
+        void stab(const T &point, FunctionObject do_something) const { find_overlapping(point, point, do_something); }
+        // returns the first interval (in order) that overlaps [low, high], nullptr if there's none. Time Complexity: O(log n)
+        const IntervalType *find_any_overlapping(const T &low, const T &high) const;
+
+        // iterators over the intervals in order, see Tree::const_iterator
+        const_iterator begin() const { return __tree.begin(); }
+        const_iterator end() const { return __tree.end(); }
+
+        template <typename FunctionObject>
+        void in_order_traversal(FunctionObject do_something)
+        {
+            __tree.in_order_traversal(do_something);
+        }
+
+    private:
+        TreeType __tree;
+    };
+
+    template <typename T, template <typename> class Allocator>
+    void IntervalTree<T, Allocator>::insert(const T &low, const T &high)
+    {
+        assert(!(high < low));
+        __tree.insert(IntervalType(low, high));
+    }
+
+    template <typename T, template <typename> class Allocator>
+    void IntervalTree<T, Allocator>::remove(const T &low, const T &high)
+    {
+        __tree.remove(IntervalType(low, high));
+    }
+
+    template <typename T, template <typename> class Allocator>
+    bool IntervalTree<T, Allocator>::try_insert(const T &low, const T &high)
+    {
+        assert(!(high < low));
+        return __tree.try_insert(IntervalType(low, high));
+    }
+
+    template <typename T, template <typename> class Allocator>
+    template <typename FunctionObject>
+    void IntervalTree<T, Allocator>::find_overlapping(const T &low, const T &high, FunctionObject do_something) const
+    {
+        // the scan ends at the first interval that starts after high (no interval can mark that end when high
+        // is the largest T, infinity included), and a subtree holds an interval that reaches low only if its
+        // largest endpoint does
+        __tree.pruned_traversal([&](const IntervalType &interval) { return high < interval.low; },
+                                [&](const T &max_endpoint) { return !(max_endpoint < low); },
+                                do_something);
+    }
+
+    template <typename T, template <typename> class Allocator>
+    const typename IntervalTree<T, Allocator>::IntervalType *IntervalTree<T, Allocator>::find_any_overlapping(const T &low, const T &high) const
+    {
+        // every subtree the search enters on the left of the search path of high holds an overlapping interval,
+        // so it never has to come back up
+        const IntervalType *found = nullptr;
+        find_overlapping(low, high, [&](const IntervalType &interval) {
+            found = &interval;
+            return false;
+        });
+        return found;
+    }
+};
+
+#endif // _AVL_INTERVAL_TREE_H_
@@ -0,0 +1,220 @@
+#ifndef _AVL_MAP_H_
+#define _AVL_MAP_H_
+
+#include <utility>
+
+#include "AVLTree.h"
+#include "AVLUtility.h"
+
+namespace avl
+{
+    // the element of a Map. the key comes first, so a search reads it from the same cache line as the links
+    // of the node (see Tree::Node) and never touches the value
+    template <typename Key, typename Value>
+    struct MapEntry
+    {
+        // tag of the constructor that builds the value in place
+        struct Emplace
+        {
+        };
+
+        Key first;
+        Value second;
+
+        MapEntry(const Key &key, const Value &value) : first(key), second(value) {}
+
+        template <typename... Args>
+        MapEntry(Emplace, const Key &key, Args &&...args) : first(key), second(std::forward<Args>(args)...) {}
+    };
+
+    // orders the entries by their keys with the key comparator, and compares entries with keys directly so
+    // the tree searches by key without building an entry. it keeps the kind of the key comparator
+    // (three-way or less-than, see AVLUtility.h)
+    template <typename Key, typename Value, typename Compare>
+    class MapEntryCompare : private CompareStorage<Compare>
+    {
+    public:
+        typedef void is_transparent;
+        typedef MapEntry<Key, Value> Entry;
+
+        MapEntryCompare() : CompareStorage<Compare>(Compare()) {}
+        explicit MapEntryCompare(const Compare &compare) : CompareStorage<Compare>(compare) {}
+
+        using CompareStorage<Compare>::comparator;
+
+        auto operator()(const Entry &left, const Entry &right) const -> decltype(std::declval<const Compare &>()(left.first, right.first))
+        {
+            return comparator()(left.first, right.first);
+        }
+
+        template <typename K>
+        auto operator()(const Entry &left, const K &right) const -> decltype(std::declval<const Compare &>()(left.first, right))
+        {
+            return comparator()(left.first, right);
+        }
+
+        template <typename K>
+        auto operator()(const K &left, const Entry &right) const -> decltype(std::declval<const Compare &>()(left, right.first))
+        {
+            return comparator()(left, right.first);
+        }
+    };
+
+    // an ordered map on top of Tree (same nodes, same rebalancing), every lookup goes by key alone:
+    // no entry or value is constructed to search, and try_emplace() / operator[] build the value only when
+    // the key is missing, in the node itself.
+    // Compare compares keys (see AVLUtility.h), when it is transparent keys of other types can be looked up too
+    template <typename Key,
+              typename Value,
+              typename Compare = ThreeWayCompare<Key>,
+              template <typename> class Allocator = SlabAllocator>
+    class Map
+    {
+    public:
+        typedef MapEntry<Key, Value> Entry;
+        typedef Tree<Entry, MapEntryCompare<Key, Value, Compare>, Allocator> TreeType;
+        typedef typename TreeType::const_iterator const_iterator;
+        typedef typename TreeType::NoSuchElementException NoSuchElementException;
+
+        Map();
+        explicit Map(const Compare &compare);
+
+        const Compare &comparator() const { return __tree.comparator().comparator(); }
+
+        // returns the value of the key, throws NoSuchElementException if it isn't in the map
+        Value &find(const Key &key);
+        const Value &find(const Key &key) const;
+        template <typename K, typename C = Compare, typename = typename C::is_transparent>
+        Value &find(const K &key) { return value(__tree.find(key)); }
+        template <typename K, typename C = Compare, typename = typename C::is_transparent>
+        const Value &find(const K &key) const { return __tree.find(key).second; }
+
+        // lookups that don't throw: whether the key is in the map, and a pointer to its value (nullptr if it isn't)
+        bool contains(const Key &key) const { return __tree.contains(key); }
+        Value *try_find(const Key &key)
+        {
+            const Entry *entry = __tree.try_find(key);
+            return (entry != nullptr) ? &value(*entry) : nullptr;
+        }
+        const Value *try_find(const Key &key) const
+        {
+            const Entry *entry = __tree.try_find(key);
+            return (entry != nullptr) ? &entry->second : nullptr;
+        }
+
+        // returns the value of the key, a value-initialized one is inserted first if the key isn't in the map
+        Value &operator[](const Key &key);
+
+        // inserts the key with the value or assigns the value to the key if it's already in the map,
+        // returns whether it was inserted
+        bool insert_or_assign(const Key &key, const Value &new_value);
+        // inserts the key with the value constructed from args if the key isn't in the map yet, otherwise
+        // nothing happens (args are left untouched), returns whether it was inserted
+        template <typename... Args>
+        bool try_emplace(const Key &key, Args &&...args);
+
+        // throws NoSuchElementException if the key isn't in the map
+        void remove(const Key &key);
+        // returns whether the key was in the map
+        bool try_erase(const Key &key) { return __tree.try_erase(key); }
+        void clear();
+
+        const bool isEmpty() const;
+        const int size() const;
+
+        // iterators over the entries in key order, see Tree::const_iterator
+        const_iterator begin() const { return __tree.begin(); }
+        const_iterator end() const { return __tree.end(); }
+        const_iterator lower_bound(const Key &key) const { return __tree.lower_bound(key); }
+        const_iterator upper_bound(const Key &key) const { return __tree.upper_bound(key); }
+
+        // calls do_something(key, value) on every entry in key order, the value may be changed
+        template <typename FunctionObject>
+        void in_order_traversal(FunctionObject do_something)
+        {
+            __tree.in_order_traversal([&](const Entry &entry) { do_something(entry.first, value(entry)); });
+        }
+
+    private:
+        TreeType __tree;
+
+        // the tree only hands out its elements as const since changing them could break its order,
+        // the value isn't part of the order so the map may change it
+        static Value &value(const Entry &entry)
+        {
+            return const_cast<Entry &>(entry).second;
+        }
+    };
+
+    template <typename Key, typename Value, typename Compare, template <typename> class Allocator>
+    Map<Key, Value, Compare, Allocator>::Map() : Map(Compare())
+    {
+    }
+
+    template <typename Key, typename Value, typename Compare, template <typename> class Allocator>
+    Map<Key, Value, Compare, Allocator>::Map(const Compare &compare) : __tree(MapEntryCompare<Key, Value, Compare>(compare))
+    {
+    }
+
+    template <typename Key, typename Value, typename Compare, template <typename> class Allocator>
+    Value &Map<Key, Value, Compare, Allocator>::find(const Key &key)
+    {
+        return value(__tree.find(key));
+    }
+
+    template <typename Key, typename Value, typename Compare, template <typename> class Allocator>
+    const Value &Map<Key, Value, Compare, Allocator>::find(const Key &key) const
+    {
+        return __tree.find(key).second;
+    }
+
+    template <typename Key, typename Value, typename Compare, template <typename> class Allocator>
+    Value &Map<Key, Value, Compare, Allocator>::operator[](const Key &key)
+    {
+        return value(*__tree.find_or_emplace(key, typename Entry::Emplace(), key).first);
+    }
+
+    template <typename Key, typename Value, typename Compare, template <typename> class Allocator>
+    bool Map<Key, Value, Compare, Allocator>::insert_or_assign(const Key &key, const Value &new_value)
+    {
+        std::pair<const_iterator, bool> result = __tree.find_or_emplace(key, key, new_value);
+        if (!result.second)
+        {
+            value(*result.first) = new_value;
+        }
+        return result.second;
+    }
+
+    template <typename Key, typename Value, typename Compare, template <typename> class Allocator>
+    template <typename... Args>
+    bool Map<Key, Value, Compare, Allocator>::try_emplace(const Key &key, Args &&...args)
+    {
+        return __tree.find_or_emplace(key, typename Entry::Emplace(), key, std::forward<Args>(args)...).second;
+    }
+
+    template <typename Key, typename Value, typename Compare, template <typename> class Allocator>
+    void Map<Key, Value, Compare, Allocator>::remove(const Key &key)
+    {
+        __tree.remove(key);
+    }
+
+    template <typename Key, typename Value, typename Compare, template <typename> class Allocator>
+    void Map<Key, Value, Compare, Allocator>::clear()
+    {
+        __tree.clear();
+    }
+
+    template <typename Key, typename Value, typename Compare, template <typename> class Allocator>
+    const bool Map<Key, Value, Compare, Allocator>::isEmpty() const
+    {
+        return __tree.isEmpty();
+    }
+
+    template <typename Key, typename Value, typename Compare, template <typename> class Allocator>
+    const int Map<Key, Value, Compare, Allocator>::size() const
+    {
+        return __tree.size();
+    }
+};
+
+#endif // _AVL_MAP_H_
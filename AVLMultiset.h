@@ -0,0 +1,63 @@
+#ifndef _AVL_MULTISET_H_
+#define _AVL_MULTISET_H_
+
+namespace avl
+{
+    /*
+    a duplicates policy decides what the tree does with an element equal to one it already holds:
+
+    struct Policy
+    {
+        static constexpr bool MULTISET; // whether equal elements are kept, insert() then never throws
+        static constexpr bool COUNTED;  // whether the node of a key counts its occurrences (rather than one node each)
+    };
+
+    with either multiset policy size(), the order statistics and the aggregates count every occurrence,
+    remove() and try_erase() remove one of them and count(), erase_one() and erase_all() are O(log n)
+    */
+
+    // the default policy, equal elements are rejected (insert() throws ElementAlreadyExistsException)
+    struct UniqueKeys
+    {
+        static constexpr bool MULTISET = false;
+        static constexpr bool COUNTED = false;
+    };
+
+    // a key is stored once with the number of its occurrences, for elements that are identical when they compare
+    // equal. the iterators and traversals visit each key once
+    struct CountedKeys
+    {
+        static constexpr bool MULTISET = true;
+        static constexpr bool COUNTED = true;
+    };
+
+    // every element gets a node of its own and equal elements form a chain of adjacent nodes in insertion order:
+    // a new one goes after the equal ones, erase_one() and find() take the oldest
+    struct ChainedKeys
+    {
+        static constexpr bool MULTISET = true;
+        static constexpr bool COUNTED = false;
+    };
+
+    // the base of the tree nodes that holds the occurrences of the key, it is empty (and adds nothing to the node)
+    // unless the policy counts them
+    template <typename Duplicates, bool = Duplicates::COUNTED>
+    struct OccurrenceStorage
+    {
+        int occurrences() const { return 1; }
+        void addOccurrences(int) {}
+    };
+
+    template <typename Duplicates>
+    struct OccurrenceStorage<Duplicates, true>
+    {
+        int __occurrences;
+
+        OccurrenceStorage() : __occurrences(1) {}
+
+        int occurrences() const { return __occurrences; }
+        void addOccurrences(int count) { __occurrences += count; }
+    };
+};
+
+#endif // _AVL_MULTISET_H_
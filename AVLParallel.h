@@ -0,0 +1,352 @@
+#ifndef _AVL_PARALLEL_H_
+#define _AVL_PARALLEL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#if __cplusplus >= 201402L
+#include <shared_mutex>
+#endif
+#include <thread>
+#include <vector>
+
+namespace avl
+{
+    // the number of threads the parallel algorithms split their work between
+    inline int hardware_threads()
+    {
+        unsigned int threads = std::thread::hardware_concurrency();
+        return threads == 0 ? 1 : int(threads);
+    }
+
+    // runs both function objects and returns when both are done, when fork is true
+    // the first one runs on a new thread while the second one runs on the calling thread
+    template <typename FirstFunction, typename SecondFunction>
+    void fork_join(bool fork, FirstFunction first, SecondFunction second)
+    {
+        if (!fork)
+        {
+            first();
+            second();
+            return;
+        }
+        std::thread worker(first); // beware of std::system_error if no thread could be started
+        try
+        {
+            second();
+        }
+        catch (...)
+        {
+            worker.join();
+            throw;
+        }
+        worker.join();
+    }
+
+    // runs task(i) for every i in [0, count) on up to `threads` threads (the calling thread is one of them) and
+    // returns when all are done. every thread starts with an even share of the indices and takes them from the
+    // front, a thread whose share runs out steals the back half of the largest share left, so tasks of uneven
+    // cost still keep all the threads busy. the first exception a task throws is rethrown once all threads stopped
+    template <typename Task>
+    void parallel_for_index(int count, Task task, int threads = hardware_threads())
+    {
+        if (count <= 0)
+        {
+            return;
+        }
+        threads = std::max(1, std::min(threads, count));
+        if (threads == 1)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                task(i);
+            }
+            return;
+        }
+
+        // a share is the range [begin, end) packed into one word, so the owner (taking from the front) and
+        // thieves (taking from the back) agree through a single compare-and-swap. the padding keeps the shares
+        // of different threads off each other's cache line
+        struct Share
+        {
+            std::atomic<std::uint64_t> __range;
+            char __padding[64 - sizeof(std::atomic<std::uint64_t>)];
+        };
+        auto pack = [](std::uint64_t begin, std::uint64_t end) { return (begin << 32) | end; };
+        auto begin_of = [](std::uint64_t range) { return int(range >> 32); };
+        auto end_of = [](std::uint64_t range) { return int(range & 0xffffffffu); };
+
+        std::unique_ptr<Share[]> shares(new Share[threads]);
+        for (int t = 0; t < threads; t++)
+        {
+            shares[t].__range.store(pack(std::uint64_t(count) * t / threads, std::uint64_t(count) * (t + 1) / threads));
+        }
+        std::exception_ptr error;
+        std::mutex error_lock;
+        std::atomic<bool> failed(false);
+
+        auto work = [&](int self) {
+            Share &mine = shares[self];
+            while (!failed.load(std::memory_order_relaxed))
+            {
+                std::uint64_t range = mine.__range.load();
+                int begin = begin_of(range), end = end_of(range);
+                if (begin < end)
+                {
+                    if (!mine.__range.compare_exchange_weak(range, pack(begin + 1, end)))
+                    {
+                        continue;
+                    }
+                    try
+                    {
+                        task(begin);
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard<std::mutex> guard(error_lock);
+                        if (!error)
+                        {
+                            error = std::current_exception();
+                        }
+                        failed.store(true);
+                    }
+                    continue;
+                }
+                // steal the back half of the largest share, stop once every share is empty
+                int victim = -1, largest = 0;
+                for (int t = 0; t < threads; t++)
+                {
+                    std::uint64_t other = shares[t].__range.load(std::memory_order_relaxed);
+                    if (end_of(other) - begin_of(other) > largest)
+                    {
+                        largest = end_of(other) - begin_of(other);
+                        victim = t;
+                    }
+                }
+                if (victim < 0)
+                {
+                    return;
+                }
+                std::uint64_t other = shares[victim].__range.load();
+                int other_begin = begin_of(other), other_end = end_of(other);
+                if (other_begin >= other_end)
+                {
+                    continue;
+                }
+                int middle = other_begin + (other_end - other_begin) / 2;
+                if (shares[victim].__range.compare_exchange_strong(other, pack(other_begin, middle)))
+                {
+                    mine.__range.store(pack(middle, other_end)); // nobody steals from an empty share
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        try
+        {
+            for (int t = 1; t < threads; t++)
+            {
+                workers.emplace_back(work, t); // beware of std::system_error if no thread could be started
+            }
+        }
+        catch (...)
+        {
+            failed.store(true);
+            for (std::thread &worker : workers)
+            {
+                worker.join();
+            }
+            throw;
+        }
+        work(0);
+        for (std::thread &worker : workers)
+        {
+            worker.join();
+        }
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    // merge sort whose halves are sorted on up to `threads` threads, small ranges use std::sort
+    template <typename RandomIterator, typename Less>
+    void parallel_sort(RandomIterator first, RandomIterator last, Less less, int threads = hardware_threads())
+    {
+        const long SEQUENTIAL_CUTOFF = 1 << 14;
+        if (threads <= 1 || (last - first) <= SEQUENTIAL_CUTOFF)
+        {
+            std::sort(first, last, less);
+            return;
+        }
+        RandomIterator middle = first + (last - first) / 2;
+        fork_join(
+            true,
+            [=]() { parallel_sort(first, middle, less, threads / 2); },
+            [=]() { parallel_sort(middle, last, less, threads - threads / 2); });
+        std::inplace_merge(first, middle, last, less);
+    }
+
+    // a reader-writer lock (lock() / unlock() and lock_shared() / unlock_shared()), the standard one when there's
+    // one (C++14) and otherwise a mutex and a condition variable where a waiting writer holds back new readers
+#if __cplusplus >= 201703L
+    typedef std::shared_mutex SharedMutex;
+#elif __cplusplus >= 201402L
+    typedef std::shared_timed_mutex SharedMutex;
+#else
+    class SharedMutex
+    {
+    public:
+        SharedMutex() : __readers(0), __writer(false), __waiting_writers(0) {}
+        SharedMutex(const SharedMutex &) = delete;
+        SharedMutex &operator=(const SharedMutex &) = delete;
+
+        void lock()
+        {
+            std::unique_lock<std::mutex> guard(__mutex);
+            __waiting_writers++;
+            __changed.wait(guard, [this]() { return !__writer && __readers == 0; });
+            __waiting_writers--;
+            __writer = true;
+        }
+
+        void unlock()
+        {
+            {
+                std::lock_guard<std::mutex> guard(__mutex);
+                __writer = false;
+            }
+            __changed.notify_all();
+        }
+
+        void lock_shared()
+        {
+            std::unique_lock<std::mutex> guard(__mutex);
+            __changed.wait(guard, [this]() { return !__writer && __waiting_writers == 0; });
+            __readers++;
+        }
+
+        void unlock_shared()
+        {
+            bool last;
+            {
+                std::lock_guard<std::mutex> guard(__mutex);
+                last = (--__readers == 0);
+            }
+            if (last)
+            {
+                __changed.notify_all();
+            }
+        }
+
+    private:
+        std::mutex __mutex;
+        std::condition_variable __changed;
+        int __readers;
+        bool __writer;
+        int __waiting_writers;
+    };
+#endif
+
+    // holds a reader-writer lock in shared mode for its lifetime, like std::shared_lock (C++14)
+    template <typename Lock>
+    class SharedLockGuard
+    {
+    public:
+        explicit SharedLockGuard(Lock &lock) : __lock(lock) { __lock.lock_shared(); }
+        ~SharedLockGuard() { __lock.unlock_shared(); }
+        SharedLockGuard(const SharedLockGuard &) = delete;
+        SharedLockGuard &operator=(const SharedLockGuard &) = delete;
+
+    private:
+        Lock &__lock;
+    };
+
+    // a small number for the calling thread, handed out in the order the threads first ask for one
+    inline int thread_number()
+    {
+        static std::atomic<int> next(0);
+        thread_local int number = next.fetch_add(1, std::memory_order_relaxed);
+        return number;
+    }
+
+    // a lock for critical sections of a few instructions, waiting threads spin and yield
+    class SpinLock
+    {
+    public:
+        SpinLock() : __locked(false) {}
+        SpinLock(const SpinLock &) = delete;
+        SpinLock &operator=(const SpinLock &) = delete;
+
+        void lock()
+        {
+            while (__locked.exchange(true, std::memory_order_acquire))
+            {
+                while (__locked.load(std::memory_order_relaxed))
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        bool try_lock() { return !__locked.load(std::memory_order_relaxed) && !__locked.exchange(true, std::memory_order_acquire); }
+        void unlock() { __locked.store(false, std::memory_order_release); }
+
+    private:
+        std::atomic<bool> __locked;
+    };
+
+    // a counter that many threads add to at once: every thread adds to one of SLOTS counters (by its thread number)
+    // that lie on cache lines of their own, and reading it sums them up
+    class StripedCounter
+    {
+    public:
+        static constexpr int SLOTS = 64;
+
+        StripedCounter()
+        {
+            for (int i = 0; i < SLOTS; i++)
+            {
+                __slots[i].__value.store(0, std::memory_order_relaxed);
+            }
+        }
+        StripedCounter(const StripedCounter &) = delete;
+        StripedCounter &operator=(const StripedCounter &) = delete;
+
+        void add(long long count) { __slots[thread_number() % SLOTS].__value.fetch_add(count, std::memory_order_relaxed); }
+
+        long long get() const
+        {
+            long long sum = 0;
+            for (int i = 0; i < SLOTS; i++)
+            {
+                sum += __slots[i].__value.load(std::memory_order_relaxed);
+            }
+            return sum;
+        }
+
+        void reset()
+        {
+            for (int i = 0; i < SLOTS; i++)
+            {
+                __slots[i].__value.store(0, std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        // the padding keeps the values of two slots at least a cache line apart
+        struct Slot
+        {
+            std::atomic<long long> __value;
+            char __padding[64];
+        };
+
+        Slot __slots[SLOTS];
+    };
+};
+
+#endif // _AVL_PARALLEL_H_
@@ -0,0 +1,421 @@
+#ifndef _AVL_PERSISTENT_TREE_H_
+#define _AVL_PERSISTENT_TREE_H_
+
+#include <atomic>
+#include <cassert>
+#include <exception>
+
+#include "AVLUtility.h"
+
+namespace avl
+{
+    // an AVL tree whose versions share structure: insert and remove copy only the nodes on the
+    // root-to-leaf path that are shared with other versions (nodes that nobody else references are
+    // changed in place), the rest is shared through reference counting.
+    //
+    // snapshot() (or a copy) is O(1) and gives an immutable version that any number of threads may read
+    // concurrently without locks while a single writer keeps modifying the tree it came from.
+    // a PersistentTree object itself is not thread safe, every thread works on its own copy
+    template <typename DATA_t, typename Compare = ThreeWayCompare<DATA_t>>
+    class PersistentTree : private CompareStorage<Compare>
+    {
+    public:
+        PersistentTree();
+        explicit PersistentTree(const Compare &compare);
+        PersistentTree(const PersistentTree &other);
+        PersistentTree &operator=(const PersistentTree &other);
+        ~PersistentTree();
+
+        using CompareStorage<Compare>::comparator;
+
+        // returns the current version of the tree, later changes to this tree don't affect it. Time Complexity: O(1)
+        const PersistentTree snapshot() const;
+
+        void insert(const DATA_t &data);
+        void remove(const DATA_t &data);
+
+        void clear();
+        const bool isEmpty() const;
+        const int size() const;
+
+        bool contains(const DATA_t &data) const;
+        const DATA_t &find(const DATA_t &data) const;
+        const DATA_t &getMin() const;
+        const DATA_t &getMax() const;
+
+        template <typename FunctionObject>
+        void in_order_traversal(FunctionObject do_something) const
+        {
+            in_order_traversal_aux_recursive(__root, do_something);
+        }
+
+        template <typename FunctionObject>
+        void reverse_in_order_traversal(FunctionObject do_something) const
+        {
+            reverse_in_order_traversal_aux_recursive(__root, do_something);
+        }
+
+        // error classes
+        class NoSuchElementException : public std::exception
+        {
+        public:
+            const char *what() const noexcept override { return "There is no such element"; }
+        };
+        class ElementAlreadyExistsException : public std::exception
+        {
+        public:
+            const char *what() const noexcept override { return "Element already exists"; }
+        };
+
+    private:
+        struct Node
+        {
+            DATA_t __data;
+            Node *__left, *__right; // every node holds a reference to its children
+            int __height;
+            std::atomic<int> __references;
+
+            Node(const DATA_t &data, Node *left = nullptr, Node *right = nullptr) : __data(data),
+                                                                                     __left(left),
+                                                                                     __right(right),
+                                                                                     __height(0),
+                                                                                     __references(1)
+            {
+                updateValues();
+            }
+
+            void updateValues()
+            {
+                __height = 1 + max(__left != nullptr ? __left->__height : -1,
+                                   __right != nullptr ? __right->__height : -1);
+            }
+
+            int balanceFactor() const
+            {
+                return (__left != nullptr ? __left->__height : -1) - (__right != nullptr ? __right->__height : -1);
+            }
+        };
+
+        Node *__root;
+        int __size;
+
+        static Node *acquire(Node *node)
+        {
+            if (node != nullptr)
+            {
+                node->__references.fetch_add(1, std::memory_order_relaxed);
+            }
+            return node;
+        }
+
+        static void release(Node *node)
+        {
+            if (node != nullptr && node->__references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                release(node->__left);
+                release(node->__right);
+                delete node;
+            }
+        }
+
+        // takes a reference to node and returns a reference to a node with the same content that nobody else
+        // references, so it can be changed in place (node itself if it's not shared, otherwise a copy)
+        static Node *unshare(Node *node)
+        {
+            if (node->__references.load(std::memory_order_acquire) == 1)
+            {
+                return node;
+            }
+            Node *copy = new Node(node->__data, acquire(node->__left), acquire(node->__right)); // beware of bad_alloc
+            release(node);
+            return copy;
+        }
+
+        // all the functions below take a reference to the node they get and return a reference to the result
+
+        static Node *left_rotate(Node *node)
+        {
+            Node *R = node->__right = unshare(node->__right);
+            node->__right = R->__left;
+            R->__left = node;
+
+            node->updateValues(); // the order is important
+            R->updateValues();
+
+            return R;
+        }
+
+        static Node *right_rotate(Node *node)
+        {
+            Node *L = node->__left = unshare(node->__left);
+            node->__left = L->__right;
+            L->__right = node;
+
+            node->updateValues(); // the order is important
+            L->updateValues();
+
+            return L;
+        }
+
+        // node must not be shared
+        static Node *balance(Node *node)
+        {
+            node->updateValues();
+            if (node->balanceFactor() >= 2)
+            {
+                if (node->__left->balanceFactor() < 0)
+                { // left - right
+                    node->__left = left_rotate(unshare(node->__left));
+                }
+                return right_rotate(node); // left - left
+            }
+            if (node->balanceFactor() <= -2)
+            {
+                if (node->__right->balanceFactor() > 0)
+                { // right - left
+                    node->__right = right_rotate(unshare(node->__right));
+                }
+                return left_rotate(node); // right - right
+            }
+            return node;
+        }
+
+        // data must not be in the tree
+        Node *insert_aux(Node *root, const DATA_t &data) const
+        {
+            if (root == nullptr)
+            {
+                return new Node(data); // beware of bad_alloc
+            }
+            root = unshare(root);
+            if (avl::less(comparator(), data, root->__data))
+            {
+                root->__left = insert_aux(root->__left, data);
+            }
+            else
+            {
+                root->__right = insert_aux(root->__right, data);
+            }
+            return balance(root);
+        }
+
+        // detaches the minimum of the tree into min (which holds a reference to it), returns the rest
+        static Node *remove_min(Node *root, Node *&min)
+        {
+            if (root->__left == nullptr)
+            {
+                min = root;
+                return acquire(root->__right);
+            }
+            root = unshare(root);
+            root->__left = remove_min(root->__left, min);
+            return balance(root);
+        }
+
+        // data must be in the tree
+        Node *remove_aux(Node *root, const DATA_t &data) const
+        {
+            root = unshare(root);
+            Comparison result = three_way(comparator(), data, root->__data);
+            if (result == Comparison::less)
+            {
+                root->__left = remove_aux(root->__left, data);
+            }
+            else if (result == Comparison::greater)
+            {
+                root->__right = remove_aux(root->__right, data);
+            }
+            else if (root->__left == nullptr || root->__right == nullptr)
+            {
+                Node *child = (root->__left != nullptr) ? root->__left : root->__right;
+                root->__left = root->__right = nullptr;
+                release(root);
+                return child;
+            }
+            else
+            { // the successor's data takes the place of the removed data
+                Node *successor = nullptr;
+                root->__right = remove_min(root->__right, successor);
+                root->__data = successor->__data;
+                release(successor);
+            }
+            return balance(root);
+        }
+
+        const Node *find_node(const DATA_t &data) const
+        {
+            const Node *temp = __root;
+            while (temp != nullptr)
+            {
+                Comparison result = three_way(comparator(), data, temp->__data);
+                if (result == Comparison::less)
+                {
+                    temp = temp->__left;
+                }
+                else if (result == Comparison::greater)
+                {
+                    temp = temp->__right;
+                }
+                else
+                {
+                    return temp;
+                }
+            }
+            return nullptr;
+        }
+
+        template <typename FunctionObject>
+        static void in_order_traversal_aux_recursive(const Node *root, FunctionObject &do_something)
+        {
+            if (root == nullptr)
+            {
+                return;
+            }
+            in_order_traversal_aux_recursive(root->__left, do_something);
+            do_something(root->__data);
+            in_order_traversal_aux_recursive(root->__right, do_something);
+        }
+
+        template <typename FunctionObject>
+        static void reverse_in_order_traversal_aux_recursive(const Node *root, FunctionObject &do_something)
+        {
+            if (root == nullptr)
+            {
+                return;
+            }
+            reverse_in_order_traversal_aux_recursive(root->__right, do_something);
+            do_something(root->__data);
+            reverse_in_order_traversal_aux_recursive(root->__left, do_something);
+        }
+    };
+
+    template <typename DATA_t, typename Compare>
+    PersistentTree<DATA_t, Compare>::PersistentTree() : PersistentTree(Compare())
+    {
+    }
+
+    template <typename DATA_t, typename Compare>
+    PersistentTree<DATA_t, Compare>::PersistentTree(const Compare &compare) : CompareStorage<Compare>(compare), __root(nullptr), __size(0)
+    {
+    }
+
+    template <typename DATA_t, typename Compare>
+    PersistentTree<DATA_t, Compare>::PersistentTree(const PersistentTree &other)
+        : CompareStorage<Compare>(other.comparator()), __root(acquire(other.__root)), __size(other.__size)
+    {
+    }
+
+    template <typename DATA_t, typename Compare>
+    PersistentTree<DATA_t, Compare> &PersistentTree<DATA_t, Compare>::operator=(const PersistentTree &other)
+    {
+        CompareStorage<Compare>::operator=(other);
+        Node *old = __root;
+        __root = acquire(other.__root);
+        __size = other.__size;
+        release(old);
+        return *this;
+    }
+
+    template <typename DATA_t, typename Compare>
+    PersistentTree<DATA_t, Compare>::~PersistentTree()
+    {
+        release(__root);
+    }
+
+    template <typename DATA_t, typename Compare>
+    const PersistentTree<DATA_t, Compare> PersistentTree<DATA_t, Compare>::snapshot() const
+    {
+        return *this;
+    }
+
+    template <typename DATA_t, typename Compare>
+    void PersistentTree<DATA_t, Compare>::insert(const DATA_t &data)
+    {
+        if (contains(data))
+        {
+            throw ElementAlreadyExistsException();
+        }
+        __root = insert_aux(__root, data);
+        __size++;
+    }
+
+    template <typename DATA_t, typename Compare>
+    void PersistentTree<DATA_t, Compare>::remove(const DATA_t &data)
+    {
+        if (!contains(data))
+        {
+            throw NoSuchElementException();
+        }
+        __root = remove_aux(__root, data);
+        __size--;
+    }
+
+    template <typename DATA_t, typename Compare>
+    void PersistentTree<DATA_t, Compare>::clear()
+    {
+        release(__root);
+        __root = nullptr;
+        __size = 0;
+    }
+
+    template <typename DATA_t, typename Compare>
+    const bool PersistentTree<DATA_t, Compare>::isEmpty() const
+    {
+        return (__root == nullptr);
+    }
+
+    template <typename DATA_t, typename Compare>
+    const int PersistentTree<DATA_t, Compare>::size() const
+    {
+        return __size;
+    }
+
+    template <typename DATA_t, typename Compare>
+    bool PersistentTree<DATA_t, Compare>::contains(const DATA_t &data) const
+    {
+        return find_node(data) != nullptr;
+    }
+
+    template <typename DATA_t, typename Compare>
+    const DATA_t &PersistentTree<DATA_t, Compare>::find(const DATA_t &data) const
+    {
+        const Node *node = find_node(data);
+        if (node == nullptr)
+        {
+            throw NoSuchElementException();
+        }
+        return node->__data;
+    }
+
+    template <typename DATA_t, typename Compare>
+    const DATA_t &PersistentTree<DATA_t, Compare>::getMin() const
+    {
+        const Node *temp = __root;
+        if (temp == nullptr)
+        {
+            throw NoSuchElementException();
+        }
+        while (temp->__left != nullptr)
+        {
+            temp = temp->__left;
+        }
+        return temp->__data;
+    }
+
+    template <typename DATA_t, typename Compare>
+    const DATA_t &PersistentTree<DATA_t, Compare>::getMax() const
+    {
+        const Node *temp = __root;
+        if (temp == nullptr)
+        {
+            throw NoSuchElementException();
+        }
+        while (temp->__right != nullptr)
+        {
+            temp = temp->__right;
+        }
+        return temp->__data;
+    }
+};
+
+#endif // _AVL_PERSISTENT_TREE_H_
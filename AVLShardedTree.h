@@ -0,0 +1,577 @@
+#ifndef _AVL_SHARDED_TREE_H_
+#define _AVL_SHARDED_TREE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "AVLTree.h"
+#include "AVLParallel.h"
+#include "AVLUtility.h"
+
+namespace avl
+{
+    // a reader-writer lock for data that is read all the time and written rarely: every reader counts itself in
+    // one of SLOTS counters (by its thread number) that lie on cache lines of their own, so readers on
+    // different threads never write to the same line. a writer raises a flag that holds back new readers, then
+    // waits for every counter to drop to 0
+    class ReadMostlyLock
+    {
+    public:
+        static constexpr int SLOTS = 64;
+
+        ReadMostlyLock() : __writer(false)
+        {
+            for (int i = 0; i < SLOTS; i++)
+            {
+                __slots[i].__readers.store(0, std::memory_order_relaxed);
+            }
+        }
+        ReadMostlyLock(const ReadMostlyLock &) = delete;
+        ReadMostlyLock &operator=(const ReadMostlyLock &) = delete;
+
+        void lock_shared()
+        {
+            std::atomic<int> &readers = __slots[thread_slot()].__readers;
+            for (;;)
+            {
+                readers.fetch_add(1, std::memory_order_seq_cst);
+                if (!__writer.load(std::memory_order_seq_cst))
+                {
+                    return;
+                }
+                readers.fetch_sub(1, std::memory_order_release);
+                while (__writer.load(std::memory_order_acquire))
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        void unlock_shared() { __slots[thread_slot()].__readers.fetch_sub(1, std::memory_order_release); }
+
+        void lock()
+        {
+            __writers.lock();
+            __writer.store(true, std::memory_order_seq_cst);
+            for (int i = 0; i < SLOTS; i++)
+            {
+                while (__slots[i].__readers.load(std::memory_order_seq_cst) != 0)
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        void unlock()
+        {
+            __writer.store(false, std::memory_order_release);
+            __writers.unlock();
+        }
+
+    private:
+        // the padding keeps the counters of two slots at least a cache line apart
+        struct Slot
+        {
+            std::atomic<int> __readers;
+            char __padding[64];
+        };
+
+        Slot __slots[SLOTS];
+        std::atomic<bool> __writer;
+        std::mutex __writers;
+
+        static int thread_slot() { return thread_number() % SLOTS; }
+    };
+
+    // a set split into key range shards, each an avl::Tree behind a reader-writer lock of its own, that any number
+    // of threads may use at once. a point operation locks the one shard its key belongs to (found by a binary search
+    // of the bounds between the shards), so operations on different shards never wait for each other. the ordered
+    // scans go through the shards one after the other, holding the next shard before letting go of the last one.
+    //
+    // the bounds follow the keys: every REBALANCE_CHECK writes to a shard, the shard is compared with the average
+    // size of the shards and once it holds more than 1.5 times as many elements plus REBALANCE_SLACK, its excess
+    // moves over to the neighbour on the side that holds fewer elements than its share (the shards before it hold
+    // fewer than average * index for instance) and the bound between them moves with it. a neighbour that grows
+    // too large in turn passes elements on. a tree built with only the number of shards starts with every key
+    // in the first shard and spreads out as it grows
+    template <typename DATA_t, typename Compare = ThreeWayCompare<DATA_t>, template <typename> class Allocator = SlabAllocator>
+    class ShardedTree : private CompareStorage<Compare>
+    {
+    public:
+        typedef Tree<DATA_t, Compare, Allocator> ShardTree;
+
+        static constexpr int REBALANCE_CHECK = 64;
+        static constexpr int REBALANCE_SLACK = 1024;
+
+        explicit ShardedTree(int shards = hardware_threads(), const Compare &compare = Compare());
+        // starts with the shards cut at bounds (strictly increasing), shard i holds the keys in [bounds[i - 1], bounds[i])
+        explicit ShardedTree(const std::vector<DATA_t> &bounds, const Compare &compare = Compare());
+        ShardedTree(const ShardedTree &) = delete;
+        ShardedTree &operator=(const ShardedTree &) = delete;
+
+        using CompareStorage<Compare>::comparator;
+
+        // the same semantics as the operations of avl::Tree, the lookups return a copy of the element since
+        // the element may be gone as soon as the shard is unlocked
+        void insert(const DATA_t &data);
+        void remove(const DATA_t &data);
+        bool try_insert(const DATA_t &data);
+        bool try_erase(const DATA_t &data);
+        bool contains(const DATA_t &data) const;
+        DATA_t find(const DATA_t &data) const;
+        // copies the element equal to data into out, returns false (and leaves out alone) if there's none
+        bool try_find(const DATA_t &data, DATA_t &out) const;
+
+        // clears every shard, the bounds stay where they are
+        void clear();
+        bool isEmpty() const { return size() == 0; }
+        // the sum of the sizes of the shards, exact only while no other thread writes
+        int size() const;
+
+        // calls do_something on every element in order. the writes to a shard the scan has left (or not reached
+        // yet) go on, so the scan sees every element that stays in the set while it runs and maybe some that come
+        // and go meanwhile, but never one twice
+        template <typename FunctionObject>
+        void in_order_traversal(FunctionObject do_something) const
+        {
+            scan(nullptr, nullptr, [&do_something](const DATA_t &data) { do_something(data); return true; });
+        }
+
+        // calls do_something on every element x with low <= x <= high in order, the scan stops early once
+        // do_something returns false
+        template <typename FunctionObject>
+        void range_traversal(const DATA_t &low, const DATA_t &high, FunctionObject do_something) const
+        {
+            scan(&low, &high, do_something);
+        }
+
+        // spreads the elements evenly over the shards and moves the bounds to match, after a bulk load for instance.
+        // it locks every shard at once. Time Complexity: O(n)
+        void rebalance_shards();
+
+        int shard_count() const { return int(__shards.size()); }
+        int shard_size(int shard) const { return __shards[shard]->__size.load(std::memory_order_relaxed); }
+
+        // error classes
+        typedef typename ShardTree::NoSuchElementException NoSuchElementException;
+        typedef typename ShardTree::ElementAlreadyExistsException ElementAlreadyExistsException;
+
+    private:
+        struct Shard
+        {
+            mutable SharedMutex __lock;
+            ShardTree __tree;
+            // the keys of the shard are [low, high), a missing bound is infinite. the shards past the last bound
+            // of the table are inactive (they have no keys at all) until the shard before them hands some over
+            std::unique_ptr<DATA_t> __low, __high;
+            bool __active;
+            // the size of the tree, written under the lock and read by the neighbours without it
+            std::atomic<int> __size;
+            int __writes;
+            int __index;
+            // keeps the counters of two shards on different cache lines
+            char __padding[64];
+
+            Shard(int index, bool active, const Compare &compare) : __tree(compare), __active(active), __size(0), __writes(0), __index(index) {}
+
+            bool holds(const DATA_t &key) const
+            {
+                return __active && (__low == nullptr || !less(__tree.comparator(), key, *__low)) &&
+                       (__high == nullptr || less(__tree.comparator(), key, *__high));
+            }
+
+            // counts a write, returns whether the shard is due to be compared with its neighbours
+            bool wrote()
+            {
+                __size.store(__tree.size(), std::memory_order_relaxed);
+                return ++__writes % REBALANCE_CHECK == 0;
+            }
+        };
+
+        // the shard of a key locked in shared or exclusive mode, for the lifetime of the object
+        class LockedShard
+        {
+        public:
+            LockedShard(const ShardedTree &tree, const DATA_t &key, bool exclusive);
+            ~LockedShard()
+            {
+                if (__exclusive)
+                    __shard->__lock.unlock();
+                else
+                    __shard->__lock.unlock_shared();
+            }
+            LockedShard(const LockedShard &) = delete;
+            LockedShard &operator=(const LockedShard &) = delete;
+
+            Shard &operator*() const { return *__shard; }
+            Shard *operator->() const { return __shard; }
+
+        private:
+            Shard *__shard;
+            bool __exclusive;
+        };
+
+        std::vector<std::unique_ptr<Shard>> __shards;
+        // the bounds between the active shards, shard i holds [__bounds[i - 1], __bounds[i]), guarded by __routing
+        std::vector<DATA_t> __bounds;
+        mutable ReadMostlyLock __routing;
+
+        bool is_less(const DATA_t &left, const DATA_t &right) const { return less(comparator(), left, right); }
+
+        // returns the index of the shard that held key when the table was read
+        int route(const DATA_t &key) const;
+        // moves the excess of shard (and then of the neighbours it went to) if it is too large
+        void check_neighbours(int shard);
+        // moves count elements from the shard `shard` to shard + 1, or -count elements from shard + 1 to shard
+        // if count is negative (as many as there are, a shard that gives elements to the one before it keeps one).
+        // returns whether elements moved
+        bool rebalance_pair(int shard, int count);
+        // the tests call rebalance_pair() directly, with sizes that check_neighbours() only sees under contention
+        friend struct ShardedTreeTest;
+
+        template <typename FunctionObject>
+        void scan(const DATA_t *low, const DATA_t *high, FunctionObject do_something) const;
+    };
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator>
+    ShardedTree<DATA_t, Compare, Allocator>::ShardedTree(int shards, const Compare &compare) : CompareStorage<Compare>(compare)
+    {
+        shards = std::max(1, shards);
+        for (int i = 0; i < shards; i++)
+        {
+            __shards.emplace_back(new Shard(i, i == 0, compare));
+        }
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator>
+    ShardedTree<DATA_t, Compare, Allocator>::ShardedTree(const std::vector<DATA_t> &bounds, const Compare &compare) : CompareStorage<Compare>(compare),
+                                                                                                                       __bounds(bounds)
+    {
+        for (int i = 0; i <= int(bounds.size()); i++)
+        {
+            __shards.emplace_back(new Shard(i, true, compare));
+            if (i > 0)
+            {
+                __shards[i]->__low.reset(new DATA_t(bounds[i - 1]));
+            }
+            if (i < int(bounds.size()))
+            {
+                __shards[i]->__high.reset(new DATA_t(bounds[i]));
+            }
+        }
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator>
+    ShardedTree<DATA_t, Compare, Allocator>::LockedShard::LockedShard(const ShardedTree &tree, const DATA_t &key, bool exclusive) : __exclusive(exclusive)
+    {
+        for (;;)
+        {
+            __shard = tree.__shards[tree.route(key)].get();
+            if (exclusive)
+                __shard->__lock.lock();
+            else
+                __shard->__lock.lock_shared();
+            if (__shard->holds(key))
+            {
+                return;
+            }
+            // the shard was rebalanced between reading the table and locking it
+            if (exclusive)
+                __shard->__lock.unlock();
+            else
+                __shard->__lock.unlock_shared();
+        }
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator>
+    int ShardedTree<DATA_t, Compare, Allocator>::route(const DATA_t &key) const
+    {
+        SharedLockGuard<ReadMostlyLock> guard(__routing);
+        return int(std::upper_bound(__bounds.begin(), __bounds.end(), key,
+                                    [this](const DATA_t &left, const DATA_t &right) { return is_less(left, right); }) -
+                   __bounds.begin());
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator>
+    void ShardedTree<DATA_t, Compare, Allocator>::insert(const DATA_t &data)
+    {
+        if (!try_insert(data))
+        {
+            throw ElementAlreadyExistsException();
+        }
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator>
+    void ShardedTree<DATA_t, Compare, Allocator>::remove(const DATA_t &data)
+    {
+        if (!try_erase(data))
+        {
+            throw NoSuchElementException();
+        }
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator>
+    bool ShardedTree<DATA_t, Compare, Allocator>::try_insert(const DATA_t &data)
+    {
+        bool inserted, due;
+        int index;
+        {
+            LockedShard shard(*this, data, true);
+            inserted = shard->__tree.try_insert(data);
+            due = inserted && shard->wrote();
+            index = shard->__index;
+        }
+        if (due)
+        {
+            check_neighbours(index);
+        }
+        return inserted;
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator>
+    bool ShardedTree<DATA_t, Compare, Allocator>::try_erase(const DATA_t &data)
+    {
+        bool erased, due;
+        int index;
+        {
+            LockedShard shard(*this, data, true);
+            erased = shard->__tree.try_erase(data);
+            due = erased && shard->wrote();
+            index = shard->__index;
+        }
+        if (due)
+        {
+            check_neighbours(index);
+        }
+        return erased;
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator>
+    bool ShardedTree<DATA_t, Compare, Allocator>::contains(const DATA_t &data) const
+    {
+        LockedShard shard(*this, data, false);
+        return shard->__tree.contains(data);
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator>
+    DATA_t ShardedTree<DATA_t, Compare, Allocator>::find(const DATA_t &data) const
+    {
+        LockedShard shard(*this, data, false);
+        return shard->__tree.find(data);
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator>
+    bool ShardedTree<DATA_t, Compare, Allocator>::try_find(const DATA_t &data, DATA_t &out) const
+    {
+        LockedShard shard(*this, data, false);
+        const DATA_t *found = shard->__tree.try_find(data);
+        if (found == nullptr)
+        {
+            return false;
+        }
+        out = *found;
+        return true;
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator>
+    void ShardedTree<DATA_t, Compare, Allocator>::clear()
+    {
+        for (auto &shard : __shards)
+        {
+            std::lock_guard<SharedMutex> guard(shard->__lock);
+            shard->__tree.clear();
+            shard->__size.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator>
+    int ShardedTree<DATA_t, Compare, Allocator>::size() const
+    {
+        int size = 0;
+        for (auto &shard : __shards)
+        {
+            size += shard->__size.load(std::memory_order_relaxed);
+        }
+        return size;
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator>
+    void ShardedTree<DATA_t, Compare, Allocator>::check_neighbours(int shard)
+    {
+        for (;;)
+        {
+            // the sizes are read without the locks, rebalance_pair() checks them again
+            long long before = 0, total = 0;
+            for (int i = 0; i < shard_count(); i++)
+            {
+                before += (i < shard) ? shard_size(i) : 0;
+                total += shard_size(i);
+            }
+            long long size = shard_size(shard), average = total / shard_count();
+            if (shard_count() == 1 || size <= average + average / 2 + REBALANCE_SLACK)
+            {
+                return;
+            }
+            // the deficits of both sides add up to size - average, the excess goes to the larger one
+            long long left_deficit = average * shard - before;
+            long long right_deficit = average * (shard_count() - 1 - shard) - (total - before - size);
+            long long count = std::min(size - average, std::max(left_deficit, right_deficit));
+            bool left = (shard > 0) && (left_deficit > right_deficit || shard + 1 == shard_count());
+            if (!rebalance_pair(left ? shard - 1 : shard, int(left ? -count : count)))
+            {
+                return;
+            }
+            shard += left ? -1 : 1;
+        }
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator>
+    void ShardedTree<DATA_t, Compare, Allocator>::rebalance_shards()
+    {
+        for (auto &shard : __shards)
+        {
+            shard->__lock.lock();
+        }
+        std::vector<DATA_t> elements;
+        for (auto &shard : __shards)
+        {
+            elements.insert(elements.end(), shard->__tree.begin(), shard->__tree.end());
+        }
+        // every active shard needs an element for its lower bound
+        int active = std::max(1, std::min(shard_count(), int(elements.size())));
+        std::vector<DATA_t> bounds;
+        for (int i = 0; i < shard_count(); i++)
+        {
+            Shard &shard = *__shards[i];
+            auto first = elements.begin() + (i < active ? long(elements.size()) * i / active : long(elements.size()));
+            auto last = elements.begin() + (i < active ? long(elements.size()) * (i + 1) / active : long(elements.size()));
+            shard.__tree.assign(first, last);
+            shard.__size.store(shard.__tree.size(), std::memory_order_relaxed);
+            shard.__active = (i < active);
+            shard.__low.reset((i > 0 && i < active) ? new DATA_t(*first) : nullptr);
+            shard.__high.reset((i + 1 < active) ? new DATA_t(*last) : nullptr);
+            if (i > 0 && i < active)
+            {
+                bounds.push_back(*first);
+            }
+        }
+        {
+            std::lock_guard<ReadMostlyLock> guard(__routing);
+            __bounds.swap(bounds);
+        }
+        for (auto &shard : __shards)
+        {
+            shard->__lock.unlock();
+        }
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator>
+    bool ShardedTree<DATA_t, Compare, Allocator>::rebalance_pair(int shard, int count)
+    {
+        // the shards are locked in index order, like the scans lock them
+        Shard &left = *__shards[shard], &right = *__shards[shard + 1];
+        std::lock_guard<SharedMutex> left_guard(left.__lock);
+        std::lock_guard<SharedMutex> right_guard(right.__lock);
+        int left_size = left.__tree.size(), right_size = right.__tree.size();
+        // the sizes seen by check_neighbours() may be gone by now, either shard may even be empty
+        count = (count > 0) ? std::min(count, left_size) : -std::min(-count, std::max(0, right_size - 1));
+        if (!left.__active || count == 0)
+        {
+            return false;
+        }
+        // the elements are copied, the shards can't share nodes (the join-based operations would make them share
+        // an allocator, which isn't thread safe). erase_range() frees the nodes that moved into the shard's own pool
+        std::vector<DATA_t> moved;
+        if (count > 0)
+        {
+            // the new bound is the smallest element that moves right
+            DATA_t bound = left.__tree.select(left_size - count);
+            moved.assign(left.__tree.lower_bound(bound), left.__tree.end());
+            left.__tree.erase_range(moved.front(), moved.back());
+            right.__tree.insert_batch(moved.begin(), moved.end());
+            left.__high.reset(new DATA_t(bound));
+            right.__low.reset(new DATA_t(bound));
+            right.__active = true;
+        }
+        else
+        {
+            // the new bound is the smallest element that stays
+            DATA_t bound = right.__tree.select(-count);
+            moved.assign(right.__tree.begin(), right.__tree.lower_bound(bound));
+            right.__tree.erase_range(moved.front(), moved.back());
+            left.__tree.insert_batch(moved.begin(), moved.end());
+            left.__high.reset(new DATA_t(bound));
+            right.__low.reset(new DATA_t(bound));
+        }
+        left.__size.store(left.__tree.size(), std::memory_order_relaxed);
+        right.__size.store(right.__tree.size(), std::memory_order_relaxed);
+        std::lock_guard<ReadMostlyLock> guard(__routing);
+        if (shard == int(__bounds.size()))
+        {
+            __bounds.push_back(*left.__high);
+        }
+        else
+        {
+            __bounds[shard] = *left.__high;
+        }
+        return true;
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator>
+    template <typename FunctionObject>
+    void ShardedTree<DATA_t, Compare, Allocator>::scan(const DATA_t *low, const DATA_t *high, FunctionObject do_something) const
+    {
+        // the first shard must not have handed elements >= low to the one before it since the table was read
+        int first;
+        for (;;)
+        {
+            first = (low != nullptr) ? route(*low) : 0;
+            const Shard &shard = *__shards[first];
+            shard.__lock.lock_shared();
+            if (shard.__active && (low == nullptr || shard.__low == nullptr || !is_less(*low, *shard.__low)))
+            {
+                break;
+            }
+            shard.__lock.unlock_shared();
+        }
+        // a rebalancing locks both of its shards, so holding the next shard before unlocking the last one keeps the
+        // elements from moving past the scan
+        for (int i = first; i < shard_count(); i++)
+        {
+            const ShardTree &tree = __shards[i]->__tree;
+            bool done = false;
+            try
+            {
+                for (auto it = (low != nullptr) ? tree.lower_bound(*low) : tree.begin(); it != tree.end(); ++it)
+                {
+                    if ((high != nullptr && is_less(*high, *it)) || !do_something(*it))
+                    {
+                        done = true;
+                        break;
+                    }
+                }
+            }
+            catch (...)
+            {
+                __shards[i]->__lock.unlock_shared();
+                throw;
+            }
+            if (!done && i + 1 < shard_count())
+            {
+                __shards[i + 1]->__lock.lock_shared();
+            }
+            __shards[i]->__lock.unlock_shared();
+            if (done)
+            {
+                return;
+            }
+        }
+    }
+};
+
+#endif // _AVL_SHARDED_TREE_H_
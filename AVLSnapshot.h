@@ -0,0 +1,496 @@
+#ifndef _AVL_SNAPSHOT_H_
+#define _AVL_SNAPSHOT_H_
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define AVL_HAS_MMAP 1
+#endif
+
+#include "AVLUtility.h"
+
+namespace avl
+{
+    /*
+    a snapshot (see Tree::write_snapshot()) is a SnapshotHeader followed by the elements in order as raw bytes and,
+    when the header has SNAPSHOT_SHAPE, by the height of every node in the same order (one byte each).
+    the elements start at offset 64 so a mapped file is read in place (see MappedSnapshot), numbers are in the
+    byte order of the machine that wrote the snapshot, and only trivially copyable elements can be written
+    */
+    static constexpr std::uint32_t SNAPSHOT_VERSION = 1;
+    static constexpr std::uint32_t SNAPSHOT_SHAPE = 1;
+    static constexpr std::uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+    // the writers and the stream readers go through one buffer of this size whatever the size of the tree
+    static constexpr std::size_t SNAPSHOT_BUFFER_SIZE = 1 << 16;
+
+    struct SnapshotHeader
+    {
+        char __magic[8]; // "AVLSNAP" and a zero
+        std::uint32_t __version;
+        std::uint32_t __flags;
+        std::uint64_t __count;
+        std::uint32_t __element_size;
+        std::uint32_t __element_alignment;
+        std::uint32_t __byte_order;
+        char __padding[28];
+    };
+    static_assert(sizeof(SnapshotHeader) == 64, "the elements of a snapshot start at offset 64");
+
+    class SnapshotException : public std::exception
+    {
+    public:
+        explicit SnapshotException(const char *what) : __what(what) {}
+        const char *what() const noexcept override { return __what; }
+
+    private:
+        const char *__what;
+    };
+
+    template <typename DATA_t>
+    SnapshotHeader make_snapshot_header(std::uint64_t count, bool keep_shape)
+    {
+        static_assert(std::is_trivially_copyable<DATA_t>::value, "only trivially copyable elements can be written to a snapshot");
+        static_assert(alignof(DATA_t) <= sizeof(SnapshotHeader), "over-aligned elements can't be mapped in place");
+        SnapshotHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.__magic, "AVLSNAP", 8);
+        header.__version = SNAPSHOT_VERSION;
+        header.__flags = keep_shape ? SNAPSHOT_SHAPE : 0;
+        header.__count = count;
+        header.__element_size = sizeof(DATA_t);
+        header.__element_alignment = alignof(DATA_t);
+        header.__byte_order = SNAPSHOT_BYTE_ORDER;
+        return header;
+    }
+
+    // throws SnapshotException if the header doesn't describe a snapshot of DATA_t this machine can read
+    template <typename DATA_t>
+    void check_snapshot_header(const SnapshotHeader &header)
+    {
+        static_assert(std::is_trivially_copyable<DATA_t>::value, "only trivially copyable elements can be read from a snapshot");
+        if (std::memcmp(header.__magic, "AVLSNAP", 8) != 0)
+        {
+            throw SnapshotException("Not a snapshot");
+        }
+        if (header.__version != SNAPSHOT_VERSION || (header.__flags & ~SNAPSHOT_SHAPE) != 0)
+        {
+            throw SnapshotException("Unsupported snapshot version");
+        }
+        if (header.__byte_order != SNAPSHOT_BYTE_ORDER || header.__element_size != sizeof(DATA_t) ||
+            header.__element_alignment != alignof(DATA_t))
+        {
+            throw SnapshotException("The snapshot holds elements of another type or from another platform");
+        }
+        if (header.__count > std::uint64_t(INT32_MAX))
+        {
+            throw SnapshotException("The snapshot holds too many elements");
+        }
+    }
+
+    // buffered writes to a stream or (on POSIX systems) a file descriptor, throws SnapshotException if one fails
+    class SnapshotWriter
+    {
+    public:
+        explicit SnapshotWriter(std::ostream &out) : __stream(&out), __fd(-1), __buffer(new char[SNAPSHOT_BUFFER_SIZE]), __used(0) {}
+        explicit SnapshotWriter(int fd) : __stream(nullptr), __fd(fd), __buffer(new char[SNAPSHOT_BUFFER_SIZE]), __used(0) {}
+
+        void write(const void *data, std::size_t size)
+        {
+            const char *bytes = static_cast<const char *>(data);
+            while (size > 0)
+            {
+                if (__used == SNAPSHOT_BUFFER_SIZE)
+                {
+                    write_buffer();
+                }
+                std::size_t part = std::min(size, SNAPSHOT_BUFFER_SIZE - __used);
+                std::memcpy(&__buffer[__used], bytes, part);
+                __used += part;
+                bytes += part;
+                size -= part;
+            }
+        }
+
+        void flush()
+        {
+            write_buffer();
+            if (__stream != nullptr && !__stream->flush())
+            {
+                throw SnapshotException("Writing the snapshot failed");
+            }
+        }
+
+    private:
+        std::ostream *__stream;
+        int __fd;
+        std::unique_ptr<char[]> __buffer;
+        std::size_t __used;
+
+        void write_buffer()
+        {
+            if (__stream != nullptr)
+            {
+                if (!__stream->write(__buffer.get(), std::streamsize(__used)))
+                {
+                    throw SnapshotException("Writing the snapshot failed");
+                }
+                __used = 0;
+                return;
+            }
+#ifdef AVL_HAS_MMAP
+            std::size_t written = 0;
+            while (written < __used)
+            {
+                ssize_t result = ::write(__fd, __buffer.get() + written, __used - written);
+                if (result < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (result <= 0)
+                {
+                    throw SnapshotException("Writing the snapshot failed");
+                }
+                written += std::size_t(result);
+            }
+#endif
+            __used = 0;
+        }
+    };
+
+    // buffered reads from a stream or (on POSIX systems) a file descriptor, throws SnapshotException if the
+    // snapshot ends early. it never reads past the end of the snapshot, at first only the header belongs to it
+    // and expect() adds what the header announces
+    class SnapshotReader
+    {
+    public:
+        explicit SnapshotReader(std::istream &in)
+            : __stream(&in), __fd(-1), __begin(0), __end(0), __remaining(sizeof(SnapshotHeader)) { __buffer.resize(SNAPSHOT_BUFFER_SIZE); }
+        explicit SnapshotReader(int fd)
+            : __stream(nullptr), __fd(fd), __begin(0), __end(0), __remaining(sizeof(SnapshotHeader)) { __buffer.resize(SNAPSHOT_BUFFER_SIZE); }
+
+        void expect(std::uint64_t bytes)
+        {
+            __remaining += bytes;
+        }
+
+        void read(void *data, std::size_t size)
+        {
+            char *bytes = static_cast<char *>(data);
+            while (size > 0)
+            {
+                if (__begin == __end)
+                {
+                    fill();
+                }
+                std::size_t part = std::min(size, __end - __begin);
+                if (bytes != nullptr)
+                {
+                    std::memcpy(bytes, __buffer.data() + __begin, part);
+                    bytes += part;
+                }
+                __begin += part;
+                size -= part;
+            }
+        }
+
+        void skip(std::size_t size)
+        {
+            read(nullptr, size);
+        }
+
+    private:
+        std::istream *__stream;
+        int __fd;
+        std::vector<char> __buffer;
+        std::size_t __begin, __end; // the part of the buffer that wasn't read yet
+        std::uint64_t __remaining;  // the bytes of the snapshot that weren't read into the buffer yet
+
+        void fill()
+        {
+            std::size_t wanted = std::size_t(std::min<std::uint64_t>(__buffer.size(), __remaining));
+            std::size_t filled = 0;
+            if (wanted == 0)
+            {
+                throw SnapshotException("The snapshot is truncated");
+            }
+            if (__stream != nullptr)
+            {
+                __stream->read(__buffer.data(), std::streamsize(wanted));
+                filled = std::size_t(__stream->gcount());
+            }
+#ifdef AVL_HAS_MMAP
+            else
+            {
+                ssize_t result;
+                do
+                {
+                    result = ::read(__fd, __buffer.data(), wanted);
+                } while (result < 0 && errno == EINTR);
+                filled = (result > 0) ? std::size_t(result) : 0;
+            }
+#endif
+            if (filled == 0)
+            {
+                throw SnapshotException("The snapshot is truncated");
+            }
+            __begin = 0;
+            __end = filled;
+            __remaining -= filled;
+        }
+    };
+
+    // an input iterator over the elements of a snapshot that are read through a SnapshotReader. an element is read
+    // when the iterator is dereferenced (so every position has to be dereferenced once, in order, like
+    // Tree::build_aux() does) and checked to come after the previous one, SnapshotException is thrown otherwise
+    template <typename DATA_t, typename Compare>
+    class SnapshotIterator
+    {
+    public:
+        SnapshotIterator(SnapshotReader &reader, const Compare &compare) : __reader(&reader), __compare(&compare), __read(0) {}
+
+        const DATA_t &operator*()
+        {
+            // the last two elements take turns in the two slots
+            unsigned char *slot = __slots[__read % 2];
+            __reader->read(slot, sizeof(DATA_t));
+            const DATA_t &current = *reinterpret_cast<const DATA_t *>(slot);
+            if (__read > 0 && !avl::less(*__compare, *reinterpret_cast<const DATA_t *>(__slots[(__read - 1) % 2]), current))
+            {
+                throw SnapshotException("The elements of the snapshot are out of order");
+            }
+            __read++;
+            return current;
+        }
+
+        SnapshotIterator &operator++() { return *this; }
+
+    private:
+        SnapshotReader *__reader;
+        const Compare *__compare;
+        alignas(DATA_t) unsigned char __slots[2][sizeof(DATA_t)];
+        long long __read;
+    };
+
+#ifdef AVL_HAS_MMAP
+    // a snapshot file mapped read-only into memory and used in place: its elements stay a sorted array inside the
+    // mapping (pages are only read when a lookup touches them), lookups are binary searches on it. the file has
+    // to be written with the same comparator, only its header and its length are checked.
+    // Tree::assign(const MappedSnapshot &) builds a tree out of it in O(n)
+    template <typename DATA_t, typename Compare = ThreeWayCompare<DATA_t>>
+    class MappedSnapshot : private CompareStorage<Compare>
+    {
+    public:
+        // throws SnapshotException if the file can't be mapped or isn't a snapshot of DATA_t
+        explicit MappedSnapshot(const char *path, const Compare &compare = Compare());
+        explicit MappedSnapshot(int fd, const Compare &compare = Compare());
+        MappedSnapshot(MappedSnapshot &&other);
+        ~MappedSnapshot();
+
+        MappedSnapshot(const MappedSnapshot &) = delete;
+        MappedSnapshot &operator=(const MappedSnapshot &) = delete;
+
+        using CompareStorage<Compare>::comparator;
+
+        const bool isEmpty() const { return __size == 0; }
+        const int size() const { return __size; }
+
+        bool contains(const DATA_t &data) const;
+        const DATA_t &find(const DATA_t &data) const;
+        const DATA_t &getMin() const;
+        const DATA_t &getMax() const;
+
+        // the elements in order
+        const DATA_t *begin() const { return __elements; }
+        const DATA_t *end() const { return __elements + __size; }
+        // the first element that is not less / greater than data, end() if there is none
+        const DATA_t *lower_bound(const DATA_t &data) const;
+        const DATA_t *upper_bound(const DATA_t &data) const;
+
+        // the heights of the nodes of the tree that was written, in order (nullptr if its shape wasn't kept)
+        const std::uint8_t *heights() const { return __heights; }
+
+        template <typename FunctionObject>
+        void in_order_traversal(FunctionObject do_something) const
+        {
+            for (const DATA_t *it = begin(); it != end(); ++it)
+            {
+                do_something(*it);
+            }
+        }
+
+        // error classes
+        class NoSuchElementException : public std::exception
+        {
+        public:
+            const char *what() const noexcept override { return "There is no such element"; }
+        };
+
+    private:
+        void *__mapping;
+        std::size_t __length;
+        const DATA_t *__elements;
+        const std::uint8_t *__heights;
+        int __size;
+
+        void map(int fd);
+    };
+
+    template <typename DATA_t, typename Compare>
+    MappedSnapshot<DATA_t, Compare>::MappedSnapshot(const char *path, const Compare &compare)
+        : CompareStorage<Compare>(compare), __mapping(nullptr), __length(0), __elements(nullptr), __heights(nullptr), __size(0)
+    {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+        {
+            throw SnapshotException("The snapshot file can't be opened");
+        }
+        try
+        {
+            map(fd);
+        }
+        catch (...)
+        {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd); // the mapping stays valid
+    }
+
+    template <typename DATA_t, typename Compare>
+    MappedSnapshot<DATA_t, Compare>::MappedSnapshot(int fd, const Compare &compare)
+        : CompareStorage<Compare>(compare), __mapping(nullptr), __length(0), __elements(nullptr), __heights(nullptr), __size(0)
+    {
+        map(fd);
+    }
+
+    template <typename DATA_t, typename Compare>
+    MappedSnapshot<DATA_t, Compare>::MappedSnapshot(MappedSnapshot &&other)
+        : CompareStorage<Compare>(other.comparator()), __mapping(other.__mapping), __length(other.__length),
+          __elements(other.__elements), __heights(other.__heights), __size(other.__size)
+    {
+        other.__mapping = nullptr;
+        other.__length = 0;
+        other.__elements = nullptr;
+        other.__heights = nullptr;
+        other.__size = 0;
+    }
+
+    template <typename DATA_t, typename Compare>
+    MappedSnapshot<DATA_t, Compare>::~MappedSnapshot()
+    {
+        if (__mapping != nullptr)
+        {
+            ::munmap(__mapping, __length);
+        }
+    }
+
+    template <typename DATA_t, typename Compare>
+    void MappedSnapshot<DATA_t, Compare>::map(int fd)
+    {
+        struct stat status;
+        if (::fstat(fd, &status) != 0 || std::uint64_t(status.st_size) < sizeof(SnapshotHeader))
+        {
+            throw SnapshotException("Not a snapshot");
+        }
+        __length = std::size_t(status.st_size);
+        void *mapping = ::mmap(nullptr, __length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            __length = 0;
+            throw SnapshotException("The snapshot file can't be mapped");
+        }
+        __mapping = mapping;
+        const SnapshotHeader &header = *static_cast<const SnapshotHeader *>(mapping);
+        try
+        {
+            check_snapshot_header<DATA_t>(header);
+            std::uint64_t shape_size = (header.__flags & SNAPSHOT_SHAPE) ? header.__count : 0;
+            if (__length != sizeof(SnapshotHeader) + header.__count * sizeof(DATA_t) + shape_size)
+            {
+                throw SnapshotException("The snapshot is truncated");
+            }
+        }
+        catch (...)
+        {
+            ::munmap(__mapping, __length);
+            __mapping = nullptr;
+            __length = 0;
+            throw;
+        }
+        __size = int(header.__count);
+        __elements = reinterpret_cast<const DATA_t *>(static_cast<const char *>(mapping) + sizeof(SnapshotHeader));
+        if (header.__flags & SNAPSHOT_SHAPE)
+        {
+            __heights = reinterpret_cast<const std::uint8_t *>(__elements + __size);
+        }
+    }
+
+    template <typename DATA_t, typename Compare>
+    const DATA_t *MappedSnapshot<DATA_t, Compare>::lower_bound(const DATA_t &data) const
+    {
+        return std::lower_bound(begin(), end(), data,
+                                [this](const DATA_t &a, const DATA_t &b) { return avl::less(comparator(), a, b); });
+    }
+
+    template <typename DATA_t, typename Compare>
+    const DATA_t *MappedSnapshot<DATA_t, Compare>::upper_bound(const DATA_t &data) const
+    {
+        return std::upper_bound(begin(), end(), data,
+                                [this](const DATA_t &a, const DATA_t &b) { return avl::less(comparator(), a, b); });
+    }
+
+    template <typename DATA_t, typename Compare>
+    bool MappedSnapshot<DATA_t, Compare>::contains(const DATA_t &data) const
+    {
+        const DATA_t *it = lower_bound(data);
+        return it != end() && !avl::less(comparator(), data, *it);
+    }
+
+    template <typename DATA_t, typename Compare>
+    const DATA_t &MappedSnapshot<DATA_t, Compare>::find(const DATA_t &data) const
+    {
+        const DATA_t *it = lower_bound(data);
+        if (it == end() || avl::less(comparator(), data, *it))
+        {
+            throw NoSuchElementException();
+        }
+        return *it;
+    }
+
+    template <typename DATA_t, typename Compare>
+    const DATA_t &MappedSnapshot<DATA_t, Compare>::getMin() const
+    {
+        if (__size == 0)
+        {
+            throw NoSuchElementException();
+        }
+        return __elements[0];
+    }
+
+    template <typename DATA_t, typename Compare>
+    const DATA_t &MappedSnapshot<DATA_t, Compare>::getMax() const
+    {
+        if (__size == 0)
+        {
+            throw NoSuchElementException();
+        }
+        return __elements[__size - 1];
+    }
+#endif // AVL_HAS_MMAP
+};
+
+#endif // _AVL_SNAPSHOT_H_
@@ -0,0 +1,193 @@
+#ifndef _AVL_STATS_H_
+#define _AVL_STATS_H_
+
+#include <atomic>
+#include <iostream>
+#include <type_traits>
+
+namespace avl
+{
+    /*
+    a stats policy is told about the work the tree does, through these hooks:
+
+    struct Policy
+    {
+        void comparison();                     // one call of the comparator
+        void search(int comparisons);          // one root-to-leaf descent (find, insert, remove...) and its comparisons
+        void rotation(bool double_rotation);   // one single or double rotation while balancing
+        void rebalance_path(int length);       // the number of nodes balance() walked up after an insertion or removal
+        void successor_walk(int length);       // the nodes walked down to the successor when removing a node with two children
+        void allocation();                     // one node created by the tree
+        void release(long long count);         // count nodes destroyed (or dropped at once by clear()) by the tree
+    };
+
+    the hooks are called on const trees as well (a lookup compares), the tree holds its policy as a mutable member,
+    and from several threads at once by the parallel operations (comparison() and search() only).
+    with NoStats they are all empty and inline, so they (and the counting around them) compile away
+    */
+
+    // the default policy, nothing is counted (and the tree pays neither time nor space for it)
+    struct NoStats
+    {
+        void comparison() {}
+        void search(int) {}
+        void rotation(bool) {}
+        void rebalance_path(int) {}
+        void successor_walk(int) {}
+        void allocation() {}
+        void release(long long) {}
+    };
+
+    // counts everything, the lengths go into histograms of HISTOGRAM_SIZE buckets (the last one takes everything longer).
+    // the counters are relaxed atomics that are loaded and stored rather than incremented atomically: they're as cheap
+    // as plain integers and reading them while the tree works is safe, but counts made by several threads at once
+    // (the parallel set operations, assign() sorting in parallel, concurrent lookups) may be lost
+    class TreeStats
+    {
+    public:
+        static constexpr int HISTOGRAM_SIZE = 64;
+
+        void comparison() { __comparisons.add(1); }
+        void search(int comparisons)
+        {
+            __searches.add(1);
+            __search_comparisons[bucket(comparisons)].add(1);
+        }
+        void rotation(bool double_rotation) { (double_rotation ? __double_rotations : __single_rotations).add(1); }
+        void rebalance_path(int length) { __rebalance_paths[bucket(length)].add(1); }
+        void successor_walk(int length) { __successor_walks[bucket(length)].add(1); }
+        void allocation() { __allocations.add(1); }
+        void release(long long count) { __releases.add(count); }
+
+        long long comparisons() const { return __comparisons.get(); }
+        long long searches() const { return __searches.get(); }
+        long long single_rotations() const { return __single_rotations.get(); }
+        long long double_rotations() const { return __double_rotations.get(); }
+        long long allocations() const { return __allocations.get(); }
+        long long releases() const { return __releases.get(); }
+        // the comparisons of the searches only (not those of sorting, set operations or batched lookups)
+        double comparisons_per_search() const { return average(__search_comparisons); }
+
+        // the number of searches that made `comparisons` comparisons, rebalancing walks of `length` nodes and
+        // successor walks of `length` nodes (counting the right child the walk starts from)
+        long long searches_with(int comparisons) const { return __search_comparisons[bucket(comparisons)].get(); }
+        long long rebalance_paths(int length) const { return __rebalance_paths[bucket(length)].get(); }
+        long long successor_walks(int length) const { return __successor_walks[bucket(length)].get(); }
+        double average_rebalance_path() const { return average(__rebalance_paths); }
+        double average_successor_walk() const { return average(__successor_walks); }
+
+        void reset() { *this = TreeStats(); }
+
+        // prints the counters and the non-empty buckets of the histograms
+        void report(std::ostream &out) const
+        {
+            out << "comparisons: " << comparisons() << ", searches: " << searches()
+                << " (" << comparisons_per_search() << " comparisons per search)\n"
+                << "rotations: " << single_rotations() << " single, " << double_rotations() << " double\n"
+                << "nodes: " << allocations() << " allocated, " << releases() << " released\n";
+            report_histogram(out, "comparisons per search", __search_comparisons);
+            report_histogram(out, "rebalance path lengths", __rebalance_paths);
+            report_histogram(out, "successor walk lengths", __successor_walks);
+        }
+
+    private:
+        class Counter
+        {
+        public:
+            Counter() : __value(0) {}
+            Counter(const Counter &other) : __value(other.get()) {}
+            Counter &operator=(const Counter &other)
+            {
+                __value.store(other.get(), std::memory_order_relaxed);
+                return *this;
+            }
+
+            void add(long long count) { __value.store(get() + count, std::memory_order_relaxed); }
+            long long get() const { return __value.load(std::memory_order_relaxed); }
+
+        private:
+            std::atomic<long long> __value;
+        };
+
+        Counter __comparisons;
+        Counter __searches;
+        Counter __single_rotations;
+        Counter __double_rotations;
+        Counter __allocations;
+        Counter __releases;
+        Counter __search_comparisons[HISTOGRAM_SIZE];
+        Counter __rebalance_paths[HISTOGRAM_SIZE];
+        Counter __successor_walks[HISTOGRAM_SIZE];
+
+        static int bucket(int length)
+        {
+            return (length < HISTOGRAM_SIZE - 1) ? length : HISTOGRAM_SIZE - 1;
+        }
+
+        static double average(const Counter (&histogram)[HISTOGRAM_SIZE])
+        {
+            long long count = 0, total = 0;
+            for (int i = 0; i < HISTOGRAM_SIZE; i++)
+            {
+                count += histogram[i].get();
+                total += i * histogram[i].get();
+            }
+            return (count != 0) ? double(total) / count : 0.0;
+        }
+
+        static void report_histogram(std::ostream &out, const char *name, const Counter (&histogram)[HISTOGRAM_SIZE])
+        {
+            out << name << ":";
+            for (int i = 0; i < HISTOGRAM_SIZE; i++)
+            {
+                if (histogram[i].get() != 0)
+                {
+                    out << " " << i << (i == HISTOGRAM_SIZE - 1 ? "+" : "") << ":" << histogram[i].get();
+                }
+            }
+            out << "\n";
+        }
+    };
+
+    // the shape of a tree at one point, see Tree::tree_shape_report()
+    struct TreeShapeReport
+    {
+        int size;
+        int height;           // -1 for an empty tree
+        double average_depth; // over all the nodes, the root has depth 0
+        // how many nodes have a balance factor (height of the left subtree - height of the right one) of +1, 0 and -1,
+        // and how many are out of balance (only before rebalance() in relaxed balance mode)
+        int left_heavy;
+        int balanced;
+        int right_heavy;
+        int unbalanced;
+
+        TreeShapeReport() : size(0), height(-1), average_depth(0.0), left_heavy(0), balanced(0), right_heavy(0), unbalanced(0) {}
+
+        void report(std::ostream &out) const
+        {
+            out << "size: " << size << ", height: " << height << ", average depth: " << average_depth << "\n"
+                << "balance factors: " << left_heavy << " x +1, " << balanced << " x 0, " << right_heavy << " x -1, " << unbalanced << " out of balance\n";
+        }
+    };
+
+    // the base of the tree that holds its stats policy, it is empty (and adds nothing to the tree) for an empty policy
+    template <typename Stats, bool = std::is_empty<Stats>::value>
+    class StatsStorage
+    {
+    public:
+        Stats &stats_policy() const { return __stats; }
+
+    private:
+        mutable Stats __stats;
+    };
+
+    template <typename Stats>
+    class StatsStorage<Stats, true> : private Stats
+    {
+    public:
+        Stats &stats_policy() const { return const_cast<StatsStorage &>(*this); }
+    };
+};
+
+#endif // _AVL_STATS_H_
@@ -3,30 +3,191 @@
 
 #include <iostream> // for the errors and to display the tree
 #include <cassert>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "Stack.h"
+#include "AVLAllocator.h"
+#include "AVLAggregate.h"
+#include "AVLParallel.h"
+#include "AVLFrozenTree.h"
+#include "AVLMultiset.h"
+#include "AVLSnapshot.h"
+#include "AVLStats.h"
 #include "AVLUtility.h"
 
 namespace avl
 {
-    template <typename DATA_t, Comparison (*ComparisonFunc)(const DATA_t &, const DATA_t &) = AVLTree_CompareUsingOperators<DATA_t>>
-    class Tree
+    // Compare is the comparator type, three-way or less-than (see AVLUtility.h)
+    // Allocator is the policy used to create and destroy the nodes of the tree (see AVLAllocator.h)
+    // Aggregate is the monoid every node caches for its subtree, used by aggregate() (see AVLAggregate.h)
+    // Stats is told about the comparisons, rotations and allocations of the tree, read with stats() (see AVLStats.h)
+    // Duplicates decides whether equal elements are rejected, counted or chained (see AVLMultiset.h)
+    template <typename DATA_t,
+              typename Compare = ThreeWayCompare<DATA_t>,
+              template <typename> class Allocator = SlabAllocator,
+              typename Aggregate = NoAggregate,
+              typename Stats = NoStats,
+              typename Duplicates = UniqueKeys>
+    class Tree : private CompareStorage<Compare>, private StatsStorage<Stats>
     {
     public:
         Tree();
+        explicit Tree(const Compare &compare);
+        // builds the tree out of the elements in [first, last), see assign()
+        template <typename Iterator>
+        Tree(Iterator first, Iterator last, const Compare &compare = Compare());
         ~Tree();
 
+        // returns the comparator of the tree
+        using CompareStorage<Compare>::comparator;
+
+        // a copy would share the nodes of this tree, see PersistentTree for cheap copies
+        Tree(const Tree &) = delete;
+        Tree &operator=(const Tree &) = delete;
+        // moving takes over the nodes (and their allocator) in O(1), other is left empty
+        Tree(Tree &&other);
+        Tree &operator=(Tree &&other);
+        // exchanges the contents, allocators and comparators of the two trees in O(1)
+        void swap(Tree &other);
+
+        // replaces the content of the tree with the elements in [first, last), in O(n) if the range is sorted
+        // (strictly increasing), otherwise the elements are sorted in parallel and duplicates are dropped
+        template <typename Iterator>
+        void assign(Iterator first, Iterator last);
+
         void insert(const DATA_t &data);
+        void insert(DATA_t &&data);
+        // constructs the element in its node from args and inserts it, throws ElementAlreadyExistsException
+        // (and destroys the element) if an equal one is already in the tree and it isn't a multiset
+        template <typename... Args>
+        void emplace(Args &&...args);
         void remove(const DATA_t &data);
+        // removes the element equal to a key of another type, when Compare is transparent
+        template <typename Key, typename C = Compare, typename = typename C::is_transparent>
+        void remove(const Key &key) { remove_element(key); }
+
+        // the same without exceptions, for when misses are common: they return whether the element was
+        // inserted (it wasn't in the tree) or erased (it was in the tree)
+        bool try_insert(const DATA_t &data);
+        bool try_insert(DATA_t &&data);
+        bool try_erase(const DATA_t &data) { return erase_element(data); }
+        template <typename Key, typename C = Compare, typename = typename C::is_transparent>
+        bool try_erase(const Key &key) { return erase_element(key); }
+
+        // multisets (see AVLMultiset.h), with a multiset policy insert() and try_insert() always insert and remove()
+        // and try_erase() remove one occurrence. they work for unique keys too, without exceptions
+        // returns the number of elements equal to data. Time Complexity: O(log n)
+        int count(const DATA_t &data) const;
+        // removes one element equal to data (the oldest with ChainedKeys), returns whether there was one. O(log n)
+        bool erase_one(const DATA_t &data) { return erase_element(data); }
+        // removes every element equal to data, returns how many there were. Time Complexity: O(log n), plus O(k) to
+        // destroy the k nodes with ChainedKeys (which are cut out of the tree at once)
+        int erase_all(const DATA_t &data);
 
         void clear();
+
+        // relaxed balance mode, for bursts of writes: insertions and removals only mark the nodes above the change as
+        // unsettled and rebalance() restores the AVL shape of the marked part later, in one pass. lookups, iterators
+        // and traversals stay correct in between, the tree is rebalanced at once if a node gets deeper than
+        // 4 + 2 log2(size()), and the join-based operations rebalance first. the order statistics and aggregates
+        // stay correct too, they recount the sizes and aggregates of the marked nodes they pass (O(k) more for k
+        // marked nodes), and snapshots only keep the shape of a rebalanced tree
+        void relax_balance(bool relaxed = true);
+        bool balance_relaxed() const { return __relaxed; }
+        // settles the nodes marked by relaxed balance mode: every marked node is joined with its two subtrees
+        // bottom-up. Time Complexity: O(k + the height differences) for k marked nodes, O(1) for a balanced tree
+        void rebalance();
+
+        // join-based operations, the trees involved share their node allocator afterwards (see AVLAllocator.h)
+        // moves every element greater than key into greater (which is cleared first) and keeps the smaller ones,
+        // key itself is removed, returns whether it was in the tree. Time Complexity: O(log n)
+        bool split(const DATA_t &key, Tree &greater);
+        // replaces the content of this tree with left, key and right, every element of left must be smaller
+        // than key and every element of right greater than it. left and right are emptied (either may be this tree).
+        // Time Complexity: O(|height(left) - height(right)| + 1)
+        void join(Tree &left, const DATA_t &key, Tree &right);
+        // removes every element x with low <= x <= high and returns how many there were. the range is cut out with
+        // two splits and the rest joined back, then its nodes are destroyed in one pass without any rebalancing
+        // (released at once if that was the whole tree). Time Complexity: O(log n), plus O(k) to destroy k nodes
+        int erase_range(const DATA_t &low, const DATA_t &high);
+        // the same, but the elements go into the returned tree with their nodes. the two trees share their node
+        // pool from then on (see SlabAllocator), so neither may be used on another thread while the other one
+        // is in use. Time Complexity: O(log n)
+        Tree extract_range(const DATA_t &low, const DATA_t &high);
+        // set operations in place, other is emptied. they recurse on both halves in parallel on up to `threads`
+        // threads. Time Complexity: O(m log(n / m + 1)) work for sizes m <= n, O(log^2 n) span
+        void set_union(Tree &other, int threads = hardware_threads());
+        void set_intersection(Tree &other, int threads = hardware_threads());
+        void set_difference(Tree &other, int threads = hardware_threads());
+
         const bool isEmpty() const;
         const int size() const;
 
         const DATA_t &find(const DATA_t &data) const;
+        // looks up a key of another type without building a DATA_t out of it, when Compare is transparent
+        template <typename Key, typename C = Compare, typename = typename C::is_transparent>
+        const DATA_t &find(const Key &key) const { return find_aux(key); }
+        // lookups that don't throw: whether the element is in the tree, and a pointer to it (nullptr if it isn't)
+        bool contains(const DATA_t &data) const { return find_node(data) != nullptr; }
+        const DATA_t *try_find(const DATA_t &data) const { return data_of(find_node(data)); }
+        template <typename Key, typename C = Compare, typename = typename C::is_transparent>
+        bool contains(const Key &key) const { return find_node(key) != nullptr; }
+        template <typename Key, typename C = Compare, typename = typename C::is_transparent>
+        const DATA_t *try_find(const Key &key) const { return data_of(find_node(key)); }
+
+        // batched operations
+        // looks up count keys at once, out[i] points to the element equal to keys[i] or is nullptr if there's none.
+        // the searches of BATCH_LANES keys advance together one level at a time and prefetch the nodes they go to
+        // next, so the cache misses of different keys overlap
+        void find_batch(const DATA_t *keys, int count, const DATA_t **out) const;
+        void find_batch(const std::vector<DATA_t> &keys, std::vector<const DATA_t *> &out) const;
+        // inserts the elements in [first, last) that aren't in the tree yet and returns how many were inserted.
+        // the batch is sorted into a tree of its own (see assign()) which is merged in with set_union(),
+        // in O(m log(n / m + 1)) for a batch of size m instead of m separate insertions. much smaller batches are
+        // sorted in a vector and inserted one by one in order instead
+        template <typename Iterator>
+        int insert_batch(Iterator first, Iterator last);
+        int insert_batch(const std::vector<DATA_t> &keys) { return insert_batch(keys.begin(), keys.end()); }
         const DATA_t &getMin() const;
         const DATA_t &getMax() const;
 
+        // order statistics, all in O(log n) (plus the nodes marked in relaxed balance mode, see relax_balance())
+        // returns the k-th smallest element (k starts at 0)
+        const DATA_t &select(int k) const;
+        // returns the position of the element in the sorted order (the smallest has rank 0), of the first of the
+        // equal elements in a multiset
+        int rank(const DATA_t &data) const;
+        // returns the number of elements that are smaller than data (data doesn't have to be in the tree)
+        int count_less(const DATA_t &data) const;
+        // returns the number of elements x with low <= x <= high
+        int count_in_range(const DATA_t &low, const DATA_t &high) const;
+        // returns the lower median, select((size() - 1) / 2)
+        const DATA_t &median() const;
+
+        // returns the combination of all the elements in the tree, in O(1) (O(k) for k nodes marked in relaxed
+        // balance mode)
+        typename Aggregate::value_type aggregate() const;
+        // returns the combination of the elements x with low <= x <= high (in order), in O(log n)
+        typename Aggregate::value_type aggregate(const DATA_t &low, const DATA_t &high) const;
+        // calls do_something in order on every element x <= high whose own aggregate passes keep, and skips every
+        // subtree whose aggregate fails it, so keep may fail for a subtree only if it fails for all of its elements
+        // (a maximum that has to reach a bound, for instance). the scan stops early once do_something returns false.
+        // Time Complexity: O(log n) plus O(log n) for every element visited, less when they are close together
+        // (see AVLIntervalTree.h)
+        template <typename Predicate, typename FunctionObject>
+        void pruned_traversal(const DATA_t &high, Predicate keep, FunctionObject do_something) const
+        {
+            pruned_traversal([this, &high](const DATA_t &data) { return is_less(high, data); }, keep, do_something);
+        }
+        // the same, but the scan ends at the first element past(x) holds for, for an end that no element marks.
+        // past must hold for every element after that one too
+        template <typename Past, typename Predicate, typename FunctionObject,
+                  typename = decltype(std::declval<Past &>()(std::declval<const DATA_t &>()))>
+        void pruned_traversal(Past past, Predicate keep, FunctionObject do_something) const;
+
         template <typename FunctionObject>
         void in_order_traversal(FunctionObject do_something)
         {
@@ -39,6 +200,50 @@ namespace avl
             reverse_in_order_traversal_aux_recursive(__root, do_something);
         }
 
+        // parallel traversals: the tree is cut into tasks of whole subtrees of at most PARALLEL_CUTOFF elements
+        // (each with at most one of the nodes above them) that up to `threads` threads take from each other,
+        // see parallel_for_index() in AVLParallel.h. smaller trees are traversed on the calling thread
+        // calls do_something on every element, in no particular order and possibly from several threads at once
+        template <typename FunctionObject>
+        void parallel_for_each(FunctionObject do_something, int threads = hardware_threads()) const;
+        // returns combine(...combine(combine(identity, map(x1)), map(x2))..., map(xn)) over the elements in order,
+        // combine has to be associative (not necessarily commutative) and identity its neutral element
+        template <typename T, typename MapFunction, typename CombineFunction>
+        T parallel_reduce(T identity, MapFunction map, CombineFunction combine, int threads = hardware_threads()) const;
+        // calls map on the elements in parallel and deliver with the results on the calling thread in key order,
+        // at most about 2 * 4 * threads tasks worth of results are held at once
+        template <typename MapFunction, typename DeliverFunction>
+        void parallel_for_each_ordered(MapFunction map, DeliverFunction deliver, int threads = hardware_threads()) const;
+
+        // returns an immutable copy of the tree laid out for fast lookups, see AVLFrozenTree.h. Time Complexity: O(n)
+        FrozenTree<DATA_t, Compare> freeze() const
+        {
+            return FrozenTree<DATA_t, Compare>(begin(), end(), comparator());
+        }
+
+        // binary snapshots (see AVLSnapshot.h), only for trivially copyable DATA_t. a snapshot holds the elements in
+        // order and, with keep_shape, the heights of the nodes so the tree can be rebuilt exactly as it is. the writers
+        // and readers go through a buffer of SNAPSHOT_BUFFER_SIZE bytes whatever the size of the tree, errors throw
+        // SnapshotException. Time Complexity: O(n)
+        void write_snapshot(std::ostream &out, bool keep_shape = false) const;
+        // replaces the content of the tree with the snapshot, read element by element into a perfectly balanced tree
+        // (the shape isn't kept). throws SnapshotException if the elements aren't sorted by the comparator of the tree
+        void read_snapshot(std::istream &in);
+#ifdef AVL_HAS_MMAP
+        void write_snapshot(int fd, bool keep_shape = false) const;
+        void read_snapshot(int fd);
+        // replaces the content of the tree with the mapped snapshot: the elements are copied straight into the nodes
+        // and linked into the shape of the tree that was written if it was kept, into a perfectly balanced tree
+        // otherwise (or if the snapshot isn't sorted by the comparator of the tree, then it's sorted first like assign())
+        void assign(const MappedSnapshot<DATA_t, Compare> &snapshot);
+#endif
+
+        // the counters of the stats policy, they aren't moved or swapped with the nodes
+        const Stats &stats() const { return this->stats_policy(); }
+        Stats &stats() { return this->stats_policy(); }
+        // walks the whole tree for its height, average depth and balance factors. Time Complexity: O(n)
+        TreeShapeReport tree_shape_report() const;
+
         void display();
 
         // error classes
@@ -53,23 +258,61 @@ namespace avl
             const char *what() const noexcept override { return "Element already exists"; }
         };
 
-        struct Node
+        // the links come before the data, so a search reads them and the start of the data (the key of
+        // a Map entry) from the same cache line however large the rest of the data is
+        struct Node : public AggregateStorage<Aggregate>, public OccurrenceStorage<Duplicates>
         {
-            DATA_t __data;
             Node *__left, *__right;
-            int __height;
+            Node *__parent; // kept up to date by updateValues() of the parent, used by the iterators
+            int __height;       // UNSETTLED while the node waits for rebalance() in relaxed balance mode
+            int __subtree_size; // number of elements (nodes, or occurrences with CountedKeys) in the subtree rooted at this node
+            DATA_t __data;
 
-            Node(const DATA_t &data) : __data(data),
-                                       __left(nullptr),
-                                       __right(nullptr),
-                                       __height(0)
+            // the data is constructed in place from args
+            template <typename... Args>
+            explicit Node(Args &&...args) : __left(nullptr),
+                                            __right(nullptr),
+                                            __parent(nullptr),
+                                            __height(0),
+                                            __subtree_size(1),
+                                            __data(std::forward<Args>(args)...)
             {
+                this->updateAggregate(__data, nullptr, nullptr);
             }
 
+            // the height of a node whose subtree changed in relaxed balance mode, its height, size and aggregate are
+            // stale until rebalance(). every node above an unsettled node is unsettled too
+            static constexpr int UNSETTLED = -2;
+
             void updateValues()
             {
                 __height = 1 + max(__left != nullptr ? __left->__height : -1,
                                    __right != nullptr ? __right->__height : -1);
+                __subtree_size = this->occurrences() + (__left != nullptr ? __left->__subtree_size : 0) +
+                                 (__right != nullptr ? __right->__subtree_size : 0);
+                this->updateAggregate(__data, __left, __right, this->occurrences());
+                if (__left != nullptr)
+                {
+                    __left->__parent = this;
+                }
+                if (__right != nullptr)
+                {
+                    __right->__parent = this;
+                }
+            }
+
+            // updateValues() but the height, for the nodes above a change that left the heights as they were
+            void updateCounts()
+            {
+                __subtree_size = this->occurrences() + (__left != nullptr ? __left->__subtree_size : 0) +
+                                 (__right != nullptr ? __right->__subtree_size : 0);
+                this->updateAggregate(__data, __left, __right, this->occurrences());
+            }
+
+            // the aggregate of the element alone (of all its occurrences)
+            typename Aggregate::value_type lifted() const
+            {
+                return lift_repeated<Aggregate>(__data, this->occurrences());
             }
 
             int balanceFactor()
@@ -92,12 +335,18 @@ namespace avl
                 return __right != nullptr;
             }
 
+            static int height(const Node *node)
+            {
+                return node != nullptr ? node->__height : -1;
+            }
+
             // returns a pointer to the node that "replaced" the previous after rotation
             Node *left_rotate()
             {
                 Node *R = __right;
                 __right = __right->__left;
                 R->__left = this;
+                R->__parent = __parent;
 
                 this->updateValues(); // the order is important
                 R->updateValues();
@@ -111,6 +360,7 @@ namespace avl
                 Node *L = __left;
                 __left = __left->__right;
                 L->__right = this;
+                L->__parent = __parent;
 
                 this->updateValues(); // the order is important
                 L->updateValues();
@@ -118,24 +368,225 @@ namespace avl
                 return L;
             }
 
-            /*friend*/ void swapNodes(Node *&first, Node *&second)
+            Node *next() { return const_cast<Node *>(static_cast<const Node *>(this)->next()); }
+            Node *previous() { return const_cast<Node *>(static_cast<const Node *>(this)->previous()); }
+
+            // returns the node that comes after this one in-order, or nullptr if this is the last one
+            const Node *next() const
             {
-                if ((first == nullptr) || (second == nullptr) || (/*self swap bug*/ first == second))
+                const Node *temp = this;
+                if (temp->__right != nullptr)
                 {
-                    return;
+                    temp = temp->__right;
+                    while (temp->__left != nullptr)
+                    {
+                        temp = temp->__left;
+                    }
+                    return temp;
+                }
+                while (temp->__parent != nullptr && temp->__parent->__right == temp)
+                {
+                    temp = temp->__parent;
+                }
+                return temp->__parent;
+            }
+
+            // returns the node that comes before this one in-order, or nullptr if this is the first one
+            const Node *previous() const
+            {
+                const Node *temp = this;
+                if (temp->__left != nullptr)
+                {
+                    temp = temp->__left;
+                    while (temp->__right != nullptr)
+                    {
+                        temp = temp->__right;
+                    }
+                    return temp;
+                }
+                while (temp->__parent != nullptr && temp->__parent->__left == temp)
+                {
+                    temp = temp->__parent;
+                }
+                return temp->__parent;
+            }
+        };
+
+        // a bidirectional iterator over the elements in order, the elements can't be changed through it
+        // since that could break the order of the tree. only iterators to removed elements are invalidated
+        class const_iterator
+        {
+        public:
+            typedef std::bidirectional_iterator_tag iterator_category;
+            typedef DATA_t value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef const DATA_t *pointer;
+            typedef const DATA_t &reference;
+
+            const_iterator() : __node(nullptr), __tree(nullptr) {}
+
+            reference operator*() const { return __node->__data; }
+            pointer operator->() const { return &(__node->__data); }
+
+            const_iterator &operator++()
+            {
+                __node = __node->next();
+                return *this;
+            }
+
+            const_iterator operator++(int)
+            {
+                const_iterator old = *this;
+                ++(*this);
+                return old;
+            }
+
+            // decrementing end() gives the maximum
+            const_iterator &operator--()
+            {
+                __node = (__node == nullptr) ? __tree->__max_element : __node->previous();
+                return *this;
+            }
+
+            const_iterator operator--(int)
+            {
+                const_iterator old = *this;
+                --(*this);
+                return old;
+            }
+
+            bool operator==(const const_iterator &other) const { return __node == other.__node; }
+            bool operator!=(const const_iterator &other) const { return __node != other.__node; }
+
+        private:
+            friend class Tree;
+            const_iterator(const Node *node, const Tree *tree) : __node(node), __tree(tree) {}
+
+            const Node *__node; // nullptr is end()
+            const Tree *__tree;
+        };
+        typedef const_iterator iterator;
+        typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+        typedef const_reverse_iterator reverse_iterator;
+
+        const_iterator begin() const { return const_iterator(__min_element, this); }
+        const_iterator end() const { return const_iterator(nullptr, this); }
+        const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+        const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+        // returns an iterator to the first element that is not smaller than data (end() if there's none), in O(log n)
+        const_iterator lower_bound(const DATA_t &data) const;
+        // returns an iterator to the first element that is greater than data (end() if there's none), in O(log n)
+        const_iterator upper_bound(const DATA_t &data) const;
+        // returns [lower_bound(data), upper_bound(data))
+        std::pair<const_iterator, const_iterator> equal_range(const DATA_t &data) const;
+        // the same for a key of another type, when Compare is transparent
+        template <typename Key, typename C = Compare, typename = typename C::is_transparent>
+        const_iterator lower_bound(const Key &key) const { return const_iterator(lower_bound_aux(key), this); }
+        template <typename Key, typename C = Compare, typename = typename C::is_transparent>
+        const_iterator upper_bound(const Key &key) const { return const_iterator(upper_bound_aux(key), this); }
+        template <typename Key, typename C = Compare, typename = typename C::is_transparent>
+        std::pair<const_iterator, const_iterator> equal_range(const Key &key) const
+        {
+            return std::make_pair(lower_bound(key), upper_bound(key));
+        }
+
+        // looks up key (a DATA_t, or any type when Compare is transparent) and only if there's no element equal
+        // to it inserts the element constructed in place from args, which must be equal to key. it takes a single
+        // descent either way and nothing is constructed for a key that is found.
+        // returns an iterator to the element equal to key and whether it was inserted. Time Complexity: O(log n)
+        template <typename Key, typename... Args>
+        std::pair<const_iterator, bool> find_or_emplace(const Key &key, Args &&...args);
+
+        // owns an element taken out of a tree by extract() together with its node. the element can be changed
+        // through value() (rekeyed) and inserted into this or any other tree of the same type without allocating.
+        // the handle shares the allocator of the tree the node came from, so it stays valid after that tree is
+        // gone, and an element that is never inserted again is destroyed with the handle
+        class NodeHandle
+        {
+        public:
+            NodeHandle() : __node(nullptr) {}
+            NodeHandle(NodeHandle &&other) : __node(other.__node)
+            {
+                other.__node = nullptr;
+                __allocator.swap(other.__allocator);
+            }
+            NodeHandle &operator=(NodeHandle &&other)
+            {
+                if (this != &other)
+                {
+                    reset();
+                    __node = other.__node;
+                    other.__node = nullptr;
+                    __allocator.swap(other.__allocator);
+                }
+                return *this;
+            }
+            ~NodeHandle()
+            {
+                reset();
+            }
+
+            bool isEmpty() const { return __node == nullptr; }
+            DATA_t &value() const
+            {
+                assert(__node != nullptr);
+                return __node->__data;
+            }
+
+        private:
+            Node *__node;
+            Allocator<Node> __allocator;
+
+            void reset()
+            {
+                if (__node != nullptr)
+                {
+                    __allocator.destroy(__node);
+                    __node = nullptr;
                 }
-                swap(first->__left, second->__left);     // switch lefts
-                swap(first->__right, second->__right);   // switch rights
-                swap(first->__height, second->__height); // switch heights
-                swap(first, second);                     // switch places (parents in tree)
             }
+
+            friend class Tree;
         };
 
+        // takes the element equal to key out of the tree without destroying it, throws NoSuchElementException
+        // if there's none. Time Complexity: O(log n)
+        NodeHandle extract(const DATA_t &key);
+        template <typename Key, typename C = Compare, typename = typename C::is_transparent>
+        NodeHandle extract(const Key &key) { return extract_element(key); }
+        // inserts the element of the handle (if any) with its node, throws ElementAlreadyExistsException if an
+        // equal element is already in the tree and then leaves the handle untouched. Time Complexity: O(log n)
+        void insert(NodeHandle &&handle);
+
+        // calls do_something on every element x with low <= x <= high in order, subtrees outside of the range
+        // are never visited and the scan stops early once do_something returns false. Time Complexity: O(log n + k)
+        template <typename FunctionObject>
+        void range_traversal(const DATA_t &low, const DATA_t &high, FunctionObject do_something) const
+        {
+            for (const Node *temp = lower_bound(low).__node;
+                 temp != nullptr && !is_less(high, temp->__data);
+                 temp = temp->next())
+            {
+                if (!do_something(temp->__data))
+                {
+                    return;
+                }
+            }
+        }
+
     private:
+        // an AVL tree with n nodes has a height of at most 1.4405 * log2(n + 2) - 0.3277, so even for 2^64 nodes
+        // a root-to-leaf path (plus the empty slot under the leaf) fits in this many slots
+        static constexpr int MAX_PATH_LENGTH = 96;
+        typedef FixedStack<Node **, MAX_PATH_LENGTH> Path;
+
         Node *__root;
         Node *__min_element;
         Node *__max_element;
         int __size;
+        bool __relaxed; // relaxed balance mode, see relax_balance()
+        Allocator<Node> __allocator;
 
         /*>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
         <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -151,416 +602,2270 @@ namespace avl
         <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
         >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>*/
 
-        // deletes the tree with a pointer to the root, return teh size of tree it deleted
-        int clear_aux(Node *root)
+        // subtrees that were dropped by the set operations, chained through the parent pointers of their roots.
+        // the nodes are destroyed only after the (parallel) operation since the allocator is not thread safe
+        struct Garbage
         {
-            if (root == nullptr)
-            {
-                return 0;
-            }
-            int size = 1 + clear_aux(root->__left) + clear_aux(root->__right);
-            delete root;
-            return size;
-        }
+            Node *__head;
+            Node *__tail;
 
-        // return ????????
-        Node **find_node(const DATA_t &data)
-        {
-            Node **temp = &__root;
-            while (*temp != nullptr)
+            Garbage() : __head(nullptr), __tail(nullptr) {}
+
+            void add(Node *root)
             {
-                Comparison result = ComparisonFunc(data, (*temp)->__data);
-                if (result == Comparison::less)
+                if (root == nullptr)
                 {
-                    temp = &((*temp)->__left);
+                    return;
                 }
-                else if (result == Comparison::greater)
+                root->__parent = __head;
+                __head = root;
+                if (__tail == nullptr)
                 {
-                    temp = &((*temp)->__right);
+                    __tail = root;
                 }
-                else
+            }
+
+            void append(Garbage &other)
+            {
+                if (other.__head == nullptr)
                 {
-                    return temp;
+                    return;
+                }
+                other.__tail->__parent = __head;
+                if (__tail == nullptr)
+                {
+                    __tail = other.__tail;
                 }
+                __head = other.__head;
+                other.__head = other.__tail = nullptr;
             }
-            throw NoSuchElementException();
-        }
+        };
+
+        // the number of searches find_batch() interleaves
+        static constexpr int BATCH_LANES = 16;
+        // insert_batch() only merges batches at least 1 / BATCH_UNION_RATIO the size of the tree, smaller ones
+        // don't make up for the cost of splitting the tree along every key
+        static constexpr int BATCH_UNION_RATIO = 64;
+
+        // subtrees smaller than this are never split between threads
+        static constexpr int PARALLEL_CUTOFF = 1 << 13;
 
-        DATA_t &find_aux(const DATA_t &data)
+        // a piece of work of the parallel traversals, in order: the single node (if any), then the whole subtree
+        struct TraversalTask
         {
-            Node *temp = *find_node(data);
-            if (temp == nullptr)
+            const Node *__single;
+            const Node *__subtree;
+        };
+
+        // cuts the subtree into maximal subtrees of at most PARALLEL_CUTOFF nodes, every node above them goes
+        // into the task that follows it in order (pending holds it until then)
+        static void collect_tasks(const Node *root, const Node *&pending, std::vector<TraversalTask> &tasks)
+        {
+            if (root == nullptr)
             {
-                throw NoSuchElementException();
+                return;
             }
-            return temp->__data;
+            if (root->__subtree_size <= PARALLEL_CUTOFF)
+            {
+                tasks.push_back(TraversalTask{pending, root});
+                pending = nullptr;
+                return;
+            }
+            collect_tasks(root->__left, pending, tasks);
+            pending = root;
+            collect_tasks(root->__right, pending, tasks);
         }
 
-        Stack<Node *&> &find_path(const DATA_t &data, Stack<Node *&> &empty_path)
+        std::vector<TraversalTask> traversal_tasks() const
         {
-            Node **temp = &__root;
-            while ((*temp) != nullptr)
+            std::vector<TraversalTask> tasks;
+            const Node *pending = nullptr;
+            collect_tasks(__root, pending, tasks);
+            if (pending != nullptr)
             {
-                empty_path.push_back(*temp);
-                Comparison result = ComparisonFunc(data, (*temp)->__data);
-                if (result == Comparison::less)
-                {
-                    temp = &((*temp)->__left);
-                }
-                else if (result == Comparison::greater)
-                {
-                    temp = &((*temp)->__right);
-                }
-                else
-                {
-                    break;
-                }
+                tasks.push_back(TraversalTask{pending, nullptr});
             }
-            if ((*temp) == nullptr)
+            return tasks;
+        }
+
+        template <typename FunctionObject>
+        static void run_task(const TraversalTask &task, FunctionObject &do_something)
+        {
+            if (task.__single != nullptr)
             {
-                empty_path.push_back(*temp);
+                do_something(task.__single->__data);
             }
-
-            return empty_path;
+            const_traversal_aux_recursive(task.__subtree, do_something);
         }
 
-        // return a pointer the node holding the min data
-        Node *findMin() const
+        template <typename FunctionObject>
+        static void const_traversal_aux_recursive(const Node *root, FunctionObject &do_something)
         {
-            Node *temp = __root;
-            if (temp == nullptr)
-                throw NoSuchElementException();
-            while (temp->__left != nullptr)
+            if (root == nullptr)
             {
-                temp = temp->__left;
+                return;
             }
-            return temp;
+            const_traversal_aux_recursive(root->__left, do_something);
+            do_something(root->__data);
+            const_traversal_aux_recursive(root->__right, do_something);
         }
 
-        // return a pointer the node holding the max data
-        Node *findMax() const
+        // adds the nodes of the subtree to the counts of the report, depth is the depth of root. returns the height
+        // of the subtree, which is computed rather than read since it's stale in relaxed balance mode
+        static int shape_aux(const Node *root, int depth, TreeShapeReport &report, long long &depth_sum)
         {
-            Node *temp = __root;
-            if (temp == nullptr)
-                throw NoSuchElementException();
-            while (temp->__right != nullptr)
+            if (root == nullptr)
             {
-                temp = temp->__right;
+                return -1;
             }
-            return temp;
+            depth_sum += depth;
+            int left = shape_aux(root->__left, depth + 1, report, depth_sum);
+            int right = shape_aux(root->__right, depth + 1, report, depth_sum);
+            int factor = left - right;
+            if (factor > 1 || factor < -1)
+            {
+                report.unbalanced++;
+            }
+            else
+            {
+                (factor > 0 ? report.left_heavy : (factor < 0 ? report.right_heavy : report.balanced))++;
+            }
+            return 1 + max(left, right);
         }
 
-        void balance(Stack<Node *&> &path)
+        // the root changed by a join-based operation, refresh everything the tree caches about it. the size is
+        // read off the root, which is stale on an unsettled root (the join-based operations start with take_root())
+        void refresh_root()
         {
-            // std::cout << "before balancing\n";
-            // display();
-            Node *curr = nullptr;
-            while (!path.isEmpty())
+            assert(is_settled());
+            if (__root == nullptr)
             {
-                // display();
-                curr = path.back();
-                // assert(curr != nullptr);
-                // if (curr == nullptr)
-                //{
-                //    path.pop_back();
-                //    continue;
-                //}
-                if (curr == nullptr)
-                {
-
-                    path.pop_back();
-                    continue;
-                }
-
-                Node *&curr_reference = path.back();
-                path.pop_back();
-                // update height
-                curr->updateValues();
-
-                if (curr->balanceFactor() >= 2 && curr->__left->balanceFactor() >= 0)
-                { // left - left
-                    curr_reference = curr->right_rotate();
-                }
-                else if (curr->balanceFactor() >= 2)
-                { // left - right
-                    curr_reference->__left = curr->__left->left_rotate();
-                    curr_reference = curr->right_rotate();
-                }
-
-                else if (curr->balanceFactor() <= -2 and curr->__right->balanceFactor() <= 0)
-                { // right - right
-                    curr_reference = curr->left_rotate();
-                }
-                else if (curr->balanceFactor() <= -2)
-                { // right - left
-                    curr_reference->__right = curr->__right->right_rotate();
-                    curr_reference = curr->left_rotate();
-                }
+                __size = 0;
+                __min_element = nullptr;
+                __max_element = nullptr;
+                return;
             }
-            // std::cout << "after balancing\n";
-            // display();
+            __root->__parent = nullptr;
+            __size = __root->__subtree_size;
+            __min_element = findMin();
+            __max_element = findMax();
         }
-        bool insert_aux(const DATA_t &data)
+
+        // detaches all the nodes from the tree (without destroying them) and returns their root
+        Node *take_root()
         {
-            Stack<Node *&> path;
-            find_path(data, path);
-            if (path.back() != nullptr)
-            { // duplicate
-                return false;
+            rebalance();
+            Node *root = __root;
+            __root = nullptr;
+            refresh_root();
+            return root;
+        }
+
+        void destroy_garbage(Garbage &garbage)
+        {
+            while (garbage.__head != nullptr)
+            {
+                Node *next = garbage.__head->__parent;
+                clear_aux(garbage.__head);
+                garbage.__head = next;
             }
-            path.back() = new Node(data); // beware of bad_alloc
-            path.pop_back();              // new inserted node dont need balancing
-            // balance path
-            balance(path /*, true*/);
-            return true;
+            garbage.__tail = nullptr;
         }
 
-        bool remove_aux(const DATA_t &data)
+        // joins the subtrees left and right with the node middle between them (every element of left is smaller
+        // than middle, every element of right greater), returns the root of the result
+        static Node *join_aux(Node *left, Node *middle, Node *right)
         {
-            Stack<Node *&> path;
-            find_path(data, path);
-            if (path.isEmpty() || path.back() == nullptr)
+            if (Node::height(left) > Node::height(right) + 1)
             {
-                return false;
+                return join_right(left, middle, right);
             }
-            // path NOT empty and back is VALID
-            Node *curr = path.back();
-            assert(curr != nullptr);
-            if (curr->isLeaf())
+            if (Node::height(right) > Node::height(left) + 1)
             {
-                delete curr;
-                path.back() = nullptr;
-                path.pop_back();
+                return join_left(left, middle, right);
             }
-            else if (curr->hasLeft() && !curr->hasRight())
+            middle->__left = left;
+            middle->__right = right;
+            middle->updateValues();
+            return middle;
+        }
+
+        // left is the taller one, walk down its right spine to a subtree as high as right and join there
+        static Node *join_right(Node *left, Node *middle, Node *right)
+        {
+            Node *spine = left->__right;
+            if (Node::height(spine) <= Node::height(right) + 1)
             {
-                path.back() = curr->__left;
-                delete curr;
-                path.pop_back();
+                middle->__left = spine;
+                middle->__right = right;
+                middle->updateValues();
+                left->__right = middle;
+                if (middle->__height <= Node::height(left->__left) + 1)
+                {
+                    left->updateValues();
+                    return left;
+                }
+                // right - left
+                left->__right = middle->right_rotate();
+                left->updateValues();
+                return left->left_rotate();
             }
-            else if (!curr->hasLeft() && curr->hasRight())
+            Node *joined = join_right(spine, middle, right);
+            left->__right = joined;
+            left->updateValues();
+            if (joined->__height <= Node::height(left->__left) + 1)
             {
-                path.back() = curr->__right;
-                delete curr;
-                path.pop_back();
+                return left;
             }
-            else
-            { // (curr->hasLeft() && curr->hasRight())
+            // right - right
+            return left->left_rotate();
+        }
 
-                Stack<Node *&> path_to_successor;
-                // find successor
-                Node **successor = &curr->__right; // go right once
-                while ((*successor) != nullptr)    // go all the way to the left
+        // right is the taller one, the mirror image of join_right
+        static Node *join_left(Node *left, Node *middle, Node *right)
+        {
+            Node *spine = right->__left;
+            if (Node::height(spine) <= Node::height(left) + 1)
+            {
+                middle->__left = left;
+                middle->__right = spine;
+                middle->updateValues();
+                right->__left = middle;
+                if (middle->__height <= Node::height(right->__right) + 1)
                 {
-                    path_to_successor.push_back(*successor);
-                    successor = &((*successor)->__left);
+                    right->updateValues();
+                    return right;
                 }
+                // left - right
+                right->__left = middle->left_rotate();
+                right->updateValues();
+                return right->right_rotate();
+            }
+            Node *joined = join_left(left, middle, spine);
+            right->__left = joined;
+            right->updateValues();
+            if (joined->__height <= Node::height(right->__right) + 1)
+            {
+                return right;
+            }
+            // left - left
+            return right->right_rotate();
+        }
 
-                if (path_to_successor.isEmpty())
-                {
-                    Node *toDelete = path.back();
-                    path.back() = (*successor);
-                    delete toDelete;
+        // detaches the maximum of the subtree into last, returns the root of the rest
+        static Node *split_last(Node *root, Node *&last)
+        {
+            if (root->__right == nullptr)
+            {
+                last = root;
+                return root->__left;
+            }
+            Node *rest = split_last(root->__right, last);
+            return join_aux(root->__left, root, rest);
+        }
+
+        // joins two subtrees (every element of left smaller than every element of right) without a middle node
+        static Node *join2(Node *left, Node *right)
+        {
+            if (left == nullptr)
+            {
+                return right;
+            }
+            Node *last = nullptr;
+            Node *rest = split_last(left, last);
+            return join_aux(rest, last, right);
+        }
+
+        // splits the subtree into the elements smaller than key (left) and greater than key (right),
+        // returns the detached node equal to key or nullptr if there's none
+        Node *split_aux(Node *root, const DATA_t &key, Node *&left, Node *&right) const
+        {
+            if (root == nullptr)
+            {
+                left = right = nullptr;
+                return nullptr;
+            }
+            Node *root_left = root->__left;
+            Node *root_right = root->__right;
+            Comparison result = compare(key, root->__data);
+            if (result == Comparison::equal)
+            {
+                left = root_left;
+                right = root_right;
+                root->__left = root->__right = nullptr;
+                root->updateValues();
+                return root;
+            }
+            Node *found = nullptr;
+            Node *rest = nullptr;
+            if (result == Comparison::less)
+            {
+                found = split_aux(root_left, key, left, rest);
+                right = join_aux(rest, root, root_right);
+            }
+            else
+            {
+                found = split_aux(root_right, key, rest, right);
+                left = join_aux(root_left, root, rest);
+            }
+            return found;
+        }
+
+        // splits the subtree into the elements before key (smaller than it, or not greater if inclusive) in left and
+        // the rest in right, equal elements may be on both sides of a node so none is singled out like in split_aux()
+        void split_bound_aux(Node *root, const DATA_t &key, bool inclusive, Node *&left, Node *&right) const
+        {
+            if (root == nullptr)
+            {
+                left = right = nullptr;
+                return;
+            }
+            Node *root_left = root->__left;
+            Node *root_right = root->__right;
+            Node *rest = nullptr;
+            if (inclusive ? !is_less(key, root->__data) : is_less(root->__data, key))
+            {
+                split_bound_aux(root_right, key, inclusive, rest, right);
+                left = join_aux(root_left, root, rest);
+            }
+            else
+            {
+                split_bound_aux(root_left, key, inclusive, left, rest);
+                right = join_aux(rest, root, root_right);
+            }
+        }
+
+        // cuts the elements x with low <= x <= high out of the tree and returns their subtree
+        Node *cut_range(const DATA_t &low, const DATA_t &high)
+        {
+            Node *left = nullptr;
+            Node *rest = nullptr;
+            Node *range = nullptr;
+            Node *right = nullptr;
+            split_bound_aux(take_root(), low, false, left, rest);
+            split_bound_aux(rest, high, true, range, right);
+            __root = join2(left, right);
+            refresh_root();
+            if (range != nullptr)
+            {
+                range->__parent = nullptr;
+            }
+            return range;
+        }
+
+        // returns false once do_something did. a node marked in relaxed balance mode has a stale aggregate, its
+        // subtree is never skipped (its children are checked instead)
+        template <typename Past, typename Predicate, typename FunctionObject>
+        bool pruned_traversal_aux(const Node *root, Past &past, Predicate &keep, FunctionObject &do_something) const
+        {
+            if (root == nullptr || (root->__height != Node::UNSETTLED && !keep(Node::aggregateOf(root))))
+            {
+                return true;
+            }
+            if (!pruned_traversal_aux(root->__left, past, keep, do_something))
+            {
+                return false;
+            }
+            if (past(root->__data))
+            { // the node and its right subtree are past the end
+                return true;
+            }
+            if (keep(root->lifted()) && !do_something(root->__data))
+            {
+                return false;
+            }
+            return pruned_traversal_aux(root->__right, past, keep, do_something);
+        }
+
+        static bool fork_here(Node *first, Node *second, int threads)
+        {
+            int size = (first != nullptr ? first->__subtree_size : 0) + (second != nullptr ? second->__subtree_size : 0);
+            return threads > 1 && size > PARALLEL_CUTOFF;
+        }
+
+        Node *union_aux(Node *first, Node *second, Garbage &garbage, int threads) const
+        {
+            if (first == nullptr)
+            {
+                return second;
+            }
+            if (second == nullptr)
+            {
+                return first;
+            }
+            Node *first_left = first->__left, *first_right = first->__right;
+            Node *second_left = nullptr, *second_right = nullptr;
+            garbage.add(split_aux(second, first->__data, second_left, second_right));
+
+            bool fork = fork_here(first, second, threads);
+            Node *left = nullptr, *right = nullptr;
+            Garbage right_garbage;
+            fork_join(
+                fork,
+                [&]() { left = union_aux(first_left, second_left, garbage, threads / 2); },
+                [&]() { right = union_aux(first_right, second_right, right_garbage, threads - threads / 2); });
+            garbage.append(right_garbage);
+            return join_aux(left, first, right);
+        }
+
+        Node *intersection_aux(Node *first, Node *second, Garbage &garbage, int threads) const
+        {
+            if (first == nullptr || second == nullptr)
+            {
+                garbage.add(first);
+                garbage.add(second);
+                return nullptr;
+            }
+            Node *first_left = first->__left, *first_right = first->__right;
+            Node *second_left = nullptr, *second_right = nullptr;
+            Node *duplicate = split_aux(second, first->__data, second_left, second_right);
+
+            bool fork = fork_here(first, second, threads);
+            Node *left = nullptr, *right = nullptr;
+            Garbage right_garbage;
+            fork_join(
+                fork,
+                [&]() { left = intersection_aux(first_left, second_left, garbage, threads / 2); },
+                [&]() { right = intersection_aux(first_right, second_right, right_garbage, threads - threads / 2); });
+            garbage.append(right_garbage);
+            if (duplicate != nullptr)
+            {
+                garbage.add(duplicate);
+                return join_aux(left, first, right);
+            }
+            first->__left = first->__right = nullptr;
+            garbage.add(first);
+            return join2(left, right);
+        }
+
+        Node *difference_aux(Node *first, Node *second, Garbage &garbage, int threads) const
+        {
+            if (first == nullptr || second == nullptr)
+            {
+                garbage.add(second);
+                return first;
+            }
+            Node *first_left = first->__left, *first_right = first->__right;
+            Node *second_left = nullptr, *second_right = nullptr;
+            Node *duplicate = split_aux(second, first->__data, second_left, second_right);
+
+            bool fork = fork_here(first, second, threads);
+            Node *left = nullptr, *right = nullptr;
+            Garbage right_garbage;
+            fork_join(
+                fork,
+                [&]() { left = difference_aux(first_left, second_left, garbage, threads / 2); },
+                [&]() { right = difference_aux(first_right, second_right, right_garbage, threads - threads / 2); });
+            garbage.append(right_garbage);
+            if (duplicate != nullptr)
+            {
+                garbage.add(duplicate);
+                first->__left = first->__right = nullptr;
+                garbage.add(first);
+                return join2(left, right);
+            }
+            return join_aux(left, first, right);
+        }
+
+        // every node of the tree is created and destroyed through these (NodeHandle destroys its own)
+        template <typename... Args>
+        Node *create_node(Args &&...args)
+        {
+            Node *node = __allocator.create(std::forward<Args>(args)...);
+            this->stats_policy().allocation();
+            return node;
+        }
+
+        void destroy_node(Node *node)
+        {
+            __allocator.destroy(node);
+            this->stats_policy().release(1);
+        }
+
+        // deletes the tree with a pointer to the root, return teh size of tree it deleted (the elements in it)
+        int clear_aux(Node *root)
+        {
+            if (root == nullptr)
+            {
+                return 0;
+            }
+            int size = root->occurrences() + clear_aux(root->__left) + clear_aux(root->__right);
+            destroy_node(root);
+            return size;
+        }
+
+        // assign() without clearing the tree first (it is empty), so that the allocator is kept
+        template <typename Iterator>
+        void assign_aux(Iterator first, Iterator last);
+
+        // builds a perfectly balanced tree out of the next `count` (sorted) elements of the iterator,
+        // in-order so the iterator is only ever advanced, returns its root
+        template <typename Iterator>
+        Node *build_aux(Iterator &it, int count)
+        {
+            if (count == 0)
+            {
+                return nullptr;
+            }
+            int left_count = (count - 1) / 2;
+            Node *left = build_aux(it, left_count);
+            Node *root = nullptr;
+            try
+            {
+                root = create_node(*it);
+            }
+            catch (...)
+            {
+                clear_aux(left);
+                throw;
+            }
+            ++it;
+            root->__left = left;
+            try
+            {
+                root->__right = build_aux(it, count - 1 - left_count);
+            }
+            catch (...)
+            {
+                clear_aux(root);
+                throw;
+            }
+            root->updateValues();
+            return root;
+        }
+
+        void write_snapshot_aux(SnapshotWriter &writer, bool keep_shape) const;
+        static void write_heights_aux(const Node *root, SnapshotWriter &writer)
+        {
+            if (root == nullptr)
+            {
+                return;
+            }
+            write_heights_aux(root->__left, writer);
+            std::uint8_t height = std::uint8_t(root->__height);
+            writer.write(&height, 1);
+            write_heights_aux(root->__right, writer);
+        }
+        void read_snapshot_aux(SnapshotReader &reader);
+
+        // builds the tree whose nodes (in order) have the given heights. in an AVL tree every node is higher than its
+        // in-order neighbours below it, so the tree is the Cartesian tree of the heights and is linked with a stack
+        // of the nodes whose right subtree may still grow. throws SnapshotException if the heights aren't those of an
+        // AVL tree. returns the root
+        Node *build_shaped_aux(const DATA_t *elements, const std::uint8_t *heights, int count)
+        {
+            FixedStack<Node *, MAX_PATH_LENGTH> open; // from the root down, every one is the right child of the one before
+            Node *node = nullptr;
+            Node *done = nullptr; // the last node taken off the stack
+            // recomputes what the node caches from its (finished) subtrees and compares with the written height
+            auto finish = [](Node *done) {
+                int height = done->__height;
+                done->updateValues();
+                if (done->__height != height || done->balanceFactor() < -1 || done->balanceFactor() > 1)
+                {
+                    throw SnapshotException("The shape of the snapshot is not an AVL tree");
                 }
-                // successor DOESN'T have left by definition
-                // else if (path.back() == curr->__right)
-                //{
-                //    path.back()->__left = curr->__left;
-                //    path.back()->updateValues();
-                //    path[index_of_pointer_to_middle_node] = path.back();
-                //    delete curr;
-                //}
-                else
+            };
+            try
+            {
+                for (int i = 0; i < count; i++)
                 {
-                    // swap(path[index_of_pointer_to_middle_node]->__left,    path.back()->__left);     // switch lefts
-                    // swap(path[index_of_pointer_to_middle_node]->__right,   path.back()->__right);   // switch rights
-                    // swap(path[index_of_pointer_to_middle_node]->__height,  path.back()->__height); // switch heights
-                    // swap(path[index_of_pointer_to_middle_node],            path.back());
-                    swap(path.back()->__data, path_to_successor.back()->__data);
-                    if (path_to_successor.back()->isLeaf())
+                    int height = heights[i];
+                    if (height >= MAX_PATH_LENGTH - 1)
                     {
-                        delete path_to_successor.back();
-                        path_to_successor.back() = nullptr;
-                        path_to_successor.pop_back();
+                        throw SnapshotException("The shape of the snapshot is not an AVL tree");
                     }
-                    else
+                    node = create_node(elements[i]); // beware of bad_alloc
+                    node->__height = height;
+                    // the lower nodes before it are done, the highest of them is the root of its left subtree
+                    done = nullptr;
+                    while (!open.isEmpty() && open.back()->__height < height)
+                    {
+                        finish(open.back());
+                        done = open.back();
+                        open.pop_back();
+                    }
+                    if (!open.isEmpty() && open.back()->__height == height)
+                    {
+                        throw SnapshotException("The shape of the snapshot is not an AVL tree");
+                    }
+                    node->__left = done;
+                    done = nullptr;
+                    if (!open.isEmpty())
                     {
-                        Node *toDelete = path_to_successor.back();
-                        path_to_successor.back() = path_to_successor.back()->__right;
-                        delete toDelete;
-                        path_to_successor.pop_back();
+                        open.back()->__right = node;
                     }
+                    open.push_back(node);
+                    node = nullptr;
+                }
+                for (int i = open.size() - 1; i >= 0; i--)
+                {
+                    finish(open[i]);
                 }
-                balance(path_to_successor /*, false */);
             }
-            // balance path
-            balance(path /*, false */);
+            catch (...)
+            {
+                // every node is reachable from exactly one of these
+                if (!open.isEmpty())
+                {
+                    clear_aux(open[0]);
+                }
+                else if (done != nullptr)
+                {
+                    clear_aux(done);
+                }
+                if (node != nullptr)
+                {
+                    clear_aux(node);
+                }
+                throw;
+            }
+            return open.isEmpty() ? nullptr : open[0];
+        }
+
+        template <typename Iterator>
+        bool is_strictly_sorted(Iterator first, Iterator last) const
+        {
+            if (first == last)
+            {
+                return true;
+            }
+            for (Iterator next = std::next(first); next != last; ++first, ++next)
+            {
+                if (!is_less(*first, *next))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // compares with the comparator of the tree, one call for a three-way comparator
+        template <typename Left, typename Right>
+        Comparison compare(const Left &left, const Right &right) const
+        {
+            this->stats_policy().comparison();
+            return three_way(comparator(), left, right);
+        }
+
+        // left < right, one call for either kind of comparator
+        template <typename Left, typename Right>
+        bool is_less(const Left &left, const Right &right) const
+        {
+            this->stats_policy().comparison();
+            return avl::less(comparator(), left, right);
+        }
+
+        static const DATA_t *data_of(const Node *node)
+        {
+            return (node != nullptr) ? &node->__data : nullptr;
+        }
+
+        // returns the node holding the data (the first of the equal ones with ChainedKeys), nullptr if there's none
+        template <typename Key>
+        const Node *find_node(const Key &data) const
+        {
+            const Node *temp = __root;
+            const Node *found = nullptr;
+            int comparisons = 0;
+            while (temp != nullptr)
+            {
+                comparisons++;
+                Comparison result = compare(data, temp->__data);
+                if (result == Comparison::less)
+                {
+                    temp = temp->__left;
+                }
+                else if (result == Comparison::greater)
+                {
+                    temp = temp->__right;
+                }
+                else if (Duplicates::MULTISET && !Duplicates::COUNTED)
+                { // ChainedKeys, the oldest of the equal elements is the leftmost one
+                    found = temp;
+                    temp = temp->__left;
+                }
+                else
+                {
+                    found = temp;
+                    break;
+                }
+            }
+            this->stats_policy().search(comparisons);
+            return found;
+        }
+
+        template <typename Key>
+        const DATA_t &find_aux(const Key &data) const
+        {
+            const Node *temp = find_node(data);
+            if (temp == nullptr)
+            {
+                throw NoSuchElementException();
+            }
+            return temp->__data;
+        }
+
+        // records the slots (the pointers that point to the nodes) from the root down to the node holding
+        // the data, or down to the empty slot where it would be inserted, path.back() is that last slot
+        template <typename Key>
+        void find_path(const Key &data, Path &path)
+        {
+            Node **temp = &__root;
+            path.push_back(temp);
+            int comparisons = 0;
+            while ((*temp) != nullptr)
+            {
+                comparisons++;
+                Comparison result = compare(data, (*temp)->__data);
+                if (result == Comparison::less)
+                {
+                    temp = &((*temp)->__left);
+                }
+                else if (result == Comparison::greater)
+                {
+                    temp = &((*temp)->__right);
+                }
+                else
+                {
+                    break;
+                }
+                path.push_back(temp);
+            }
+            this->stats_policy().search(comparisons);
+        }
+
+        // find_path() for an insertion: with ChainedKeys it goes right past the equal elements down to an empty slot,
+        // so the new element comes after them
+        void find_insert_path(const DATA_t &data, Path &path)
+        {
+            if (!Duplicates::MULTISET || Duplicates::COUNTED)
+            {
+                find_path(data, path);
+                return;
+            }
+            Node **temp = &__root;
+            path.push_back(temp);
+            int comparisons = 0;
+            while ((*temp) != nullptr)
+            {
+                comparisons++;
+                temp = is_less(data, (*temp)->__data) ? &((*temp)->__left) : &((*temp)->__right);
+                path.push_back(temp);
+            }
+            this->stats_policy().search(comparisons);
+        }
+
+        // find_path() for a removal: with ChainedKeys it goes left past the equal elements and cuts the path back
+        // to the slot of the first (oldest) one
+        template <typename Key>
+        void find_element_path(const Key &data, Path &path)
+        {
+            if (!Duplicates::MULTISET || Duplicates::COUNTED)
+            {
+                find_path(data, path);
+                return;
+            }
+            Node **temp = &__root;
+            path.push_back(temp);
+            int found = 0; // the length of the path down to the last equal element seen
+            int comparisons = 0;
+            while ((*temp) != nullptr)
+            {
+                comparisons++;
+                Comparison result = compare(data, (*temp)->__data);
+                if (result == Comparison::greater)
+                {
+                    temp = &((*temp)->__right);
+                }
+                else
+                {
+                    if (result == Comparison::equal)
+                    {
+                        found = path.size();
+                    }
+                    temp = &((*temp)->__left);
+                }
+                path.push_back(temp);
+            }
+            while (found != 0 && path.size() > found)
+            {
+                path.pop_back();
+            }
+            this->stats_policy().search(comparisons);
+        }
+
+        // returns the first node that is not smaller than data, nullptr if there's none
+        template <typename Key>
+        const Node *lower_bound_aux(const Key &data) const
+        {
+            const Node *result = nullptr;
+            const Node *temp = __root;
+            while (temp != nullptr)
+            {
+                if (is_less(temp->__data, data))
+                {
+                    temp = temp->__right;
+                }
+                else
+                {
+                    result = temp;
+                    temp = temp->__left;
+                }
+            }
+            return result;
+        }
+
+        // returns the first node that is greater than data, nullptr if there's none
+        template <typename Key>
+        const Node *upper_bound_aux(const Key &data) const
+        {
+            const Node *result = nullptr;
+            const Node *temp = __root;
+            while (temp != nullptr)
+            {
+                if (is_less(data, temp->__data))
+                {
+                    result = temp;
+                    temp = temp->__left;
+                }
+                else
+                {
+                    temp = temp->__right;
+                }
+            }
+            return result;
+        }
+
+        // the size and the aggregate of a subtree. the nodes marked in relaxed balance mode have stale ones, they are
+        // recounted from their children (the nodes below the marked ones are all up to date)
+        static int subtree_size(const Node *node)
+        {
+            if (node == nullptr || node->__height != Node::UNSETTLED)
+            {
+                return (node != nullptr) ? node->__subtree_size : 0;
+            }
+            return node->occurrences() + subtree_size(node->__left) + subtree_size(node->__right);
+        }
+
+        static typename Aggregate::value_type subtree_aggregate(const Node *node)
+        {
+            if (node == nullptr || node->__height != Node::UNSETTLED)
+            {
+                return Node::aggregateOf(node);
+            }
+            return Aggregate::combine(Aggregate::combine(subtree_aggregate(node->__left), node->lifted()), subtree_aggregate(node->__right));
+        }
+
+        // returns the number of elements smaller than data (or smaller or equal if inclusive is true),
+        // sets found to whether data is in the tree
+        int count_aux(const DATA_t &data, bool inclusive, bool &found) const
+        {
+            int count = 0;
+            found = false;
+            Node *temp = __root;
+            while (temp != nullptr)
+            {
+                Comparison result = compare(data, temp->__data);
+                if (result == Comparison::less)
+                {
+                    temp = temp->__left;
+                }
+                else
+                {
+                    int left_size = subtree_size(temp->__left);
+                    if (result == Comparison::greater)
+                    {
+                        count += left_size + temp->occurrences();
+                        temp = temp->__right;
+                    }
+                    else if (Duplicates::MULTISET && !Duplicates::COUNTED)
+                    { // ChainedKeys, there may be more equal elements on either side
+                        found = true;
+                        if (inclusive)
+                        {
+                            count += left_size + 1;
+                            temp = temp->__right;
+                        }
+                        else
+                        {
+                            temp = temp->__left;
+                        }
+                    }
+                    else
+                    {
+                        found = true;
+                        return count + left_size + (inclusive ? temp->occurrences() : 0);
+                    }
+                }
+            }
+            return count;
+        }
+
+        // return a pointer the node holding the min data
+        Node *findMin() const
+        {
+            Node *temp = __root;
+            if (temp == nullptr)
+                throw NoSuchElementException();
+            while (temp->__left != nullptr)
+            {
+                temp = temp->__left;
+            }
+            return temp;
+        }
+
+        // return a pointer the node holding the max data
+        Node *findMax() const
+        {
+            Node *temp = __root;
+            if (temp == nullptr)
+                throw NoSuchElementException();
+            while (temp->__right != nullptr)
+            {
+                temp = temp->__right;
+            }
+            return temp;
+        }
+
+        // rebalances the nodes on the path bottom-up, up to the first one whose height didn't change (after its
+        // rotation, if any): nothing above it can be out of balance, they only get their sizes and aggregates refreshed
+        void balance(Path &path)
+        {
+            int length = 0;
+            while (!path.isEmpty())
+            {
+                Node *&curr_reference = *path.back();
+                path.pop_back();
+                Node *curr = curr_reference;
+                if (curr == nullptr)
+                {
+                    continue;
+                }
+                length++;
+                int old_height = curr->__height;
+
+                // update height
+                curr->updateValues();
+
+                if (curr->balanceFactor() >= 2 && curr->__left->balanceFactor() >= 0)
+                { // left - left
+                    curr_reference = curr->right_rotate();
+                    this->stats_policy().rotation(false);
+                }
+                else if (curr->balanceFactor() >= 2)
+                { // left - right
+                    curr->__left = curr->__left->left_rotate();
+                    curr_reference = curr->right_rotate();
+                    this->stats_policy().rotation(true);
+                }
+                else if (curr->balanceFactor() <= -2 && curr->__right->balanceFactor() <= 0)
+                { // right - right
+                    curr_reference = curr->left_rotate();
+                    this->stats_policy().rotation(false);
+                }
+                else if (curr->balanceFactor() <= -2)
+                { // right - left
+                    curr->__right = curr->__right->right_rotate();
+                    curr_reference = curr->left_rotate();
+                    this->stats_policy().rotation(true);
+                }
+
+                if (curr_reference->__height == old_height)
+                {
+                    while (!path.isEmpty())
+                    {
+                        (*path.back())->updateCounts();
+                        path.pop_back();
+                    }
+                }
+            }
+            this->stats_policy().rebalance_path(length);
+        }
+
+        // relaxed balance mode: marks the nodes on the path as unsettled bottom-up, up to the first one that already is
+        void mark_unsettled(Path &path)
+        {
+            while (!path.isEmpty())
+            {
+                Node *curr = *path.back();
+                path.pop_back();
+                if (curr == nullptr)
+                {
+                    continue;
+                }
+                if (curr->__height == Node::UNSETTLED)
+                {
+                    return;
+                }
+                curr->__height = Node::UNSETTLED;
+            }
+        }
+
+        // either balances the path or, in relaxed balance mode, marks it for rebalance()
+        void balance_or_mark(Path &path)
+        {
+            if (__relaxed)
+            {
+                mark_unsettled(path);
+            }
+            else
+            {
+                balance(path);
+            }
+        }
+
+        // the subtrees below the unsettled nodes are AVL trees, each unsettled node is joined with its (settled)
+        // subtrees bottom-up, in O(1) per node and O(height difference) more where the subtrees drifted apart
+        static Node *settle_aux(Node *root)
+        {
+            if (root == nullptr || root->__height != Node::UNSETTLED)
+            {
+                return root;
+            }
+            Node *left = settle_aux(root->__left);
+            Node *right = settle_aux(root->__right);
+            return join_aux(left, root, right);
+        }
+
+        bool is_settled() const
+        {
+            return __root == nullptr || __root->__height != Node::UNSETTLED;
+        }
+
+        // the deepest a node may get in relaxed balance mode before the tree is rebalanced, above the height of any AVL
+        // tree of that size (at most 1.44 log2(n)), and never more than the path buffer can hold
+        int relaxed_depth_limit() const
+        {
+            int limit = 4 + 2 * (32 - __builtin_clz(unsigned(__size) | 1u)); // 4 + 2 * bits of size
+            return (limit < MAX_PATH_LENGTH - 4) ? limit : MAX_PATH_LENGTH - 4;
+        }
+
+        // data is a DATA_t that is copied or moved into the node
+        template <typename T>
+        bool insert_aux(T &&data)
+        {
+            Path path;
+            find_insert_path(data, path);
+            if (*path.back() != nullptr)
+            { // duplicate
+                return add_occurrences(path, 1);
+            }
+            attach(path, create_node(std::forward<T>(data))); // beware of bad_alloc
+            return true;
+        }
+
+        // an element equal to the node at the back of the path is inserted count times, with CountedKeys the node
+        // counts them (and the sizes and aggregates above are refreshed), otherwise it's a duplicate: returns false
+        bool add_occurrences(Path &path, int count)
+        {
+            if (!Duplicates::COUNTED)
+            {
+                return false;
+            }
+            (*path.back())->addOccurrences(count);
+            balance_or_mark(path);
+            return true;
+        }
+
+        // links a node that isn't in any tree (a new one or one from a NodeHandle), returns false without
+        // touching it if an equal element is already in the tree
+        bool insert_node(Node *node)
+        {
+            Path path;
+            find_insert_path(node->__data, path);
+            int count = node->occurrences();
+            if (*path.back() != nullptr)
+            { // duplicate, with CountedKeys the node is merged into the one of its key
+                if (!add_occurrences(path, count))
+                {
+                    return false;
+                }
+                destroy_node(node);
+            }
+            else
+            {
+                node->__left = node->__right = nullptr;
+                node->updateValues(); // the data may have changed (NodeHandle::value())
+                attach(path, node);
+            }
+            __size += count;
+            return true;
+        }
+
+        template <typename Key>
+        void remove_element(const Key &data);
+        template <typename Key>
+        bool erase_element(const Key &data);
+        template <typename Key>
+        NodeHandle extract_element(const Key &data);
+        // unlinks the node holding data and updates what the tree caches, throws NoSuchElementException if
+        // there's none
+        template <typename Key>
+        Node *detach_element(const Key &data);
+        // takes over the nodes, caches and allocator of other, this tree must be empty
+        void take_over(Tree &other);
+
+        // puts a new node into the empty slot at the back of the path and balances the path
+        void attach(Path &path, Node *inserted)
+        {
+            Node *parent = (path.size() > 1) ? *path[path.size() - 2] : nullptr;
+            inserted->__parent = parent;
+            *path.back() = inserted;
+            // the new node is the new minimum exactly when it hangs left of the old minimum (and the same for
+            // the maximum), so the cached extremes are kept up to date in O(1)
+            if (parent == nullptr)
+            {
+                __min_element = __max_element = inserted;
+            }
+            else if (parent == __min_element && parent->__left == inserted)
+            {
+                __min_element = inserted;
+            }
+            else if (parent == __max_element && parent->__right == inserted)
+            {
+                __max_element = inserted;
+            }
+            path.pop_back(); // new inserted node dont need balancing
+            if (__relaxed && path.size() > relaxed_depth_limit())
+            { // the tree got too deep for the searches (and the path buffer), it's settled at once
+                mark_unsettled(path);
+                rebalance();
+                return;
+            }
+            // balance path
+            balance_or_mark(path);
+        }
+
+        // detaches the node holding data (the first one with ChainedKeys) from the tree and balances it, returns the
+        // node (nullptr if there's none)
+        template <typename Key>
+        Node *unlink_aux(const Key &data)
+        {
+            Path path;
+            find_element_path(data, path);
+            return unlink_path(path);
+        }
+
+        // detaches the node at the back of the path, see unlink_aux()
+        Node *unlink_path(Path &path)
+        {
+            Node *curr = *path.back();
+            if (curr == nullptr)
+            {
+                return nullptr;
+            }
+            // the neighbour of a removed extreme takes its place, next() and previous() are O(1) there since the
+            // minimum has no left child (and the maximum no right child)
+            if (curr == __min_element)
+            {
+                __min_element = curr->next();
+            }
+            if (curr == __max_element)
+            {
+                __max_element = curr->previous();
+            }
+            // path NOT empty and back is VALID
+            if (curr->isLeaf())
+            {
+                *path.back() = nullptr;
+                path.pop_back();
+            }
+            else if (curr->hasLeft() && !curr->hasRight())
+            {
+                *path.back() = curr->__left;
+                curr->__left->__parent = curr->__parent;
+                path.pop_back();
+            }
+            else if (!curr->hasLeft() && curr->hasRight())
+            {
+                *path.back() = curr->__right;
+                curr->__right->__parent = curr->__parent;
+                path.pop_back();
+            }
+            else
+            { // (curr->hasLeft() && curr->hasRight())
+                // find successor (go right once then all the way to the left), the walk is recorded
+                // on the same path so a single balancing pass fixes both parts
+                int curr_index = path.size() - 1;
+                path.push_back(&curr->__right);
+                while ((*path.back())->__left != nullptr)
+                {
+                    path.push_back(&((*path.back())->__left));
+                }
+                this->stats_policy().successor_walk(path.size() - 1 - curr_index);
+                // successor DOESN'T have left by definition
+                Node *successor = *path.back();
+                *path.back() = successor->__right;
+                path.pop_back();
+                // the successor takes the place of curr (nodes are relinked rather than their data swapped,
+                // so iterators to the successor stay valid), the slot inside curr on the path moves to the successor
+                // the parents are set here as balance() may stop before it gets up to them
+                Node *moved = successor->__right;
+                if (moved != nullptr)
+                {
+                    moved->__parent = (successor->__parent != curr) ? successor->__parent : successor;
+                }
+                successor->__left = curr->__left;
+                successor->__right = curr->__right;
+                successor->__parent = curr->__parent;
+                successor->__height = curr->__height; // balance() compares with the height of the place it takes
+                successor->__left->__parent = successor;
+                if (successor->__right != nullptr)
+                {
+                    successor->__right->__parent = successor;
+                }
+                *path[curr_index] = successor;
+                if (path.size() > curr_index + 1)
+                {
+                    path[curr_index + 1] = &successor->__right;
+                }
+            }
+            // balance path
+            balance_or_mark(path);
+
+            return curr;
+        }
+
+        template <typename FunctionObject>
+        bool in_order_traversal_aux_recursive(Node *const root, FunctionObject &do_something) const
+        {
+            if (root == nullptr)
+            {
+                return false;
+            }
+            in_order_traversal_aux_recursive(root->__left, do_something);
+            do_something(root->__data);
+            in_order_traversal_aux_recursive(root->__right, do_something);
+            return true;
+        }
+
+        template <typename FunctionObject>
+        bool reverse_in_order_traversal_aux_recursive(Node *const root, FunctionObject &do_something) const
+        {
+            if (root == nullptr)
+            {
+                return false;
+            }
+            reverse_in_order_traversal_aux_recursive(root->__right, do_something);
+            do_something(root->__data);
+            reverse_in_order_traversal_aux_recursive(root->__left, do_something);
+            return true;
+        }
+
+        void display_aux(Node *cur, int depth = 0, short nodeType = 0)
+        {   // nodeType == 0 is root
+            // nodeType == 1 is left
+            // nodeType == 2 is right
+            if (cur->__left) {
+                display_aux(cur->__left, depth + 1, 1);
+            }
+
+            for (int i = 0; i < depth; i++) // padding
+            {
+                printf("     ");
+            }
+
+            if (nodeType == 1) // left
+            {
+                printf("┌---"); // or use "┌───" for a more smooth look
+            }
+            else if (nodeType == 2) // right
+            {
+                printf("└---"); // or use "└───" for a more smooth look
+            }
+            else // root
+            {
+                printf("*---");
+            }
+                
+
+            // if you'd like to print hte height as well comment out the below comment
+            std::cout << "[" << cur->__data /* << ",  " << cur->__height */ << "]" << std::endl;
+
+            if (cur->__right)
+            {
+                display_aux(cur->__right, depth + 1, 2);
+            }
+        }
+    };
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::Tree() : Tree(Compare())
+    {
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::Tree(const Compare &compare)
+        : CompareStorage<Compare>(compare), __root(nullptr), __min_element(nullptr), __max_element(nullptr), __size(0),
+          __relaxed(false)
+    {
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    template <typename Iterator>
+    Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::Tree(Iterator first, Iterator last, const Compare &compare) : Tree(compare)
+    {
+        assign(first, last);
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::~Tree()
+    {
+        clear();
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::Tree(Tree &&other) : Tree(other.comparator())
+    {
+        take_over(other);
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates> &Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::operator=(Tree &&other)
+    {
+        if (&other != this)
+        {
+            clear();
+            CompareStorage<Compare>::operator=(other);
+            take_over(other);
+        }
+        return *this;
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::swap(Tree &other)
+    {
+        avl::swap(static_cast<CompareStorage<Compare> &>(*this), static_cast<CompareStorage<Compare> &>(other));
+        avl::swap(__root, other.__root);
+        avl::swap(__min_element, other.__min_element);
+        avl::swap(__max_element, other.__max_element);
+        avl::swap(__size, other.__size);
+        avl::swap(__relaxed, other.__relaxed); // unsettled nodes can't go to a tree that balances strictly
+        __allocator.swap(other.__allocator);
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::take_over(Tree &other)
+    {
+        assert(isEmpty());
+        __allocator.swap(other.__allocator);
+        __root = other.__root;
+        __min_element = other.__min_element;
+        __max_element = other.__max_element;
+        __size = other.__size;
+        __relaxed = other.__relaxed;
+        other.__root = other.__min_element = other.__max_element = nullptr;
+        other.__size = 0;
+        other.__relaxed = false;
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    template <typename Iterator>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::assign(Iterator first, Iterator last)
+    {
+        static_assert(!Duplicates::MULTISET, "assign() is only for unique keys");
+        clear();
+        assign_aux(first, last);
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    template <typename Iterator>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::assign_aux(Iterator first, Iterator last)
+    {
+        if (is_strictly_sorted(first, last))
+        {
+            int count = int(std::distance(first, last));
+            __root = build_aux(first, count);
+            __size = count;
+        }
+        else
+        {
+            std::vector<DATA_t> elements(first, last);
+            parallel_sort(elements.begin(), elements.end(),
+                          [this](const DATA_t &a, const DATA_t &b) { return is_less(a, b); });
+            auto unique_end = std::unique(elements.begin(), elements.end(),
+                                          [this](const DATA_t &a, const DATA_t &b) { return !is_less(a, b); });
+            auto it = std::make_move_iterator(elements.begin()); // the copies are moved into the nodes
+            __size = int(unique_end - elements.begin());
+            __root = build_aux(it, __size);
+        }
+        if (__root != nullptr)
+        {
+            __root->__parent = nullptr;
+        }
+        if (!isEmpty())
+        {
+            __min_element = findMin();
+            __max_element = findMax();
+        }
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::write_snapshot(std::ostream &out, bool keep_shape) const
+    {
+        static_assert(!Duplicates::MULTISET, "snapshots are only for unique keys");
+        SnapshotWriter writer(out);
+        write_snapshot_aux(writer, keep_shape);
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::read_snapshot(std::istream &in)
+    {
+        static_assert(!Duplicates::MULTISET, "snapshots are only for unique keys");
+        SnapshotReader reader(in);
+        read_snapshot_aux(reader);
+    }
+
+#ifdef AVL_HAS_MMAP
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::write_snapshot(int fd, bool keep_shape) const
+    {
+        static_assert(!Duplicates::MULTISET, "snapshots are only for unique keys");
+        SnapshotWriter writer(fd);
+        write_snapshot_aux(writer, keep_shape);
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::read_snapshot(int fd)
+    {
+        static_assert(!Duplicates::MULTISET, "snapshots are only for unique keys");
+        SnapshotReader reader(fd);
+        read_snapshot_aux(reader);
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::assign(const MappedSnapshot<DATA_t, Compare> &snapshot)
+    {
+        static_assert(!Duplicates::MULTISET, "snapshots are only for unique keys");
+        if (snapshot.heights() == nullptr || !is_strictly_sorted(snapshot.begin(), snapshot.end()))
+        {
+            assign(snapshot.begin(), snapshot.end());
+            return;
+        }
+        clear();
+        __root = build_shaped_aux(snapshot.begin(), snapshot.heights(), snapshot.size());
+        __size = snapshot.size();
+        if (__root != nullptr)
+        {
+            __root->__parent = nullptr;
+            __min_element = findMin();
+            __max_element = findMax();
+        }
+    }
+#endif
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::write_snapshot_aux(SnapshotWriter &writer, bool keep_shape) const
+    {
+        keep_shape = keep_shape && is_settled(); // the heights are only known once the tree is rebalanced
+        SnapshotHeader header = make_snapshot_header<DATA_t>(std::uint64_t(__size), keep_shape);
+        writer.write(&header, sizeof(header));
+        // recursion rather than the iterators, which walk up through the parents
+        auto write_element = [&](const DATA_t &data) { writer.write(&data, sizeof(DATA_t)); };
+        const_traversal_aux_recursive(__root, write_element);
+        if (keep_shape)
+        {
+            write_heights_aux(__root, writer);
+        }
+        writer.flush();
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::read_snapshot_aux(SnapshotReader &reader)
+    {
+        SnapshotHeader header;
+        reader.read(&header, sizeof(header));
+        check_snapshot_header<DATA_t>(header);
+        std::uint64_t shape_size = (header.__flags & SNAPSHOT_SHAPE) ? header.__count : 0;
+        reader.expect(header.__count * sizeof(DATA_t) + shape_size);
+        clear();
+        SnapshotIterator<DATA_t, Compare> it(reader, comparator());
+        __root = build_aux(it, int(header.__count));
+        __size = int(header.__count);
+        if (__root != nullptr)
+        {
+            __root->__parent = nullptr;
+            __min_element = findMin();
+            __max_element = findMax();
+        }
+        try
+        {
+            reader.skip(std::size_t(shape_size));
+        }
+        catch (...)
+        {
+            clear();
+            throw;
+        }
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::insert(const DATA_t &data)
+    {
+        if (!try_insert(data))
+        {
+            throw ElementAlreadyExistsException();
+        }
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::insert(DATA_t &&data)
+    {
+        if (!try_insert(std::move(data)))
+        {
+            throw ElementAlreadyExistsException();
+        }
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    bool Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::try_insert(const DATA_t &data)
+    {
+        if (!insert_aux(data))
+        {
+            return false;
+        }
+        __size++;
+        return true;
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    bool Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::try_insert(DATA_t &&data)
+    {
+        if (!insert_aux(std::move(data)))
+        {
+            return false;
+        }
+        __size++;
+        return true;
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    template <typename... Args>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::emplace(Args &&...args)
+    {
+        Node *node = create_node(std::forward<Args>(args)...); // beware of bad_alloc
+        if (!insert_node(node))
+        {
+            destroy_node(node);
+            throw ElementAlreadyExistsException();
+        }
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::remove(const DATA_t &data)
+    {
+        remove_element(data);
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    template <typename Key>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::remove_element(const Key &data)
+    {
+        if (!erase_element(data))
+        {
+            throw NoSuchElementException();
+        }
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    template <typename Key>
+    bool Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::erase_element(const Key &data)
+    {
+        Path path;
+        find_element_path(data, path);
+        Node *found = *path.back();
+        if (found == nullptr)
+        {
+            return false;
+        }
+        __size--;
+        if (found->occurrences() > 1)
+        { // CountedKeys, the key stays with one occurrence less
+            found->addOccurrences(-1);
+            balance_or_mark(path);
+            return true;
+        }
+        destroy_node(unlink_path(path));
+        return true;
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    template <typename Key>
+    typename Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::Node *Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::detach_element(const Key &data)
+    {
+        Node *removed = unlink_aux(data);
+        if (removed == nullptr)
+        {
+            throw NoSuchElementException();
+        }
+        __size -= removed->occurrences();
+        return removed;
+    }
 
-            return true;
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    typename Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::NodeHandle Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::extract(const DATA_t &key)
+    {
+        return extract_element(key);
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    template <typename Key>
+    typename Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::NodeHandle Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::extract_element(const Key &key)
+    {
+        NodeHandle handle;
+        handle.__node = detach_element(key);
+        handle.__allocator.merge(__allocator);
+        return handle;
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::insert(NodeHandle &&handle)
+    {
+        if (handle.isEmpty())
+        {
+            return;
         }
+        __allocator.merge(handle.__allocator);
+        if (!insert_node(handle.__node))
+        {
+            throw ElementAlreadyExistsException();
+        }
+        handle.__node = nullptr;
+    }
 
-        template <typename FunctionObject>
-        bool in_order_traversal_aux_recursive(Node *const root, FunctionObject do_something) const
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    template <typename Key, typename... Args>
+    std::pair<typename Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::const_iterator, bool>
+    Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::find_or_emplace(const Key &key, Args &&...args)
+    {
+        Path path;
+        find_path(key, path);
+        if (*path.back() != nullptr)
         {
-            if (root == nullptr)
+            return std::make_pair(const_iterator(*path.back(), this), false);
+        }
+        Node *inserted = create_node(std::forward<Args>(args)...); // beware of bad_alloc
+        assert(compare(key, inserted->__data) == Comparison::equal);
+        attach(path, inserted);
+        __size++;
+        return std::make_pair(const_iterator(inserted, this), true);
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    int Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::count(const DATA_t &data) const
+    {
+        if (Duplicates::MULTISET && !Duplicates::COUNTED)
+        { // the chain of equal elements may be spread over many nodes, its length comes from the subtree sizes
+            bool found = false;
+            return count_aux(data, true, found) - count_aux(data, false, found);
+        }
+        const Node *node = find_node(data);
+        return (node != nullptr) ? node->occurrences() : 0;
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    int Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::erase_all(const DATA_t &data)
+    {
+        if (!Duplicates::MULTISET || Duplicates::COUNTED)
+        { // one node holds them all
+            Node *removed = unlink_aux(data);
+            if (removed == nullptr)
             {
-                return false;
+                return 0;
             }
-            in_order_traversal_aux_recursive(root->__left, do_something);
-            do_something(root->__data);
-            in_order_traversal_aux_recursive(root->__right, do_something);
-            return true;
+            int count = removed->occurrences();
+            __size -= count;
+            destroy_node(removed);
+            return count;
+        }
+        rebalance(); // take_root() would rebalance anyway, count() is O(log n) on a settled tree
+        int count = this->count(data);
+        if (count <= 1)
+        {
+            return erase_element(data) ? 1 : 0;
         }
+        // the chain is cut out with two splits and the rest joined back
+        Node *left = nullptr;
+        Node *rest = nullptr;
+        Node *chain = nullptr;
+        Node *right = nullptr;
+        split_bound_aux(take_root(), data, false, left, rest);
+        split_bound_aux(rest, data, true, chain, right);
+        __root = join2(left, right);
+        refresh_root();
+        clear_aux(chain);
+        return count;
+    }
 
-        template <typename FunctionObject>
-        bool reverse_in_order_traversal_aux_recursive(Node *const root, FunctionObject do_something) const
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::relax_balance(bool relaxed)
+    {
+        if (!relaxed)
         {
-            if (root == nullptr)
-            {
-                return false;
-            }
-            reverse_in_order_traversal_aux_recursive(root->__right, do_something);
-            do_something(root->__data);
-            reverse_in_order_traversal_aux_recursive(root->__left, do_something);
-            return true;
+            rebalance();
         }
+        __relaxed = relaxed;
+    }
 
-        void display_aux(Node *cur, int depth = 0, short nodeType = 0)
-        {   // nodeType == 0 is root
-            // nodeType == 1 is left
-            // nodeType == 2 is right
-            if (cur->__left) {
-                display_aux(cur->__left, depth + 1, 1);
-            }
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::rebalance()
+    {
+        if (!is_settled())
+        {
+            __root = settle_aux(__root);
+            __root->__parent = nullptr;
+        }
+    }
 
-            for (int i = 0; i < depth; i++) // padding
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::clear()
+    {
+        // with CountedKeys __size counts occurrences rather than nodes, the nodes are visited to count them for the stats.
+        // a pool shared with other trees (after split, join, the set operations) outlives this tree, so its slots
+        // have to go back to it one by one
+        if (std::is_trivially_destructible<Node>::value && Allocator<Node>::BULK_RELEASE &&
+            (!Duplicates::COUNTED || std::is_same<Stats, NoStats>::value) && __allocator.exclusive())
+        { // nothing to destruct, the nodes go away with the memory they live in
+            this->stats_policy().release(__size);
+            __size = 0;
+        }
+        else
+        {
+            __size -= clear_aux(__root);
+            assert(__size == 0);
+        }
+        __allocator.release_all();
+        __root = nullptr;
+        __min_element = nullptr;
+        __max_element = nullptr;
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    bool Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::split(const DATA_t &key, Tree &greater)
+    {
+        static_assert(!Duplicates::MULTISET, "split() is only for unique keys");
+        assert(&greater != this);
+        greater.clear();
+        greater.__allocator.merge(__allocator);
+        Node *left = nullptr, *right = nullptr;
+        Node *found = split_aux(take_root(), key, left, right);
+        if (found != nullptr)
+        {
+            destroy_node(found);
+        }
+        __root = left;
+        refresh_root();
+        greater.__root = right;
+        greater.refresh_root();
+        return found != nullptr;
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::join(Tree &left, const DATA_t &key, Tree &right)
+    {
+        assert(left.isEmpty() || left.is_less(left.getMax(), key));
+        assert(right.isEmpty() || right.is_less(key, right.getMin()));
+        if (&left != this && &right != this)
+        {
+            clear();
+        }
+        __allocator.merge(left.__allocator);
+        __allocator.merge(right.__allocator);
+        Node *middle = create_node(key); // beware of bad_alloc
+        Node *left_root = left.take_root();
+        Node *right_root = right.take_root();
+        __root = join_aux(left_root, middle, right_root);
+        refresh_root();
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    int Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::erase_range(const DATA_t &low, const DATA_t &high)
+    {
+        if (__root == nullptr || is_less(high, low))
+        {
+            return 0;
+        }
+        int before = __size;
+        Node *range = cut_range(low, high);
+        int count = before - __size;
+        if (__root == nullptr)
+        { // the whole tree went, clear() can give the nodes back without visiting them
+            __root = range;
+            __size = count;
+            clear();
+        }
+        else
+        {
+            clear_aux(range);
+        }
+        return count;
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates> Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::extract_range(const DATA_t &low, const DATA_t &high)
+    {
+        Tree extracted(comparator());
+        if (__root == nullptr || is_less(high, low))
+        {
+            return extracted;
+        }
+        extracted.__allocator.merge(__allocator);
+        extracted.__root = cut_range(low, high);
+        extracted.refresh_root();
+        return extracted;
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::set_union(Tree &other, int threads)
+    {
+        static_assert(!Duplicates::MULTISET, "the set operations are only for unique keys");
+        if (&other == this)
+        {
+            return;
+        }
+        __allocator.merge(other.__allocator);
+        Garbage garbage;
+        Node *first = take_root();
+        __root = union_aux(first, other.take_root(), garbage, threads);
+        refresh_root();
+        destroy_garbage(garbage);
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::set_intersection(Tree &other, int threads)
+    {
+        static_assert(!Duplicates::MULTISET, "the set operations are only for unique keys");
+        if (&other == this)
+        {
+            return;
+        }
+        __allocator.merge(other.__allocator);
+        Garbage garbage;
+        Node *first = take_root();
+        __root = intersection_aux(first, other.take_root(), garbage, threads);
+        refresh_root();
+        destroy_garbage(garbage);
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::set_difference(Tree &other, int threads)
+    {
+        static_assert(!Duplicates::MULTISET, "the set operations are only for unique keys");
+        if (&other == this)
+        {
+            clear();
+            return;
+        }
+        __allocator.merge(other.__allocator);
+        Garbage garbage;
+        Node *first = take_root();
+        __root = difference_aux(first, other.take_root(), garbage, threads);
+        refresh_root();
+        destroy_garbage(garbage);
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    const bool Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::isEmpty() const
+    {
+        return (__root == nullptr);
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    const int Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::size() const
+    {
+        return __size;
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    const DATA_t &Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::find(const DATA_t &data) const
+    {
+        return find_aux(data);
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::find_batch(const DATA_t *keys, int count, const DATA_t **out) const
+    {
+        for (int start = 0; start < count; start += BATCH_LANES)
+        {
+            int lanes = (count - start < BATCH_LANES) ? count - start : BATCH_LANES;
+            const Node *cursors[BATCH_LANES];
+            for (int i = 0; i < lanes; i++)
             {
-                printf("     ");
+                cursors[i] = __root;
+                out[start + i] = nullptr;
             }
-
-            if (nodeType == 1) // left
+            bool active = true;
+            while (active)
             {
-                printf("┌---"); // or use "┌───" for a more smooth look
+                active = false;
+                for (int i = 0; i < lanes; i++)
+                {
+                    const Node *temp = cursors[i];
+                    if (temp == nullptr)
+                    {
+                        continue;
+                    }
+                    Comparison result = compare(keys[start + i], temp->__data);
+                    if (result == Comparison::equal)
+                    {
+                        out[start + i] = &temp->__data;
+                        cursors[i] = nullptr;
+                        continue;
+                    }
+                    temp = (result == Comparison::less) ? temp->__left : temp->__right;
+                    __builtin_prefetch(temp); // it's only compared with on the next round
+                    cursors[i] = temp;
+                    active = active || (temp != nullptr);
+                }
             }
-            else if (nodeType == 2) // right
+        }
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::find_batch(const std::vector<DATA_t> &keys, std::vector<const DATA_t *> &out) const
+    {
+        out.resize(keys.size());
+        find_batch(keys.data(), int(keys.size()), out.data());
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    template <typename Iterator>
+    int Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::insert_batch(Iterator first, Iterator last)
+    {
+        int old_size = __size;
+        if (int(std::distance(first, last)) * BATCH_UNION_RATIO < __size)
+        { // a small batch is cheaper to insert one by one, in order so consecutive searches hit the same nodes
+            if (is_strictly_sorted(first, last))
             {
-                printf("└---"); // or use "└───" for a more smooth look
+                for (; first != last; ++first)
+                {
+                    __size += insert_aux(*first);
+                }
+                return __size - old_size;
             }
-            else // root
+            std::vector<DATA_t> elements(first, last);
+            std::sort(elements.begin(), elements.end(), [this](const DATA_t &a, const DATA_t &b) { return is_less(a, b); });
+            auto unique_end = std::unique(elements.begin(), elements.end(),
+                                          [this](const DATA_t &a, const DATA_t &b) { return !is_less(a, b); });
+            for (auto it = elements.begin(); it != unique_end; ++it)
             {
-                printf("*---");
+                __size += insert_aux(std::move(*it));
             }
-                
+            return __size - old_size;
+        }
+        // the batch takes its nodes from this tree's pool, a pool of its own would join this one in set_union()
+        // with every node of the batch while the free slots of this one go unused
+        Tree batch(comparator());
+        batch.__allocator.merge(__allocator);
+        batch.assign_aux(first, last);
+        set_union(batch);
+        return __size - old_size;
+    }
 
-            // if you'd like to print hte height as well comment out the below comment
-            std::cout << "[" << cur->__data /* << ",  " << cur->__height */ << "]" << std::endl;
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    const DATA_t &Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::getMin() const
+    {
+        if (__root == nullptr)
+        {
+            throw NoSuchElementException();
+        }
+        return __min_element->__data;
+    }
 
-            if (cur->__right)
-            {
-                display_aux(cur->__right, depth + 1, 2);
-            }
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    const DATA_t &Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::getMax() const
+    {
+        if (__root == nullptr)
+        {
+            throw NoSuchElementException();
         }
-    };
+        return __max_element->__data;
+    }
 
-    template <typename DATA_t, Comparison (*ComparisonFunc)(const DATA_t &, const DATA_t &)>
-    Tree<DATA_t, ComparisonFunc>::Tree() : __root(nullptr), __min_element(nullptr), __max_element(nullptr), __size(0)
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    template <typename FunctionObject>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::parallel_for_each(FunctionObject do_something, int threads) const
     {
+        if (threads <= 1 || __size <= PARALLEL_CUTOFF)
+        {
+            const_traversal_aux_recursive(__root, do_something);
+            return;
+        }
+        std::vector<TraversalTask> tasks = traversal_tasks();
+        parallel_for_index(
+            int(tasks.size()),
+            [&](int i) {
+                FunctionObject local = do_something;
+                run_task(tasks[i], local);
+            },
+            threads);
     }
 
-    template <typename DATA_t, Comparison (*ComparisonFunc)(const DATA_t &, const DATA_t &)>
-    Tree<DATA_t, ComparisonFunc>::~Tree()
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    template <typename T, typename MapFunction, typename CombineFunction>
+    T Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::parallel_reduce(T identity, MapFunction map, CombineFunction combine, int threads) const
     {
-        clear();
+        if (threads <= 1 || __size <= PARALLEL_CUTOFF)
+        {
+            T result = identity;
+            auto accumulate = [&](const DATA_t &data) { result = combine(std::move(result), map(data)); };
+            const_traversal_aux_recursive(__root, accumulate);
+            return result;
+        }
+        // every task reduces its own elements, the partial results are combined in order
+        std::vector<TraversalTask> tasks = traversal_tasks();
+        std::vector<T> partial(tasks.size(), identity);
+        parallel_for_index(
+            int(tasks.size()),
+            [&](int i) {
+                T result = identity;
+                auto accumulate = [&](const DATA_t &data) { result = combine(std::move(result), map(data)); };
+                run_task(tasks[i], accumulate);
+                partial[i] = std::move(result);
+            },
+            threads);
+        T result = identity;
+        for (const T &part : partial)
+        {
+            result = combine(std::move(result), part);
+        }
+        return result;
     }
 
-    template <typename DATA_t, Comparison (*ComparisonFunc)(const DATA_t &, const DATA_t &)>
-    void Tree<DATA_t, ComparisonFunc>::insert(const DATA_t &data)
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    template <typename MapFunction, typename DeliverFunction>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::parallel_for_each_ordered(MapFunction map, DeliverFunction deliver, int threads) const
     {
-        if (insert_aux(data)) // insert successful
+        if (threads <= 1 || __size <= PARALLEL_CUTOFF)
         {
-            __size++;
-            __min_element = findMin();
-            __max_element = findMax();
+            auto map_and_deliver = [&](const DATA_t &data) { deliver(map(data)); };
+            const_traversal_aux_recursive(__root, map_and_deliver);
+            return;
         }
-        else
+        typedef typename std::decay<decltype(map(std::declval<const DATA_t &>()))>::type Result;
+        std::vector<TraversalTask> tasks = traversal_tasks();
+        // the tasks go in windows, the results of one window are delivered while the next one is computed
+        int window = 4 * threads;
+        int workers = std::max(1, threads - 1);
+        auto compute = [&](int first, std::vector<std::vector<Result>> &results) {
+            int count = std::min(window, int(tasks.size()) - first);
+            results.assign(count, std::vector<Result>());
+            parallel_for_index(
+                count,
+                [&](int i) {
+                    std::vector<Result> &out = results[i];
+                    auto collect = [&](const DATA_t &data) { out.push_back(map(data)); };
+                    run_task(tasks[first + i], collect);
+                },
+                workers);
+        };
+        std::vector<std::vector<Result>> ready, next;
+        compute(0, ready);
+        for (int first = 0; first < int(tasks.size()); first += window)
         {
-            throw ElementAlreadyExistsException();
+            std::exception_ptr error;
+            bool more = first + window < int(tasks.size());
+            fork_join(
+                more,
+                [&]() {
+                    try
+                    {
+                        if (more)
+                        {
+                            compute(first + window, next);
+                        }
+                    }
+                    catch (...)
+                    {
+                        error = std::current_exception();
+                    }
+                },
+                [&]() {
+                    for (std::vector<Result> &results : ready)
+                    {
+                        for (Result &result : results)
+                        {
+                            deliver(std::move(result));
+                        }
+                    }
+                });
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+            ready.swap(next);
         }
     }
 
-    template <typename DATA_t, Comparison (*ComparisonFunc)(const DATA_t &, const DATA_t &)>
-    void Tree<DATA_t, ComparisonFunc>::remove(const DATA_t &data)
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    const DATA_t &Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::select(int k) const
     {
-        if (remove_aux(data)) // deletion successful
+        if (k < 0 || k >= __size)
+        {
+            throw NoSuchElementException();
+        }
+        Node *temp = __root;
+        while (true)
         {
-            __size--;
-            if (isEmpty())
+            int left_size = subtree_size(temp->__left);
+            if (k < left_size)
             {
-                __min_element = nullptr;
-                __max_element = nullptr;
+                temp = temp->__left;
+            }
+            else if (k >= left_size + temp->occurrences())
+            {
+                k -= left_size + temp->occurrences();
+                temp = temp->__right;
             }
             else
             {
-                __min_element = findMin();
-                __max_element = findMax();
+                return temp->__data;
             }
         }
-        else
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    int Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::rank(const DATA_t &data) const
+    {
+        bool found = false;
+        int count = count_aux(data, false, found);
+        if (!found)
         {
             throw NoSuchElementException();
         }
+        return count;
     }
 
-    template <typename DATA_t, Comparison (*ComparisonFunc)(const DATA_t &, const DATA_t &)>
-    void Tree<DATA_t, ComparisonFunc>::clear()
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    int Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::count_less(const DATA_t &data) const
     {
-        __size -= clear_aux(__root);
-        assert(__size == 0);
-        __root = nullptr;
-        __min_element = nullptr;
-        __max_element = nullptr;
+        bool found = false;
+        return count_aux(data, false, found);
     }
 
-    template <typename DATA_t, Comparison (*ComparisonFunc)(const DATA_t &, const DATA_t &)>
-    const bool Tree<DATA_t, ComparisonFunc>::isEmpty() const
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    int Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::count_in_range(const DATA_t &low, const DATA_t &high) const
     {
-        return (__root == nullptr);
+        if (is_less(high, low))
+        {
+            return 0;
+        }
+        bool found = false;
+        return count_aux(high, true, found) - count_aux(low, false, found);
     }
 
-    template <typename DATA_t, Comparison (*ComparisonFunc)(const DATA_t &, const DATA_t &)>
-    const int Tree<DATA_t, ComparisonFunc>::size() const
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    const DATA_t &Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::median() const
     {
-        return __size;
+        return select((__size - 1) / 2);
     }
 
-    template <typename DATA_t, Comparison (*ComparisonFunc)(const DATA_t &, const DATA_t &)>
-    const DATA_t &Tree<DATA_t, ComparisonFunc>::find(const DATA_t &data) const
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    typename Aggregate::value_type Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::aggregate() const
     {
-        return find_aux(data);
+        return subtree_aggregate(__root);
     }
 
-    template <typename DATA_t, Comparison (*ComparisonFunc)(const DATA_t &, const DATA_t &)>
-    const DATA_t &Tree<DATA_t, ComparisonFunc>::getMin() const
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    typename Aggregate::value_type Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::aggregate(const DATA_t &low, const DATA_t &high) const
     {
-        if (__root == nullptr)
+        // go down to the first node inside the range, below it the range splits into a walk along
+        // the low boundary (in its left subtree) and a walk along the high boundary (in its right subtree)
+        Node *split = __root;
+        while (split != nullptr)
         {
-            throw NoSuchElementException();
+            if (is_less(split->__data, low))
+            {
+                split = split->__right;
+            }
+            else if (is_less(high, split->__data))
+            {
+                split = split->__left;
+            }
+            else
+            {
+                break;
+            }
+        }
+        if (split == nullptr)
+        {
+            return Aggregate::identity();
         }
-        return findMin()->__data;
-    }
 
-    template <typename DATA_t, Comparison (*ComparisonFunc)(const DATA_t &, const DATA_t &)>
-    const DATA_t &Tree<DATA_t, ComparisonFunc>::getMax() const
-    {
-        if (__root == nullptr)
+        // every node >= low on the low boundary is in range together with its right subtree
+        typename Aggregate::value_type left_part = Aggregate::identity();
+        for (Node *temp = split->__left; temp != nullptr;)
         {
-            throw NoSuchElementException();
+            if (!is_less(temp->__data, low))
+            {
+                left_part = Aggregate::combine(Aggregate::combine(temp->lifted(), subtree_aggregate(temp->__right)), left_part);
+                temp = temp->__left;
+            }
+            else
+            {
+                temp = temp->__right;
+            }
+        }
+
+        // every node <= high on the high boundary is in range together with its left subtree
+        typename Aggregate::value_type right_part = Aggregate::identity();
+        for (Node *temp = split->__right; temp != nullptr;)
+        {
+            if (!is_less(high, temp->__data))
+            {
+                right_part = Aggregate::combine(right_part, Aggregate::combine(subtree_aggregate(temp->__left), temp->lifted()));
+                temp = temp->__right;
+            }
+            else
+            {
+                temp = temp->__left;
+            }
         }
-        return findMax()->__data;
+
+        return Aggregate::combine(Aggregate::combine(left_part, split->lifted()), right_part);
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    template <typename Past, typename Predicate, typename FunctionObject, typename>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::pruned_traversal(Past past, Predicate keep, FunctionObject do_something) const
+    {
+        pruned_traversal_aux(__root, past, keep, do_something);
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    typename Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::const_iterator Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::lower_bound(const DATA_t &data) const
+    {
+        return const_iterator(lower_bound_aux(data), this);
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    typename Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::const_iterator Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::upper_bound(const DATA_t &data) const
+    {
+        return const_iterator(upper_bound_aux(data), this);
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    std::pair<typename Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::const_iterator, typename Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::const_iterator>
+    Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::equal_range(const DATA_t &data) const
+    {
+        return std::make_pair(lower_bound(data), upper_bound(data));
+    }
+
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    TreeShapeReport Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::tree_shape_report() const
+    {
+        TreeShapeReport report;
+        long long depth_sum = 0;
+        report.height = shape_aux(__root, 0, report, depth_sum);
+        report.size = __size;
+        int nodes = report.left_heavy + report.balanced + report.right_heavy + report.unbalanced;
+        report.average_depth = (nodes != 0) ? double(depth_sum) / nodes : 0.0;
+        return report;
     }
 
-    template <typename DATA_t, Comparison (*ComparisonFunc)(const DATA_t &, const DATA_t &)>
-    void Tree<DATA_t, ComparisonFunc>::display()
+    template <typename DATA_t, typename Compare, template <typename> class Allocator, typename Aggregate, typename Stats, typename Duplicates>
+    void Tree<DATA_t, Compare, Allocator, Aggregate, Stats, Duplicates>::display()
     {
         std::cout << "\n";
         if (!isEmpty())
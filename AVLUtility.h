@@ -1,13 +1,24 @@
 #ifndef _AVL_UTILITY_H_
 #define _AVL_UTILITY_H_
 
+#include <type_traits>
+#include <utility>
+
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<compare>)
+#include <compare>
+#include <concepts>
+#define AVL_HAS_THREE_WAY_COMPARISON 1
+#endif
+#endif
+
 namespace avl {
     template <typename T>
     void swap(T &first, T &second)
     {
-        T temp = first;
-        first = second;
-        second = temp;
+        T temp = std::move(first);
+        first = std::move(second);
+        second = std::move(temp);
     }
 
     // assumes T has operator <
@@ -30,6 +41,137 @@ namespace avl {
         else
             return Comparison::equal;
     }
+
+    // comparators
+
+    // the trees take the comparator as a type, Compare is either
+    //  - three-way: compare(a, b) returns a Comparison (or a std::*_ordering, or an int), one call per node
+    //  - less-than (like std::less): compare(a, b) returns bool, a node that isn't less may take a second call
+    // a Compare with an is_transparent member type also compares DATA_t with other key types (see Tree::find)
+
+    inline Comparison as_comparison(Comparison result) { return result; }
+
+    // a std::*_ordering, or an int like the ones strcmp returns
+    template <typename Ordering>
+    inline auto as_comparison(Ordering result) -> decltype(result < 0, Comparison())
+    {
+        return (result < 0) ? Comparison::less : (result > 0) ? Comparison::greater : Comparison::equal;
+    }
+
+    template <typename Compare, typename Left, typename Right>
+    inline Comparison three_way_aux(const Compare &compare, const Left &left, const Right &right, bool less)
+    {
+        if (less)
+            return Comparison::less;
+        else if (compare(right, left))
+            return Comparison::greater;
+        else
+            return Comparison::equal;
+    }
+
+    template <typename Compare, typename Left, typename Right, typename Result>
+    inline Comparison three_way_aux(const Compare &, const Left &, const Right &, Result result)
+    {
+        return as_comparison(result);
+    }
+
+    // compares left with right with either kind of comparator
+    template <typename Compare, typename Left, typename Right>
+    inline Comparison three_way(const Compare &compare, const Left &left, const Right &right)
+    {
+        return three_way_aux(compare, left, right, compare(left, right));
+    }
+
+    template <typename Compare, typename Left, typename Right>
+    inline bool less_aux(const Compare &, const Left &, const Right &, bool less)
+    {
+        return less;
+    }
+
+    template <typename Compare, typename Left, typename Right, typename Result>
+    inline bool less_aux(const Compare &, const Left &, const Right &, Result result)
+    {
+        return as_comparison(result) == Comparison::less;
+    }
+
+    // returns whether left < right, with a single call to either kind of comparator
+    template <typename Compare, typename Left, typename Right>
+    inline bool less(const Compare &compare, const Left &left, const Right &right)
+    {
+        return less_aux(compare, left, right, compare(left, right));
+    }
+
+    // the default comparator, uses <=> when the type has it (C++20) and the < and > operators otherwise,
+    // ThreeWayCompare<> compares any two types that can be compared with each other (transparent)
+    template <typename T = void>
+    struct ThreeWayCompare
+    {
+        Comparison operator()(const T &left, const T &right) const { return ThreeWayCompare<>()(left, right); }
+    };
+
+    template <>
+    struct ThreeWayCompare<void>
+    {
+        typedef void is_transparent;
+
+#ifdef AVL_HAS_THREE_WAY_COMPARISON
+        template <typename Left, typename Right>
+            requires std::three_way_comparable_with<Left, Right>
+        Comparison operator()(const Left &left, const Right &right) const
+        {
+            return as_comparison(left <=> right);
+        }
+#endif
+
+        template <typename Left, typename Right>
+        Comparison operator()(const Left &left, const Right &right) const
+        {
+            if (left < right)
+                return Comparison::less;
+            else if (left > right)
+                return Comparison::greater;
+            else
+                return Comparison::equal;
+        }
+    };
+
+    // adapts a comparison function to a comparator type, for the function pointers the trees used to take:
+    // avl::Tree<char, avl::FunctionCompare<char, comp>>
+    template <typename T, Comparison (*ComparisonFunc)(const T &, const T &)>
+    struct FunctionCompare
+    {
+        Comparison operator()(const T &left, const T &right) const { return ComparisonFunc(left, right); }
+    };
+
+    // the base of the trees that holds their comparator,
+    // an empty comparator (std::less, a lambda without captures, ...) adds nothing to the tree
+#if __cplusplus >= 201402L
+    template <typename Compare, bool = std::is_empty<Compare>::value && !std::is_final<Compare>::value>
+#else
+    template <typename Compare, bool = std::is_empty<Compare>::value && !__is_final(Compare)>
+#endif
+    class CompareStorage
+    {
+    public:
+        explicit CompareStorage(const Compare &compare) : __compare(compare) {}
+
+        const Compare &comparator() const { return __compare; }
+
+    private:
+        Compare __compare;
+    };
+
+    template <typename Compare>
+    class CompareStorage<Compare, true> : private Compare
+    {
+    public:
+        explicit CompareStorage(const Compare &compare) : Compare(compare) {}
+        CompareStorage(const CompareStorage &other) : Compare(other.comparator()) {}
+        // an empty comparator has nothing to assign (and lambdas can't be assigned before C++20)
+        CompareStorage &operator=(const CompareStorage &) { return *this; }
+
+        const Compare &comparator() const { return *this; }
+    };
 };
 
 #endif // _AVL_UTILITY_H_
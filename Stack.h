@@ -1,164 +1,58 @@
 #ifndef _AVL_TREE_STACK_H_
 #define _AVL_TREE_STACK_H_
 
+#include <cassert>
+
 namespace avl
 {
-    template <typename T>
-    class Stack
+    // a stack with a fixed capacity that lives entirely inside the object (no heap allocations),
+    // meant for short-lived bookkeeping whose maximal size is known in advance (e.g. a path in a balanced tree)
+    template <typename T, int Capacity>
+    class FixedStack
     {
     public:
-        Stack();
-
-        ~Stack();
-
-        void push_back(T data);
-
-        void pop_back();
-
-        T back();
-
-        bool isEmpty();
-
-        int size() const;
-
-        T &operator[](int index);
-
-        const T &operator[](int index) const;
-
-    private:
-        struct Node
-        {
-            T __data;
-            Node *__next;
-            Node *__prev;
-
-            Node(T value, Node *nextNode = nullptr, Node *prevNode = nullptr)
-                : __data(value), __next(nextNode), __prev(prevNode) {}
-        };
-
-        Node *__top;
-        Node *__bottom;
-        int __size;
-    };
-
-    template <typename T>
-    Stack<T>::Stack() : __top(nullptr), __bottom(nullptr), __size(0) {}
-
-    template <typename T>
-    Stack<T>::~Stack()
-    {
-        while (!isEmpty())
-        {
-            pop_back();
-        }
-    }
-
-    template <typename T>
-    void Stack<T>::push_back(T data)
-    {
-        Node *newNode = new Node(data);
-
-        if (isEmpty())
-        {
-            __top = __bottom = newNode;
-        }
-        else
-        {
-            __top->__next = newNode;
-            newNode->__prev = __top;
-            __top = newNode;
-        }
-        __size++;
-    }
+        FixedStack() : __size(0) {}
 
-    template <typename T>
-    void Stack<T>::pop_back()
-    {
-        if (isEmpty())
+        void push_back(const T &data)
         {
-            throw std::runtime_error("Stack is isEmpty");
+            assert(__size < Capacity);
+            __data[__size++] = data;
         }
 
-        Node *tempNode = __top;
-        if (__top->__prev != nullptr)
+        void pop_back()
         {
-            __top = __top->__prev;
-            __top->__next = nullptr;
-        }
-        else
-        {
-            __top = __bottom = nullptr;
+            assert(__size > 0);
+            __size--;
         }
 
-        if (__top != nullptr)
-        {
-            __top->__next = nullptr;
-        }
-        else
+        T &back()
         {
-            __bottom = nullptr;
+            assert(__size > 0);
+            return __data[__size - 1];
         }
 
-        delete tempNode;
-        __size--;
-    }
-
-    template <typename T>
-    T Stack<T>::back()
-    {
-        if (isEmpty())
-        {
-            throw std::runtime_error("Stack is isEmpty");
-        }
-
-        return __top->__data;
-    }
-
-    template <typename T>
-    bool Stack<T>::isEmpty()
-    {
-        return __size == 0;
-    }
+        bool isEmpty() const { return __size == 0; }
 
-    template <typename T>
-    int Stack<T>::size() const
-    {
-        return __size;
-    }
+        int size() const { return __size; }
 
-    template <typename T>
-    T &Stack<T>::operator[](int index)
-    {
-        if (index < 0 || index >= __size)
-        {
-            throw std::out_of_range("Index out of range");
-        }
+        void clear() { __size = 0; }
 
-        Node *currentNode = __bottom;
-        for (int i = 0; i < index; i++)
+        T &operator[](int index)
         {
-            currentNode = currentNode->__next;
+            assert(index >= 0 && index < __size);
+            return __data[index];
         }
 
-        return currentNode->__data;
-    }
-
-    template <typename T>
-    const T &Stack<T>::operator[](int index) const
-    {
-        if (index < 0 || index >= __size)
+        const T &operator[](int index) const
         {
-            throw std::out_of_range("Index out of range");
+            assert(index >= 0 && index < __size);
+            return __data[index];
         }
 
-        Node *currentNode = __bottom;
-        for (int i = 0; i < index; i++)
-        {
-            currentNode = currentNode->__next;
-        }
-
-        return currentNode->__data;
-    }
+    private:
+        T __data[Capacity];
+        int __size;
+    };
 };
 
 #endif // _AVL_TREE_STACK_H_
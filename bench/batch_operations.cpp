@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "../AVLTree.h"
+
+/*
+g++ -std=c++11 -O2 -DNDEBUG -pthread bench/batch_operations.cpp -o batch_operations.exe
+./batch_operations.exe
+
+for batch sizes from 8 to 64K: lookups in a tree of 1M elements with find() per key against find_batch(),
+and 256K insertions of new keys with insert() per key against insert_batch()
+*/
+
+static const int TREE_SIZE = 1 << 20;
+static const int OPERATIONS = 1 << 18;
+
+typedef avl::Tree<int> IntTree;
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void build(IntTree &tree)
+{
+    std::vector<int> keys(TREE_SIZE);
+    for (int i = 0; i < TREE_SIZE; i++)
+    {
+        keys[i] = 2 * i; // the odd keys are left for the insertions
+    }
+    tree.assign(keys.begin(), keys.end());
+}
+
+int main()
+{
+    std::mt19937 rng(42);
+    std::vector<int> lookups(OPERATIONS), insertions(OPERATIONS);
+    for (int i = 0; i < OPERATIONS; i++)
+    {
+        lookups[i] = 2 * int(rng() % TREE_SIZE);
+        insertions[i] = 2 * int(rng() % TREE_SIZE) + 1;
+    }
+
+    IntTree tree;
+    build(tree);
+    long long checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int key : lookups)
+    {
+        checksum += tree.find(key);
+    }
+    double find_ns = elapsed_ns(start) / OPERATIONS;
+
+    IntTree one_by_one;
+    build(one_by_one);
+    start = std::chrono::steady_clock::now();
+    for (int key : insertions)
+    {
+        try
+        {
+            one_by_one.insert(key);
+        }
+        catch (const IntTree::ElementAlreadyExistsException &)
+        {
+        }
+    }
+    double insert_ns = elapsed_ns(start) / OPERATIONS;
+
+    std::printf("one key at a time    find: %8.1f ns/key   insert: %8.1f ns/key\n", find_ns, insert_ns);
+    std::printf("batch size    find_batch (ns/key)   insert_batch (ns/key)\n");
+
+    std::vector<const int *> out;
+    for (int batch = 8; batch <= (1 << 16); batch *= 2)
+    {
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < OPERATIONS; i += batch)
+        {
+            tree.find_batch(lookups.data() + i, batch, (out.resize(batch), out.data()));
+            checksum += *out[0];
+        }
+        double find_batch_ns = elapsed_ns(start) / OPERATIONS;
+
+        IntTree batched;
+        build(batched);
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < OPERATIONS; i += batch)
+        {
+            batched.insert_batch(insertions.begin() + i, insertions.begin() + i + batch);
+        }
+        double insert_batch_ns = elapsed_ns(start) / OPERATIONS;
+
+        std::printf("%10d  %20.1f  %22.1f\n", batch, find_batch_ns, insert_batch_ns);
+    }
+    return (checksum == 1) ? 1 : 0;
+}
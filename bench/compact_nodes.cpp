@@ -0,0 +1,75 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "../AVLTree.h"
+#include "../AVLCompactTree.h"
+
+/*
+g++ -std=c++11 -O2 -DNDEBUG -pthread bench/compact_nodes.cpp -o compact_nodes.exe
+./compact_nodes.exe
+
+compares the node layout of avl::Tree with the one of avl::CompactTree: bytes per node for a few
+key types, and the throughput of random (successful) lookups of 8 byte keys
+*/
+
+template <typename Key>
+static void report_size(const char *name)
+{
+    std::printf("%-10s Tree: %3zu bytes/node   CompactTree: %3zu bytes/node\n", name,
+                sizeof(typename avl::Tree<Key>::Node), avl::CompactTree<Key>::node_size());
+}
+
+template <typename TreeType>
+static double lookups_per_second(const TreeType &tree, const std::vector<std::uint64_t> &queries)
+{
+    std::uint64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (std::uint64_t key : queries)
+    {
+        checksum += tree.find(key);
+    }
+    auto end = std::chrono::steady_clock::now();
+    if (checksum == 1)
+    {
+        std::printf(" ");
+    }
+    return queries.size() / std::chrono::duration<double>(end - start).count();
+}
+
+static void report_lookups(int n)
+{
+    std::mt19937_64 rng(42);
+    std::vector<std::uint64_t> keys(n);
+    for (int i = 0; i < n; i++)
+    {
+        keys[i] = rng();
+    }
+
+    avl::Tree<std::uint64_t> tree;
+    avl::CompactTree<std::uint64_t> compact;
+    for (std::uint64_t key : keys)
+    {
+        tree.insert(key);
+        compact.insert(key);
+    }
+
+    std::vector<std::uint64_t> queries(keys);
+    std::shuffle(queries.begin(), queries.end(), rng);
+
+    std::printf("%10d uint64 keys   Tree: %6.2f M lookups/s   CompactTree: %6.2f M lookups/s (%.1f bytes/element)\n", n,
+                lookups_per_second(tree, queries) / 1e6, lookups_per_second(compact, queries) / 1e6,
+                double(compact.memory_usage()) / n);
+}
+
+int main()
+{
+    report_size<char>("char");
+    report_size<std::uint32_t>("uint32");
+    report_size<std::uint64_t>("uint64");
+    report_lookups(1000000);
+    report_lookups(10000000);
+    return 0;
+}
@@ -0,0 +1,559 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <new>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define BENCH_FORK 1
+#endif
+
+#include "../AVLTree.h"
+#include "../AVLMap.h"
+
+/*
+cmake --build <build dir> --target bench        (runs this with AVL_BENCH_ARGS, see CMakeLists.txt)
+g++ -std=c++11 -O2 -DNDEBUG -pthread bench/compare_std.cpp -o compare_std.exe
+./compare_std.exe [--sizes 1000,10000,100000,1000000] [--json results.jsonl] [--baseline old.jsonl] [--threshold 1.10]
+
+avl::Tree against std::set and avl::Map against std::map (64 bit keys and values) for
+- insert, find, remove and traversal on uniform (random distinct keys), sequential, reverse and zipfian (s = 0.99,
+  with repeated keys) key streams of n keys
+- mixed: on n uniform keys, n operations of which half are lookups and a quarter each inserts and removals
+  (of keys from twice the range, so about half of them hit)
+reporting ns per operation, allocations per operation and the peak RSS. every measurement runs in a process of its
+own (on POSIX systems) so the peak RSS is its own, small sizes are repeated until about 2^20 operations were timed.
+--json writes one JSON object per measurement and line, --baseline compares against such a file and exits with 1
+if some measurement got slower than threshold times its baseline (for catching regressions)
+*/
+
+typedef std::uint64_t Key;
+
+// every allocation in the process goes through here, so the containers are counted whatever allocator they use
+static unsigned long long allocations = 0;
+
+void *operator new(std::size_t size)
+{
+    allocations++;
+    void *memory = std::malloc(size == 0 ? 1 : size);
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+// the containers under test behind one interface
+struct AvlSet
+{
+    static const char *name() { return "avl::Tree"; }
+    avl::Tree<Key> __set;
+    bool insert(Key key) { return __set.try_insert(key); }
+    bool find(Key key) const { return __set.contains(key); }
+    bool erase(Key key) { return __set.try_erase(key); }
+    Key traverse()
+    {
+        Key sum = 0;
+        __set.in_order_traversal([&](const Key &key) { sum += key; });
+        return sum;
+    }
+};
+
+struct StdSet
+{
+    static const char *name() { return "std::set"; }
+    std::set<Key> __set;
+    bool insert(Key key) { return __set.insert(key).second; }
+    bool find(Key key) const { return __set.find(key) != __set.end(); }
+    bool erase(Key key) { return __set.erase(key) != 0; }
+    Key traverse() const
+    {
+        Key sum = 0;
+        for (Key key : __set)
+        {
+            sum += key;
+        }
+        return sum;
+    }
+};
+
+struct AvlMap
+{
+    static const char *name() { return "avl::Map"; }
+    avl::Map<Key, Key> __map;
+    bool insert(Key key) { return __map.try_emplace(key, key); }
+    bool find(Key key) const { return __map.try_find(key) != nullptr; }
+    bool erase(Key key) { return __map.try_erase(key); }
+    Key traverse()
+    {
+        Key sum = 0;
+        __map.in_order_traversal([&](const Key &, Key &value) { sum += value; });
+        return sum;
+    }
+};
+
+struct StdMap
+{
+    static const char *name() { return "std::map"; }
+    std::map<Key, Key> __map;
+    bool insert(Key key) { return __map.emplace(key, key).second; }
+    bool find(Key key) const { return __map.find(key) != __map.end(); }
+    bool erase(Key key) { return __map.erase(key) != 0; }
+    Key traverse() const
+    {
+        Key sum = 0;
+        for (const std::pair<const Key, Key> &entry : __map)
+        {
+            sum += entry.second;
+        }
+        return sum;
+    }
+};
+
+// a bijection on 64 bit numbers that scatters consecutive ranks over the whole range
+static Key scramble(Key x)
+{
+    x ^= x >> 31;
+    x *= 0x7fb5d329728ea185ull;
+    x ^= x >> 27;
+    x *= 0x81dadef4bc2dd44dull;
+    return x ^ (x >> 33);
+}
+
+// ranks in [1, n] with P(k) proportional to 1 / k^s, by rejection-inversion (Hoermann and Derflinger) in O(1)
+// memory and expected time per sample
+class Zipf
+{
+public:
+    Zipf(double n, double s) : __n(n), __s(s)
+    {
+        __h_x1 = h_integral(1.5) - 1.0;
+        __h_n = h_integral(n + 0.5);
+        __cut = 2.0 - h_integral_inverse(h_integral(2.5) - h(2.0));
+    }
+
+    template <typename Random>
+    Key operator()(Random &random)
+    {
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        while (true)
+        {
+            double u = __h_n + uniform(random) * (__h_x1 - __h_n);
+            double x = h_integral_inverse(u);
+            double k = std::floor(x + 0.5);
+            k = (k < 1.0) ? 1.0 : (k > __n ? __n : k);
+            if (k - x <= __cut || u >= h_integral(k + 0.5) - h(k))
+            {
+                return Key(k);
+            }
+        }
+    }
+
+private:
+    double __n, __s, __h_x1, __h_n, __cut;
+
+    double h(double x) const { return std::exp(-__s * std::log(x)); }
+
+    double h_integral(double x) const
+    {
+        double log_x = std::log(x);
+        return helper2((1.0 - __s) * log_x) * log_x;
+    }
+
+    double h_integral_inverse(double x) const
+    {
+        double t = x * (1.0 - __s);
+        return std::exp(helper1(t < -1.0 ? -1.0 : t) * x);
+    }
+
+    static double helper1(double x) { return std::fabs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x)); }
+    static double helper2(double x) { return std::fabs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x)); }
+};
+
+static const char *const WORKLOADS[] = {"uniform", "sequential", "reverse", "zipf"};
+static const char *const OPERATIONS[] = {"insert", "find", "remove", "traversal"};
+
+// the n keys that are inserted, and the n keys that are looked up, for a workload
+static void make_keys(const std::string &workload, long n, std::vector<Key> &inserted, std::vector<Key> &looked_up)
+{
+    std::mt19937_64 random(42);
+    inserted.resize(n);
+    looked_up.resize(n);
+    if (workload == "zipf")
+    {
+        Zipf zipf(double(n), 0.99);
+        for (long i = 0; i < n; i++)
+        {
+            inserted[i] = scramble(zipf(random));
+            looked_up[i] = scramble(zipf(random));
+        }
+        return;
+    }
+    for (long i = 0; i < n; i++)
+    {
+        if (workload == "uniform")
+        {
+            inserted[i] = scramble(Key(i));
+            looked_up[i] = scramble(random() % Key(n));
+        }
+        else
+        {
+            inserted[i] = (workload == "sequential") ? Key(i) : Key(n - 1 - i);
+            looked_up[i] = inserted[i];
+        }
+    }
+}
+
+struct Result
+{
+    double __ns_per_op;
+    double __allocs_per_op;
+    long __peak_rss_kb;
+};
+
+static long peak_rss_kb()
+{
+#ifdef BENCH_FORK
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return long(usage.ru_maxrss / 1024);
+#else
+    return long(usage.ru_maxrss);
+#endif
+#else
+    return 0;
+#endif
+}
+
+static Key sink = 0; // keeps the results of the timed loops alive
+
+// runs prepare() untimed and operation() timed, in rounds until about 2^20 operations of n were timed
+template <typename Prepare, typename Operation>
+static Result measure(long n, Prepare prepare, Operation operation)
+{
+    long rounds = std::max(1L, (1L << 20) / std::max(1L, n));
+    double ns = 0;
+    unsigned long long allocated = 0;
+    for (long round = 0; round < rounds; round++)
+    {
+        prepare();
+        unsigned long long before = allocations;
+        auto start = std::chrono::steady_clock::now();
+        operation();
+        auto end = std::chrono::steady_clock::now();
+        allocated += allocations - before;
+        ns += std::chrono::duration<double, std::nano>(end - start).count();
+    }
+    double ops = double(rounds) * double(n);
+    return Result{ns / ops, double(allocated) / ops, peak_rss_kb()};
+}
+
+template <typename Container>
+static Result run(const std::string &workload, const std::string &operation, long n)
+{
+    std::vector<Key> inserted, looked_up;
+    make_keys(workload == "mixed" ? "uniform" : workload, n, inserted, looked_up);
+    Container *container = nullptr;
+    auto fill = [&]() {
+        delete container;
+        container = new Container();
+        for (Key key : inserted)
+        {
+            container->insert(key);
+        }
+    };
+    Result result;
+    if (operation == "insert")
+    {
+        result = measure(
+            n, [&]() { delete container; container = new Container(); },
+            [&]() {
+                for (Key key : inserted)
+                {
+                    sink += container->insert(key);
+                }
+            });
+    }
+    else if (operation == "find")
+    {
+        fill();
+        result = measure(
+            n, []() {},
+            [&]() {
+                for (Key key : looked_up)
+                {
+                    sink += container->find(key);
+                }
+            });
+    }
+    else if (operation == "remove")
+    {
+        result = measure(n, fill, [&]() {
+            for (Key key : inserted)
+            {
+                sink += container->erase(key);
+            }
+        });
+    }
+    else if (operation == "traversal")
+    {
+        fill();
+        result = measure(n, []() {}, [&]() { sink += container->traverse(); });
+    }
+    else // mixed
+    {
+        std::vector<Key> choices(n);
+        std::mt19937_64 random(7);
+        for (long i = 0; i < n; i++)
+        {
+            choices[i] = random();
+        }
+        result = measure(n, fill, [&]() {
+            for (long i = 0; i < n; i++)
+            {
+                Key key = scramble(choices[i] % Key(2 * n));
+                switch (choices[i] >> 62)
+                {
+                case 0:
+                    sink += container->insert(key);
+                    break;
+                case 1:
+                    sink += container->erase(key);
+                    break;
+                default:
+                    sink += container->find(key);
+                }
+            }
+        });
+    }
+    delete container;
+    return result;
+}
+
+static Result run(const std::string &container, const std::string &workload, const std::string &operation, long n)
+{
+    if (container == AvlSet::name())
+    {
+        return run<AvlSet>(workload, operation, n);
+    }
+    if (container == StdSet::name())
+    {
+        return run<StdSet>(workload, operation, n);
+    }
+    if (container == AvlMap::name())
+    {
+        return run<AvlMap>(workload, operation, n);
+    }
+    return run<StdMap>(workload, operation, n);
+}
+
+// runs the measurement in a child process (if possible) so the peak RSS and the heap are its own
+static bool run_isolated(const std::string &container, const std::string &workload, const std::string &operation, long n, Result &result)
+{
+#ifdef BENCH_FORK
+    std::fflush(stdout);
+    int pipe_ends[2];
+    if (pipe(pipe_ends) != 0)
+    {
+        return false;
+    }
+    pid_t child = fork();
+    if (child == 0)
+    {
+        close(pipe_ends[0]);
+        Result measured = run(container, workload, operation, n);
+        bool written = write(pipe_ends[1], &measured, sizeof(measured)) == ssize_t(sizeof(measured));
+        _exit((written && sink != 1) ? 0 : 1);
+    }
+    close(pipe_ends[1]);
+    bool received = child > 0 && read(pipe_ends[0], &result, sizeof(result)) == ssize_t(sizeof(result));
+    close(pipe_ends[0]);
+    if (child > 0)
+    {
+        waitpid(child, nullptr, 0);
+    }
+    return received;
+#else
+    result = run(container, workload, operation, n);
+    return true;
+#endif
+}
+
+struct Baseline
+{
+    std::string __key;
+    double __ns_per_op;
+};
+
+static std::string baseline_key(const std::string &container, const std::string &workload, const std::string &operation, long n)
+{
+    return container + "/" + workload + "/" + operation + "/" + std::to_string(n);
+}
+
+// reads the lines written by --json
+static std::vector<Baseline> read_baseline(const char *path)
+{
+    std::vector<Baseline> baseline;
+    FILE *file = std::fopen(path, "r");
+    if (file == nullptr)
+    {
+        std::fprintf(stderr, "can't open %s\n", path);
+        std::exit(2);
+    }
+    char container[64], workload[64], operation[64];
+    long n;
+    double ns;
+    char line[512];
+    while (std::fgets(line, sizeof(line), file) != nullptr)
+    {
+        if (std::sscanf(line, "{\"container\":\"%63[^\"]\",\"workload\":\"%63[^\"]\",\"operation\":\"%63[^\"]\",\"size\":%ld,\"ns_per_op\":%lf",
+                        container, workload, operation, &n, &ns) == 5)
+        {
+            baseline.push_back(Baseline{baseline_key(container, workload, operation, n), ns});
+        }
+    }
+    std::fclose(file);
+    return baseline;
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<long> sizes = {1000, 10000, 100000, 1000000};
+    const char *json_path = nullptr;
+    const char *baseline_path = nullptr;
+    double threshold = 1.10;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (std::strcmp(argv[i], "--sizes") == 0)
+        {
+            sizes.clear();
+            for (char *size = std::strtok(argv[i + 1], ","); size != nullptr; size = std::strtok(nullptr, ","))
+            {
+                sizes.push_back(std::atol(size));
+            }
+        }
+        else if (std::strcmp(argv[i], "--json") == 0)
+        {
+            json_path = argv[i + 1];
+        }
+        else if (std::strcmp(argv[i], "--baseline") == 0)
+        {
+            baseline_path = argv[i + 1];
+        }
+        else if (std::strcmp(argv[i], "--threshold") == 0)
+        {
+            threshold = std::atof(argv[i + 1]);
+        }
+        else
+        {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    std::vector<Baseline> baseline;
+    if (baseline_path != nullptr)
+    {
+        baseline = read_baseline(baseline_path);
+    }
+    FILE *json = (json_path != nullptr) ? std::fopen(json_path, "w") : nullptr;
+    if (json_path != nullptr && json == nullptr)
+    {
+        std::fprintf(stderr, "can't write %s\n", json_path);
+        return 2;
+    }
+
+    // (workload, operation) pairs, mixed is a workload and an operation of its own
+    std::vector<std::pair<std::string, std::string>> cases;
+    for (const char *workload : WORKLOADS)
+    {
+        for (const char *operation : OPERATIONS)
+        {
+            cases.push_back(std::make_pair(workload, operation));
+        }
+    }
+    cases.push_back(std::make_pair("mixed", "mixed"));
+    const char *const pairs[][2] = {{AvlSet::name(), StdSet::name()}, {AvlMap::name(), StdMap::name()}};
+
+    int regressions = 0;
+    std::printf("%-10s %-10s %-9s %10s | %-9s %9s %9s %9s | %-9s %9s %9s %9s\n", "workload", "operation", "", "n",
+                "", "ns/op", "allocs/op", "RSS MB", "", "ns/op", "allocs/op", "RSS MB");
+    for (long n : sizes)
+    {
+        for (const auto &pair : pairs)
+        {
+            for (const auto &c : cases)
+            {
+                Result results[2];
+                for (int i = 0; i < 2; i++)
+                {
+                    if (!run_isolated(pair[i], c.first, c.second, n, results[i]))
+                    {
+                        std::fprintf(stderr, "%s %s %s %ld failed\n", pair[i], c.first.c_str(), c.second.c_str(), n);
+                        return 2;
+                    }
+                    if (json != nullptr)
+                    {
+                        std::fprintf(json, "{\"container\":\"%s\",\"workload\":\"%s\",\"operation\":\"%s\",\"size\":%ld,"
+                                           "\"ns_per_op\":%.3f,\"allocs_per_op\":%.4f,\"peak_rss_kb\":%ld}\n",
+                                     pair[i], c.first.c_str(), c.second.c_str(), n, results[i].__ns_per_op,
+                                     results[i].__allocs_per_op, results[i].__peak_rss_kb);
+                    }
+                    std::string key = baseline_key(pair[i], c.first, c.second, n);
+                    for (const Baseline &old : baseline)
+                    {
+                        if (old.__key == key && results[i].__ns_per_op > threshold * old.__ns_per_op)
+                        {
+                            std::printf("REGRESSION %s: %.1f ns/op, was %.1f\n", key.c_str(), results[i].__ns_per_op, old.__ns_per_op);
+                            regressions++;
+                        }
+                    }
+                }
+                std::printf("%-10s %-10s %-9s %10ld | %-9s %9.1f %9.3f %9.1f | %-9s %9.1f %9.3f %9.1f\n", c.first.c_str(),
+                            c.second.c_str(), "", n, pair[0], results[0].__ns_per_op, results[0].__allocs_per_op,
+                            results[0].__peak_rss_kb / 1024.0, pair[1], results[1].__ns_per_op, results[1].__allocs_per_op,
+                            results[1].__peak_rss_kb / 1024.0);
+            }
+        }
+    }
+    if (json != nullptr)
+    {
+        std::fclose(json);
+    }
+    return (regressions > 0) ? 1 : 0;
+}
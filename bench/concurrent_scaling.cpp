@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../AVLConcurrentTree.h"
+#include "../AVLShardedTree.h"
+
+/*
+g++ -std=c++11 -O2 -DNDEBUG -pthread bench/concurrent_scaling.cpp -o concurrent_scaling.exe
+./concurrent_scaling.exe [max threads]
+
+measures the throughput (million operations per second, all threads together) of random lookups, inserts and
+removes on 1, 2, 4... threads up to every core, for an avl::ConcurrentTree, an avl::ShardedTree of 16 shards and
+one avl::Tree behind a single reader-writer lock, with 100%, 90% and 50% lookups (the writes are half inserts,
+half removes). the sets start with half of the KEY_RANGE keys, inserted in random order
+*/
+
+typedef std::chrono::steady_clock Clock;
+
+static const int KEY_RANGE = 1000000;
+static const int SHARDS = 16;
+static const double SECONDS = 0.5;
+
+// what the lookups found, so that the compiler can't drop them
+static std::atomic<long long> sink(0);
+
+struct LockedTree
+{
+    avl::Tree<int> tree;
+    mutable avl::SharedMutex lock;
+
+    bool contains(int key) const
+    {
+        avl::SharedLockGuard<avl::SharedMutex> guard(lock);
+        return tree.contains(key);
+    }
+    bool try_insert(int key)
+    {
+        std::lock_guard<avl::SharedMutex> guard(lock);
+        return tree.try_insert(key);
+    }
+    bool try_erase(int key)
+    {
+        std::lock_guard<avl::SharedMutex> guard(lock);
+        return tree.try_erase(key);
+    }
+};
+
+template <typename Set>
+static void fill(Set &set)
+{
+    std::vector<int> keys;
+    for (int key = 0; key < KEY_RANGE; key += 2)
+    {
+        keys.push_back(key);
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+    for (int key : keys)
+    {
+        set.try_insert(key);
+    }
+}
+
+// runs the workload on `threads` threads for SECONDS and returns the million operations per second
+template <typename Set>
+static double run(Set &set, int threads, int lookup_percent)
+{
+    std::atomic<bool> start(false), stop(false);
+    std::atomic<long long> total(0);
+    std::vector<std::thread> workers;
+    for (int id = 0; id < threads; id++)
+    {
+        workers.emplace_back([&, id]() {
+            std::mt19937 rng(id + 1);
+            long long ops = 0, found = 0;
+            while (!start.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                for (int i = 0; i < 64; i++, ops++)
+                {
+                    int key = int(rng() % KEY_RANGE), kind = int(rng() % 100);
+                    if (kind < lookup_percent)
+                        found += set.contains(key);
+                    else if (kind % 2 == 0)
+                        found += set.try_insert(key);
+                    else
+                        found += set.try_erase(key);
+                }
+            }
+            total.fetch_add(ops);
+            sink.fetch_add(found, std::memory_order_relaxed);
+        });
+    }
+    auto begin = Clock::now();
+    start.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::duration<double>(SECONDS));
+    stop.store(true);
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    return total.load() / std::chrono::duration<double, std::micro>(Clock::now() - begin).count();
+}
+
+int main(int argc, char *argv[])
+{
+    int max_threads = (argc > 1) ? std::atoi(argv[1]) : avl::hardware_threads();
+
+    avl::ConcurrentTree<int> concurrent;
+    avl::ShardedTree<int> sharded(SHARDS);
+    LockedTree locked;
+    fill(concurrent);
+    fill(sharded);
+    fill(locked);
+
+    std::vector<int> thread_counts;
+    for (int threads = 1; threads < max_threads; threads *= 2)
+    {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+
+    for (int lookup_percent : {100, 90, 50})
+    {
+        std::printf("\n%3d%% lookups     %12s %12s %12s\n", lookup_percent, "concurrent", "sharded", "single lock");
+        for (int threads : thread_counts)
+        {
+            double concurrent_mops = run(concurrent, threads, lookup_percent);
+            double sharded_mops = run(sharded, threads, lookup_percent);
+            double locked_mops = run(locked, threads, lookup_percent);
+            std::printf("%3d threads      %6.2f Mop/s %6.2f Mop/s %6.2f Mop/s\n", threads, concurrent_mops, sharded_mops, locked_mops);
+        }
+    }
+
+    avl::TreeShapeReport report = concurrent.tree_shape_report();
+    std::printf("\nthe concurrent tree afterwards: %d elements, height %d\n", report.size, report.height);
+    return 0;
+}
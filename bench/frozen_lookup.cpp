@@ -0,0 +1,66 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "../AVLTree.h"
+
+/*
+g++ -std=c++11 -O2 -march=native -DNDEBUG -pthread bench/frozen_lookup.cpp -o frozen_lookup.exe
+./frozen_lookup.exe
+
+random (successful) lookups in a tree against lookups in its frozen copy (Tree::freeze()),
+for int keys (SIMD blocks) and for int keys with a custom comparison (Eytzinger layout)
+*/
+
+avl::Comparison compare_ints(const int &a, const int &b)
+{
+    return (a < b) ? avl::Comparison::less : ((b < a) ? avl::Comparison::greater : avl::Comparison::equal);
+}
+
+template <typename Searchable>
+static double ns_per_lookup(const Searchable &searchable, const std::vector<int> &queries)
+{
+    long long checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int key : queries)
+    {
+        checksum += searchable.find(key);
+    }
+    auto end = std::chrono::steady_clock::now();
+    if (checksum == 1)
+    {
+        std::printf(" ");
+    }
+    return std::chrono::duration<double, std::nano>(end - start).count() / queries.size();
+}
+
+template <typename Compare>
+static void run(const char *name, int n)
+{
+    std::mt19937 rng(42);
+    std::vector<int> keys(n);
+    for (int i = 0; i < n; i++)
+    {
+        keys[i] = 2 * i;
+    }
+    avl::Tree<int, Compare> tree(keys.begin(), keys.end());
+    auto frozen = tree.freeze();
+
+    std::vector<int> queries(keys);
+    std::shuffle(queries.begin(), queries.end(), rng);
+
+    std::printf("%-20s %10d keys   Tree: %7.1f ns/lookup   FrozenTree: %7.1f ns/lookup\n", name, n,
+                ns_per_lookup(tree, queries), ns_per_lookup(frozen, queries));
+}
+
+int main()
+{
+    for (int n : {1000, 1000000, 10000000})
+    {
+        run<avl::ThreeWayCompare<int>>("int (blocks)", n);
+        run<avl::FunctionCompare<int, compare_ints>>("int (eytzinger)", n);
+    }
+    return 0;
+}
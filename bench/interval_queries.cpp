@@ -0,0 +1,61 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include "../AVLIntervalTree.h"
+
+/*
+g++ -std=c++11 -O2 -DNDEBUG bench/interval_queries.cpp -o interval_queries.exe
+./interval_queries.exe [intervals, default 1000000]
+
+times stabbing queries and overlap queries on n time intervals (random starts, lengths up to 1000 with a few
+long ones), with avl::IntervalTree and with a full in_order_traversal of the intervals
+*/
+
+typedef std::chrono::steady_clock Clock;
+
+static const long TIME_RANGE = 100000000;
+
+int main(int argc, char *argv[])
+{
+    long n = (argc > 1) ? std::atol(argv[1]) : 1000000;
+    std::mt19937 rng(1);
+    avl::IntervalTree<long> tree;
+    while (tree.size() < n)
+    {
+        long start = long(rng() % TIME_RANGE);
+        long length = (rng() % 100 == 0) ? long(rng() % 1000000) : long(rng() % 1000);
+        tree.try_insert(start, start + length);
+    }
+
+    const int QUERIES = 10000;
+    for (long width : {0L, 10000L})
+    {
+        long found = 0;
+        auto begin = Clock::now();
+        for (int i = 0; i < QUERIES; i++)
+        {
+            long low = long(rng() % TIME_RANGE);
+            tree.find_overlapping(low, low + width, [&](const avl::Interval<long> &) {
+                found++;
+                return true;
+            });
+        }
+        double tree_us = std::chrono::duration<double, std::micro>(Clock::now() - begin).count() / QUERIES;
+
+        // the scans are much slower, a few of them are enough
+        const int SCANS = 10;
+        long scanned = 0;
+        begin = Clock::now();
+        for (int i = 0; i < SCANS; i++)
+        {
+            long low = long(rng() % TIME_RANGE), high = low + width;
+            tree.in_order_traversal([&](const avl::Interval<long> &interval) { scanned += interval.overlaps(low, high); });
+        }
+        double scan_us = std::chrono::duration<double, std::micro>(Clock::now() - begin).count() / SCANS;
+
+        std::printf("n = %ld, %s of width %ld: %.2f us per query (%.1f intervals found on average), full scan %.0f us (%ld)\n",
+                    n, width == 0 ? "stabbing queries" : "overlap queries", width, tree_us, double(found) / QUERIES, scan_us, scanned);
+    }
+    return 0;
+}
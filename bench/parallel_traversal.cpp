@@ -0,0 +1,72 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "../AVLTree.h"
+
+/*
+g++ -std=c++11 -O2 -DNDEBUG -pthread bench/parallel_traversal.cpp -o parallel_traversal.exe
+./parallel_traversal.exe [elements, default 10000000]
+
+times a checksum over every element of a tree of n elements with in_order_traversal and with
+parallel_reduce, parallel_for_each and parallel_for_each_ordered on 1, 2, 4, ... threads up to the
+number of hardware threads
+*/
+
+typedef avl::Tree<long> LongTree;
+
+// some work per element so the scan isn't bound by memory alone
+static unsigned long mix(long key)
+{
+    unsigned long x = (unsigned long)key * 0x9e3779b97f4a7c15ul;
+    x ^= x >> 29;
+    x *= 0xbf58476d1ce4e5b9ul;
+    return x ^ (x >> 32);
+}
+
+template <typename Operation>
+static double time_ms(Operation operation)
+{
+    auto start = std::chrono::steady_clock::now();
+    operation();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+    long n = (argc > 1) ? std::atol(argv[1]) : 10000000;
+    std::vector<long> keys(n);
+    for (long i = 0; i < n; i++)
+    {
+        keys[i] = 2 * i;
+    }
+    LongTree tree(keys.begin(), keys.end());
+
+    unsigned long expected = 0;
+    double sequential = time_ms([&]() { tree.in_order_traversal([&](long key) { expected += mix(key); }); });
+    std::printf("n = %ld, in_order_traversal: %.1f ms\n", n, sequential);
+    std::printf("threads      reduce    for_each     ordered   (ms)\n");
+
+    for (int threads = 1; threads <= avl::hardware_threads(); threads *= 2)
+    {
+        auto map = [](long key) { return mix(key); };
+        unsigned long reduced = 0, ordered = 0;
+        std::atomic<unsigned long> summed(0);
+        double reduce = time_ms([&]() {
+            reduced = tree.parallel_reduce(0ul, map, [](unsigned long a, unsigned long b) { return a + b; }, threads);
+        });
+        double for_each = time_ms([&]() { tree.parallel_for_each([&](long key) { summed += mix(key); }, threads); });
+        double in_order = time_ms([&]() {
+            tree.parallel_for_each_ordered(map, [&](unsigned long value) { ordered += value; }, threads);
+        });
+        if (reduced != expected || summed != expected || ordered != expected)
+        {
+            std::printf("wrong checksum\n");
+            return 1;
+        }
+        std::printf("%7d  %10.1f  %10.1f  %10.1f\n", threads, reduce, for_each, in_order);
+    }
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+#include "../AVLTree.h"
+
+/*
+g++ -std=c++11 -O2 -DNDEBUG bench/path_tracking.cpp -o path_tracking.exe
+./path_tracking.exe
+
+measures the cost of insert and remove (ns/op) together with the number of heap allocations
+each operation performs, for 1M and 10M random (shuffled) keys
+*/
+
+static long long allocations = 0;
+
+void *operator new(std::size_t size)
+{
+    allocations++;
+    void *p = std::malloc(size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+static void run(int n)
+{
+    std::vector<int> keys(n);
+    for (int i = 0; i < n; i++)
+    {
+        keys[i] = i;
+    }
+    std::mt19937 rng(42);
+    std::shuffle(keys.begin(), keys.end(), rng);
+
+    avl::Tree<int> tree;
+
+    long long before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++)
+    {
+        tree.insert(keys[i]);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double insert_ns = std::chrono::duration<double, std::nano>(end - start).count() / n;
+    double insert_allocs = double(allocations - before) / n;
+
+    std::shuffle(keys.begin(), keys.end(), rng);
+
+    before = allocations;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++)
+    {
+        tree.remove(keys[i]);
+    }
+    end = std::chrono::steady_clock::now();
+    double remove_ns = std::chrono::duration<double, std::nano>(end - start).count() / n;
+    double remove_allocs = double(allocations - before) / n;
+
+    std::printf("%10d  insert: %8.1f ns/op %6.2f allocs/op   remove: %8.1f ns/op %6.2f allocs/op\n",
+                n, insert_ns, insert_allocs, remove_ns, remove_allocs);
+}
+
+int main()
+{
+    run(1000000);
+    run(10000000);
+    return 0;
+}
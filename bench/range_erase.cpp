@@ -0,0 +1,62 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "../AVLTree.h"
+
+/*
+g++ -std=c++11 -O2 -DNDEBUG bench/range_erase.cpp -o range_erase.exe
+./range_erase.exe [elements, default 4000000]
+
+times expiring the smaller half of the keys of a tree of n elements (everything below a watermark), with one
+remove() per key, with erase_range() and with extract_range() (which keeps the expired part as a tree of its own),
+then cutting a window of a thousand keys out of the middle
+*/
+
+typedef avl::Tree<long> LongTree;
+typedef std::chrono::steady_clock Clock;
+
+static void build(LongTree &tree, long n)
+{
+    std::vector<long> keys(n);
+    for (long i = 0; i < n; i++)
+    {
+        keys[i] = i;
+    }
+    tree.assign(keys.begin(), keys.end());
+}
+
+template <typename Operation>
+static double time_ms(long n, Operation operation)
+{
+    LongTree tree;
+    build(tree, n);
+    auto start = Clock::now();
+    operation(tree);
+    auto end = Clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+    long n = (argc > 1) ? std::atol(argv[1]) : 4000000;
+    long watermark = n / 2;
+
+    double one_by_one = time_ms(n, [=](LongTree &tree) {
+        for (long key = 0; key < watermark; key++)
+        {
+            tree.remove(key);
+        }
+    });
+    double erase = time_ms(n, [=](LongTree &tree) { tree.erase_range(0, watermark - 1); });
+    double extract = time_ms(n, [=](LongTree &tree) {
+        LongTree expired = tree.extract_range(0, watermark - 1);
+        std::printf("%d elements extracted, %d left\n", expired.size(), tree.size());
+    });
+    std::printf("n = %ld, expiring %ld keys: remove() %.1f ms, erase_range() %.1f ms, extract_range() %.3f ms\n",
+                n, watermark, one_by_one, erase, extract);
+
+    double window = time_ms(n, [=](LongTree &tree) { tree.erase_range(watermark, watermark + 999); });
+    std::printf("erase_range() of 1000 keys in the middle: %.3f ms\n", window);
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "../AVLTree.h"
+
+/*
+g++ -std=c++11 -O2 -DNDEBUG bench/relaxed_balance.cpp -o relaxed_balance.exe
+./relaxed_balance.exe
+
+measures the cost (ns/op) of bursts of inserts and removes with strict balancing and in relaxed balance mode,
+where the time of the rebalance() after every burst is included. for sorted and random (shuffled) keys,
+followed by the cost of random lookups in the result
+*/
+
+typedef std::chrono::steady_clock Clock;
+
+static double ns_since(Clock::time_point start, long long ops)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ops;
+}
+
+static void run(const char *name, const std::vector<int> &keys, int bursts, bool relaxed)
+{
+    int n = int(keys.size());
+    avl::Tree<int> tree;
+    tree.relax_balance(relaxed);
+
+    auto start = Clock::now();
+    for (int burst = 0; burst < bursts; burst++)
+    {
+        for (int i = burst * (n / bursts); i < (burst + 1) * (n / bursts); i++)
+        {
+            tree.insert(keys[i]);
+        }
+        tree.rebalance();
+    }
+    double insert_ns = ns_since(start, n);
+
+    std::mt19937 rng(7);
+    std::vector<int> lookups(keys);
+    std::shuffle(lookups.begin(), lookups.end(), rng);
+    start = Clock::now();
+    long long found = 0;
+    for (int i = 0; i < n; i++)
+    {
+        found += tree.contains(lookups[i]);
+    }
+    double find_ns = ns_since(start, n);
+
+    start = Clock::now();
+    for (int burst = 0; burst < bursts; burst++)
+    {
+        for (int i = burst * (n / bursts); i < (burst + 1) * (n / bursts); i++)
+        {
+            tree.remove(lookups[i]);
+        }
+        tree.rebalance();
+    }
+    double remove_ns = ns_since(start, n);
+
+    std::printf("%10d %-8s %-8s insert: %7.1f ns/op   find: %7.1f ns/op   remove: %7.1f ns/op%s\n",
+                n, name, relaxed ? "relaxed" : "strict", insert_ns, find_ns, remove_ns, found == n ? "" : "  (lookup error)");
+}
+
+int main()
+{
+    for (int n : {100000, 1000000, 4000000})
+    {
+        std::vector<int> keys(n);
+        for (int i = 0; i < n; i++)
+        {
+            keys[i] = i;
+        }
+        for (bool relaxed : {false, true})
+        {
+            run("sorted", keys, 10, relaxed);
+        }
+        std::mt19937 rng(42);
+        std::shuffle(keys.begin(), keys.end(), rng);
+        for (bool relaxed : {false, true})
+        {
+            run("random", keys, 10, relaxed);
+        }
+    }
+    return 0;
+}
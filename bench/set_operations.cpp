@@ -0,0 +1,70 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "../AVLTree.h"
+
+/*
+g++ -std=c++11 -O2 -DNDEBUG -pthread bench/set_operations.cpp -o set_operations.exe
+./set_operations.exe [elements per tree, default 10000000]
+
+times the join-based set operations on two trees of n elements each (the multiples of 2 and the
+multiples of 3 below 3n), on 1, 2, 4, ... threads up to the number of hardware threads,
+next to inserting one tree into the other element by element
+*/
+
+typedef avl::Tree<long> LongTree;
+
+static void build(LongTree &first, LongTree &second, long n)
+{
+    std::vector<long> keys(n);
+    for (long i = 0; i < n; i++)
+    {
+        keys[i] = 2 * i;
+    }
+    first.assign(keys.begin(), keys.end());
+    for (long i = 0; i < n; i++)
+    {
+        keys[i] = 3 * i;
+    }
+    second.assign(keys.begin(), keys.end());
+}
+
+template <typename Operation>
+static double time_ms(long n, Operation operation)
+{
+    LongTree first, second;
+    build(first, second, n);
+    auto start = std::chrono::steady_clock::now();
+    operation(first, second);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+    long n = (argc > 1) ? std::atol(argv[1]) : 10000000;
+
+    double reinsert = time_ms(n, [](LongTree &first, LongTree &second) {
+        second.in_order_traversal([&](long key) {
+            try
+            {
+                first.insert(key);
+            }
+            catch (const LongTree::ElementAlreadyExistsException &)
+            {
+            }
+        });
+    });
+    std::printf("n = %ld, union by re-insertion: %.1f ms\n", n, reinsert);
+    std::printf("threads       union  intersection    difference   (ms)\n");
+
+    for (int threads = 1; threads <= avl::hardware_threads(); threads *= 2)
+    {
+        double set_union = time_ms(n, [=](LongTree &first, LongTree &second) { first.set_union(second, threads); });
+        double set_intersection = time_ms(n, [=](LongTree &first, LongTree &second) { first.set_intersection(second, threads); });
+        double set_difference = time_ms(n, [=](LongTree &first, LongTree &second) { first.set_difference(second, threads); });
+        std::printf("%7d  %10.1f  %12.1f  %12.1f\n", threads, set_union, set_intersection, set_difference);
+    }
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../AVLShardedTree.h"
+
+/*
+g++ -std=c++11 -O2 -DNDEBUG -pthread bench/sharded_throughput.cpp -o sharded_throughput.exe
+./sharded_throughput.exe [max threads]
+
+measures the throughput (million operations per second, all threads together) of random lookups, inserts and
+removes on 1, 2, 4... threads, for an avl::ShardedTree of 16 shards and for one avl::Tree behind a single
+reader-writer lock, with 90% and 50% lookups (the writes are half inserts, half removes). the sets start with
+half of the KEY_RANGE keys, inserted in increasing order, so the sharded tree spreads them over its shards online.
+it ends with the shard sizes after a skewed phase where every write goes to the upper end of the key range
+*/
+
+typedef std::chrono::steady_clock Clock;
+
+static const int KEY_RANGE = 2000000;
+static const int SHARDS = 16;
+static const double SECONDS = 0.5;
+
+// what the lookups found, so that the compiler can't drop them
+static std::atomic<long long> sink(0);
+
+struct LockedTree
+{
+    avl::Tree<int> tree;
+    mutable avl::SharedMutex lock;
+
+    bool contains(int key) const
+    {
+        avl::SharedLockGuard<avl::SharedMutex> guard(lock);
+        return tree.contains(key);
+    }
+    bool try_insert(int key)
+    {
+        std::lock_guard<avl::SharedMutex> guard(lock);
+        return tree.try_insert(key);
+    }
+    bool try_erase(int key)
+    {
+        std::lock_guard<avl::SharedMutex> guard(lock);
+        return tree.try_erase(key);
+    }
+};
+
+template <typename Set>
+static void fill(Set &set)
+{
+    for (int key = 0; key < KEY_RANGE; key += 2)
+    {
+        set.try_insert(key);
+    }
+}
+
+// runs the workload on `threads` threads for SECONDS and returns the million operations per second
+template <typename Set>
+static double run(Set &set, int threads, int lookup_percent)
+{
+    std::atomic<bool> start(false), stop(false);
+    std::atomic<long long> total(0);
+    std::vector<std::thread> workers;
+    for (int id = 0; id < threads; id++)
+    {
+        workers.emplace_back([&, id]() {
+            std::mt19937 rng(id + 1);
+            long long ops = 0, found = 0;
+            while (!start.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                for (int i = 0; i < 64; i++, ops++)
+                {
+                    int key = int(rng() % KEY_RANGE), kind = int(rng() % 100);
+                    if (kind < lookup_percent)
+                        found += set.contains(key);
+                    else if (kind % 2 == 0)
+                        found += set.try_insert(key);
+                    else
+                        found += set.try_erase(key);
+                }
+            }
+            total.fetch_add(ops);
+            sink.fetch_add(found, std::memory_order_relaxed);
+        });
+    }
+    auto begin = Clock::now();
+    start.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::duration<double>(SECONDS));
+    stop.store(true);
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    return total.load() / std::chrono::duration<double, std::micro>(Clock::now() - begin).count();
+}
+
+int main(int argc, char *argv[])
+{
+    int max_threads = (argc > 1) ? std::atoi(argv[1]) : std::max(8, 2 * avl::hardware_threads());
+
+    avl::ShardedTree<int> sharded(SHARDS);
+    LockedTree locked;
+    fill(sharded);
+    fill(locked);
+    std::printf("shards after filling in order:");
+    for (int i = 0; i < sharded.shard_count(); i++)
+    {
+        std::printf(" %d", sharded.shard_size(i));
+    }
+    std::printf("\n");
+
+    for (int lookup_percent : {90, 50})
+    {
+        std::printf("\n%d%% lookups      %12s %12s\n", lookup_percent, "sharded", "single lock");
+        for (int threads = 1; threads <= max_threads; threads *= 2)
+        {
+            double sharded_mops = run(sharded, threads, lookup_percent);
+            double locked_mops = run(locked, threads, lookup_percent);
+            std::printf("%3d threads      %8.2f Mop/s %8.2f Mop/s\n", threads, sharded_mops, locked_mops);
+        }
+    }
+
+    // every write lands in the last sixteenth of the key range
+    for (int key = KEY_RANGE - KEY_RANGE / 16 + 1; key < KEY_RANGE; key += 2)
+    {
+        sharded.try_insert(key);
+    }
+    std::printf("\nshards after a skewed phase:");
+    for (int i = 0; i < sharded.shard_count(); i++)
+    {
+        std::printf(" %d", sharded.shard_size(i));
+    }
+    std::printf("\n");
+    return 0;
+}
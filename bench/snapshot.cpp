@@ -0,0 +1,89 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../AVLTree.h"
+
+/*
+g++ -std=c++11 -O2 -DNDEBUG -pthread bench/snapshot.cpp -o snapshot.exe
+./snapshot.exe [elements, default 10000000] [file, default snapshot.bin]
+
+writes a tree of n random elements to a snapshot file and times the ways to get the tree back:
+inserting the elements one by one (what replaying a log does), reading the snapshot through a file descriptor,
+and mapping it (in place, and built into a tree with and without its shape)
+*/
+
+typedef avl::Tree<long> LongTree;
+
+template <typename Operation>
+static double time_ms(Operation operation)
+{
+    auto start = std::chrono::steady_clock::now();
+    operation();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+    long n = (argc > 1) ? std::atol(argv[1]) : 10000000;
+    const char *path = (argc > 2) ? argv[2] : "snapshot.bin";
+    const char *shaped_path = "snapshot_shape.bin";
+
+    std::vector<long> keys(n);
+    unsigned long long seed = 88172645463325252ull;
+    for (long i = 0; i < n; i++)
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        keys[i] = long(seed >> 1);
+    }
+    LongTree tree;
+    double replay = time_ms([&]() {
+        for (long key : keys)
+        {
+            tree.try_insert(key);
+        }
+    });
+
+    double write = 0;
+    for (int shape = 0; shape < 2; shape++)
+    {
+        int fd = ::open(shape ? shaped_path : path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+        write += time_ms([&]() { tree.write_snapshot(fd, shape == 1); });
+        ::close(fd);
+    }
+
+    LongTree read;
+    double read_fd = time_ms([&]() {
+        int fd = ::open(path, O_RDONLY);
+        read.read_snapshot(fd);
+        ::close(fd);
+    });
+    long probes = 0;
+    double mapped = time_ms([&]() {
+        avl::MappedSnapshot<long> snapshot(path);
+        probes = snapshot.contains(keys[0]) + snapshot.contains(keys[n / 2]);
+    });
+    LongTree balanced, shaped;
+    double build = time_ms([&]() { balanced.assign(avl::MappedSnapshot<long>(path)); });
+    double build_shape = time_ms([&]() { shaped.assign(avl::MappedSnapshot<long>(shaped_path)); });
+    if (read.size() != tree.size() || balanced.size() != tree.size() || shaped.size() != tree.size() || probes != 2)
+    {
+        std::printf("wrong result\n");
+        return 1;
+    }
+
+    std::printf("n = %ld\n", n);
+    std::printf("insert one by one        %10.1f ms\n", replay);
+    std::printf("write both snapshots     %10.1f ms\n", write);
+    std::printf("read_snapshot(fd)        %10.1f ms\n", read_fd);
+    std::printf("map in place + 2 lookups %10.1f ms\n", mapped);
+    std::printf("assign(mapped)           %10.1f ms\n", build);
+    std::printf("assign(mapped, shape)    %10.1f ms\n", build_shape);
+    std::remove(shaped_path);
+    return 0;
+}
@@ -17,7 +17,7 @@ avl::Comparison comp(const char& a, const char& b) {
 }
 
 int main(int argc, char* argv[]) {
-    avl::Tree<char, comp> tree_1;
+    avl::Tree<char, avl::FunctionCompare<char, comp>> tree_1;
 
     for(char letter = 'a'; letter <= 'z' ; ++letter)
     {
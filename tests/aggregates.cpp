@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <climits>
+#include <random>
+#include <set>
+#include <string>
+#include "../AVLTree.h"
+#include "check.h"
+
+// aggregate() and aggregate(low, high) with the built-in policies and an order-sensitive one against std::set,
+// and pruned_traversal() against a plain scan
+
+// combines the keys in order into a string, so an aggregate in the wrong order shows
+struct Concatenation
+{
+    typedef std::string value_type;
+    static value_type identity() { return std::string(); }
+    static value_type lift(const int &data) { return std::to_string(data) + ","; }
+    static value_type combine(const value_type &first, const value_type &second) { return first + second; }
+};
+
+typedef avl::Tree<int, avl::ThreeWayCompare<int>, avl::SlabAllocator, avl::SumAggregate<long long>> SumTree;
+typedef avl::Tree<int, avl::ThreeWayCompare<int>, avl::SlabAllocator, avl::MinAggregate<int>> MinTree;
+typedef avl::Tree<int, avl::ThreeWayCompare<int>, avl::SlabAllocator, avl::MaxAggregate<int>> MaxTree;
+typedef avl::Tree<int, avl::ThreeWayCompare<int>, avl::SlabAllocator, Concatenation> OrderTree;
+
+int main()
+{
+    std::mt19937 random(5);
+    SumTree sums;
+    MinTree minimums;
+    MaxTree maximums;
+    OrderTree order;
+    std::set<int> expected;
+    for (int i = 0; i < 4000; i++)
+    {
+        int key = int(random() % 2000) - 1000;
+        if (random() % 3 != 0)
+        {
+            bool inserted = expected.insert(key).second;
+            CHECK(sums.try_insert(key) == inserted && minimums.try_insert(key) == inserted);
+            CHECK(maximums.try_insert(key) == inserted && order.try_insert(key) == inserted);
+        }
+        else
+        {
+            bool erased = expected.erase(key) == 1;
+            CHECK(sums.try_erase(key) == erased && minimums.try_erase(key) == erased);
+            CHECK(maximums.try_erase(key) == erased && order.try_erase(key) == erased);
+        }
+        if (i % 100 != 0)
+        {
+            continue;
+        }
+        for (int low = -1100; low < 1100; low += 37)
+        {
+            int high = low + int(random() % 400);
+            long long sum = 0;
+            int minimum = INT_MAX, maximum = INT_MIN;
+            std::string keys;
+            for (auto it = expected.lower_bound(low); it != expected.end() && *it <= high; ++it)
+            {
+                sum += *it;
+                minimum = std::min(minimum, *it);
+                maximum = std::max(maximum, *it);
+                keys += std::to_string(*it) + ",";
+            }
+            CHECK(sums.aggregate(low, high) == sum);
+            CHECK(minimums.aggregate(low, high) == minimum && maximums.aggregate(low, high) == maximum);
+            CHECK(order.aggregate(low, high) == keys);
+            CHECK(sums.aggregate(high + 1, low) == 0); // an empty range gives the identity
+        }
+        std::string all;
+        long long total = 0;
+        for (int key : expected)
+        {
+            all += std::to_string(key) + ",";
+            total += key;
+        }
+        CHECK(order.aggregate() == all && sums.aggregate() == total);
+        CHECK(expected.empty() || (minimums.aggregate() == *expected.begin() && maximums.aggregate() == *expected.rbegin()));
+    }
+
+    // pruned_traversal() only skips the subtrees whose maximum is below the bound, it must still find every
+    // element at or above it, in order, up to high
+    for (int bound = -1000; bound < 1000; bound += 97)
+    {
+        std::string visited, scanned;
+        maximums.pruned_traversal(500, [bound](int maximum) { return maximum >= bound; }, [&visited](int key) {
+            visited += std::to_string(key) + ",";
+            return true;
+        });
+        for (auto it = expected.lower_bound(bound); it != expected.end() && *it <= 500; ++it)
+        {
+            scanned += std::to_string(*it) + ",";
+        }
+        CHECK(visited == scanned);
+    }
+    return 0;
+}
@@ -0,0 +1,52 @@
+#ifndef _AVL_TESTS_CHECK_H_
+#define _AVL_TESTS_CHECK_H_
+
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+// every test is a program of its own that stops at the first failed check with exit code 1
+#define CHECK(condition)                                                                   \
+    do                                                                                     \
+    {                                                                                      \
+        if (!(condition))                                                                  \
+        {                                                                                  \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            std::exit(1);                                                                  \
+        }                                                                                  \
+    } while (0)
+
+// the resident memory of the process in KiB, -1 where it isn't known
+inline long resident_kb()
+{
+#if defined(__linux__)
+    long pages = 0, resident = 0;
+    std::FILE *statm = std::fopen("/proc/self/statm", "r");
+    if (statm == nullptr)
+    {
+        return -1;
+    }
+    int read = std::fscanf(statm, "%ld %ld", &pages, &resident);
+    std::fclose(statm);
+    return (read == 2) ? resident * (sysconf(_SC_PAGESIZE) / 1024) : -1;
+#else
+    return -1;
+#endif
+}
+
+// checks that the resident memory grew by less than limit_kb since before (when it is known)
+#define CHECK_MEMORY_BOUNDED(before, limit_kb)                                             \
+    do                                                                                     \
+    {                                                                                      \
+        long after = resident_kb();                                                        \
+        if ((before) >= 0 && after >= 0 && after - (before) >= (limit_kb))                 \
+        {                                                                                  \
+            std::fprintf(stderr, "%s:%d: memory grew from %ld to %ld KiB\n", __FILE__, __LINE__, long(before), after); \
+            std::exit(1);                                                                  \
+        }                                                                                  \
+    } while (0)
+
+#endif // _AVL_TESTS_CHECK_H_
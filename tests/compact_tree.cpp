@@ -0,0 +1,100 @@
+#include <random>
+#include <set>
+#include <vector>
+#include "../AVLCompactTree.h"
+#include "check.h"
+
+// CompactTree against std::set through random updates (the balance factors packed into the child indices go
+// through every rotation), and its removed nodes are reused rather than added to the arena
+
+typedef avl::CompactTree<int> Tree;
+
+static bool same(const Tree &tree, const std::set<int> &expected)
+{
+    std::vector<int> elements, reversed;
+    tree.in_order_traversal([&elements](int key) { elements.push_back(key); });
+    tree.reverse_in_order_traversal([&reversed](int key) { reversed.push_back(key); });
+    return tree.size() == int(expected.size()) && elements == std::vector<int>(expected.begin(), expected.end()) &&
+           reversed == std::vector<int>(expected.rbegin(), expected.rend()) &&
+           (expected.empty() || (tree.getMin() == *expected.begin() && tree.getMax() == *expected.rbegin()));
+}
+
+int main()
+{
+    CHECK(Tree::node_size() == sizeof(int) + 8);
+    std::mt19937 random(9);
+    Tree tree;
+    std::set<int> expected;
+    for (int round = 0; round < 20; round++)
+    {
+        for (int i = 0; i < 2000; i++)
+        {
+            int key = int(random() % 3000);
+            if (random() % 2 == 0 && expected.insert(key).second)
+            {
+                tree.insert(key);
+            }
+            else if (random() % 2 == 0 && expected.erase(key) == 1)
+            {
+                tree.remove(key);
+            }
+        }
+        CHECK(same(tree, expected));
+        for (int key = 0; key < 3000; key += 7)
+        {
+            bool found = true;
+            try
+            {
+                CHECK(tree.find(key) == key);
+            }
+            catch (const Tree::NoSuchElementException &)
+            {
+                found = false;
+            }
+            CHECK(found == (expected.count(key) == 1));
+        }
+    }
+
+    // sorted insertions only ever rotate the same way
+    tree.clear();
+    expected.clear();
+    CHECK(tree.isEmpty() && same(tree, expected));
+    for (int key = 0; key < 10000; key++)
+    {
+        tree.insert(key);
+        expected.insert(key);
+    }
+    CHECK(same(tree, expected));
+    std::size_t memory = tree.memory_usage();
+    for (int key = 0; key < 10000; key += 2)
+    {
+        tree.remove(key);
+    }
+    for (int key = 0; key < 10000; key += 2)
+    {
+        tree.insert(key);
+    }
+    CHECK(same(tree, expected) && tree.memory_usage() == memory);
+
+    bool thrown = false;
+    try
+    {
+        tree.insert(5);
+    }
+    catch (const Tree::ElementAlreadyExistsException &)
+    {
+        thrown = true;
+    }
+    CHECK(thrown && same(tree, expected));
+    thrown = false;
+    try
+    {
+        tree.remove(10000);
+    }
+    catch (const Tree::NoSuchElementException &)
+    {
+        thrown = true;
+    }
+    CHECK(thrown && same(tree, expected));
+    return 0;
+}
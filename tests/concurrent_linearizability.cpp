@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "../AVLConcurrentTree.h"
+#include "check.h"
+
+/*
+checks avl::ConcurrentTree under contention, on a bounded number of threads and operations so that it stays short:
+ - stress: every thread inserts, removes and looks up keys that only it writes (so it knows the answers) and
+   keys that every thread writes, while another thread traverses the tree. every traversal must be in order and
+   visit all the keys that nobody writes. afterwards every key must be found exactly when its thread left it in,
+   the size and a traversal must agree, and the tree must be an AVL tree
+ - linearizability: in many short rounds, the threads run random operations on a few shared keys and record
+   when each one started and ended (tickets of one global counter). the history of every key must then have a
+   linearization, an order of its operations that respects their real time order (an operation that ended
+   before another one started comes first) and gives the same results on a sequential set. the search goes
+   through the operations that can come next, with the sets of the operations already placed that were seen
+   (Wing and Gong, with the memoization of Lowe)
+*/
+
+const int THREADS = 4, ROUNDS = 300;
+
+// a barrier for the threads of the rounds, they spin (yielding) instead of sleeping because rounds are short
+class Barrier
+{
+public:
+    explicit Barrier(int count) : __count(count), __waiting(0), __generation(0) {}
+
+    void wait()
+    {
+        int generation = __generation.load(std::memory_order_acquire);
+        if (__waiting.fetch_add(1) + 1 == __count)
+        {
+            __waiting.store(0, std::memory_order_relaxed);
+            __generation.fetch_add(1, std::memory_order_release);
+            return;
+        }
+        while (__generation.load(std::memory_order_acquire) == generation)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    int __count;
+    std::atomic<int> __waiting;
+    std::atomic<int> __generation;
+};
+
+static void stress(int threads)
+{
+    const int OWNED = 1 << 12, HOT = 64, STABLE = 1024, OPERATIONS = 20000;
+    avl::ConcurrentTree<int> tree;
+    // the keys below 0 stay in the tree
+    for (int key = -STABLE; key < 0; key++)
+    {
+        tree.insert(key);
+    }
+    std::atomic<bool> stop(false);
+    std::atomic<long long> scanned(0);
+    std::vector<std::vector<char>> present(threads, std::vector<char>(OWNED, 0));
+    std::vector<int> local_failures(threads, 0);
+    std::vector<std::thread> workers;
+    for (int id = 0; id < threads; id++)
+    {
+        workers.emplace_back([&, id]() {
+            std::mt19937 rng(id + 1);
+            std::vector<char> &mine = present[id];
+            for (int i = 0; i < OPERATIONS; i++)
+            {
+                // thread id owns the keys k with k % threads == id
+                int key = int(rng() % (OWNED / threads)) * threads + id, kind = int(rng() % 8);
+                bool correct = true;
+                if (kind < 2)
+                {
+                    correct = tree.try_insert(key) == !mine[key];
+                    mine[key] = 1;
+                }
+                else if (kind < 4)
+                {
+                    correct = tree.try_erase(key) == (mine[key] == 1);
+                    mine[key] = 0;
+                }
+                else if (kind < 6)
+                {
+                    correct = tree.contains(key) == (mine[key] == 1);
+                }
+                else
+                {
+                    int hot = OWNED + int(rng() % HOT);
+                    (kind == 6) ? tree.try_insert(hot) : tree.try_erase(hot);
+                }
+                local_failures[id] += !correct;
+            }
+        });
+    }
+    std::thread scanner([&]() {
+        while (!stop.load())
+        {
+            long long last = -STABLE - 1;
+            int stable = 0;
+            tree.in_order_traversal([&](int key) {
+                if (key <= last)
+                {
+                    scanned.store(-1);
+                }
+                last = key;
+                stable += (key < 0);
+            });
+            if (stable != STABLE)
+            {
+                scanned.store(-1);
+            }
+            if (scanned.load() >= 0)
+            {
+                scanned.fetch_add(1);
+            }
+        }
+    });
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    stop.store(true);
+    scanner.join();
+
+    for (int id = 0; id < threads; id++)
+    {
+        CHECK(local_failures[id] == 0);
+    }
+    CHECK(scanned.load() >= 0);
+    int expected = STABLE, missing = 0;
+    for (int id = 0; id < threads; id++)
+    {
+        for (int key = id; key < OWNED; key += threads)
+        {
+            expected += present[id][key];
+            missing += tree.contains(key) != (present[id][key] == 1);
+        }
+    }
+    CHECK(missing == 0);
+    for (int hot = OWNED; hot < OWNED + HOT; hot++)
+    {
+        expected += tree.contains(hot);
+    }
+    CHECK(tree.size() == expected);
+    int visited = 0;
+    tree.in_order_traversal([&](int) { visited++; });
+    CHECK(visited == expected);
+    avl::TreeShapeReport report = tree.tree_shape_report();
+    CHECK(report.unbalanced == 0);
+}
+
+enum Kind
+{
+    INSERT,
+    ERASE,
+    CONTAINS
+};
+
+struct Operation
+{
+    long long invoked, returned;
+    Kind kind;
+    bool result;
+};
+
+// the state of the key after op from state, false if op can't have returned its result from state
+static bool apply(const Operation &op, bool &state)
+{
+    bool result = (op.kind == INSERT) ? !state : state;
+    if (result != op.result)
+    {
+        return false;
+    }
+    if (op.kind != CONTAINS)
+    {
+        state = (op.kind == INSERT);
+    }
+    return true;
+}
+
+// whether the operations not in done can follow, from state
+static bool linearizable(const std::vector<Operation> &history, unsigned long long done, bool state, std::unordered_set<unsigned long long> &seen)
+{
+    int count = int(history.size());
+    unsigned long long all = (count == 64) ? ~0ULL : (1ULL << count) - 1;
+    if (done == all)
+    {
+        return true;
+    }
+    if (!seen.insert(done * 2 + state).second)
+    {
+        return false;
+    }
+    // an operation can come next if no operation left ended before it started
+    long long first_return = -1;
+    for (int i = 0; i < count; i++)
+    {
+        if ((done >> i & 1) == 0 && (first_return < 0 || history[i].returned < first_return))
+        {
+            first_return = history[i].returned;
+        }
+    }
+    for (int i = 0; i < count; i++)
+    {
+        bool next_state = state;
+        if ((done >> i & 1) == 0 && history[i].invoked < first_return && apply(history[i], next_state) &&
+            linearizable(history, done | (1ULL << i), next_state, seen))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void linearizability(int threads, int rounds)
+{
+    // at most 63 operations per key with the final state (the search tracks them in a bit set, next to the state)
+    const int KEYS = 4, OPERATIONS = std::max(1, std::min(8, 62 / threads));
+    avl::ConcurrentTree<int> tree;
+    // a populated tree, so that the rounds run through rotations and routing nodes
+    for (int key = 0; key < 4096; key += 3)
+    {
+        tree.insert(key * 1000);
+    }
+    std::atomic<long long> clock(0);
+    std::vector<std::vector<std::vector<Operation>>> histories(threads, std::vector<std::vector<Operation>>(KEYS));
+    Barrier barrier(threads + 1);
+    std::vector<std::thread> workers;
+    for (int id = 0; id < threads; id++)
+    {
+        workers.emplace_back([&, id]() {
+            std::mt19937 rng(id + 1);
+            for (int round = 0; round < rounds; round++)
+            {
+                barrier.wait();
+                for (int i = 0; i < OPERATIONS; i++)
+                {
+                    int index = int(rng() % KEYS), key = round * KEYS + index;
+                    // the keys of a round sit between the populated keys, the same in every round
+                    key = (key % 4096) * 1000 + 1 + key / 4096 % 999;
+                    Operation op;
+                    op.kind = Kind(rng() % 3);
+                    op.invoked = clock.fetch_add(1);
+                    op.result = (op.kind == INSERT) ? tree.try_insert(key) : (op.kind == ERASE) ? tree.try_erase(key) : tree.contains(key);
+                    op.returned = clock.fetch_add(1);
+                    histories[id][index].push_back(op);
+                }
+                barrier.wait();
+            }
+        });
+    }
+    for (int round = 0; round < rounds; round++)
+    {
+        barrier.wait();
+        barrier.wait();
+        for (int index = 0; index < KEYS; index++)
+        {
+            std::vector<Operation> history;
+            for (int id = 0; id < threads; id++)
+            {
+                history.insert(history.end(), histories[id][index].begin(), histories[id][index].end());
+                histories[id][index].clear();
+            }
+            // every key of a round is new, remove it for the next round that maps to the same key
+            int key = round * KEYS + index;
+            key = (key % 4096) * 1000 + 1 + key / 4096 % 999;
+            bool state = tree.contains(key);
+            tree.try_erase(key);
+            // the final state is one more operation, after all the others
+            history.push_back(Operation{clock.fetch_add(1), clock.fetch_add(1), CONTAINS, state});
+            std::unordered_set<unsigned long long> seen;
+            bool correct = linearizable(history, 0, false, seen);
+            if (!correct)
+            {
+                std::fprintf(stderr, "round %d key %d has no linearization:\n", round, key);
+                for (const Operation &op : history)
+                {
+                    const char *names[] = {"insert", "erase", "contains"};
+                    std::fprintf(stderr, "  [%lld, %lld] %s -> %d\n", op.invoked, op.returned, names[op.kind], op.result);
+                }
+            }
+            CHECK(correct);
+        }
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    CHECK(tree.tree_shape_report().unbalanced == 0);
+}
+
+int main()
+{
+    stress(THREADS);
+    linearizability(THREADS, ROUNDS);
+    return 0;
+}
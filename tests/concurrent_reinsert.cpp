@@ -0,0 +1,92 @@
+#include <thread>
+#include <vector>
+#include "../AVLConcurrentTree.h"
+#include "check.h"
+
+// an element removed from a node with two children leaves a routing node, inserting an equal element again must
+// store the new element rather than bring the old one back
+
+struct Entry
+{
+    int key;
+    int value;
+};
+
+struct ByKey
+{
+    bool operator()(const Entry &left, const Entry &right) const { return left.key < right.key; }
+};
+
+typedef avl::ConcurrentTree<Entry, ByKey> Tree;
+
+static int value_of(const Tree &tree, int key)
+{
+    int value = -1;
+    tree.in_order_traversal([&](const Entry &entry) {
+        if (entry.key == key)
+        {
+            value = entry.value;
+        }
+    });
+    return value;
+}
+
+int main()
+{
+    Tree tree;
+    for (int key : {4, 2, 6, 1, 3, 5, 7})
+    {
+        tree.insert(Entry{key, 0});
+    }
+    // 2, 4 and 6 have two children each, they become routing nodes
+    for (int key : {2, 4, 6})
+    {
+        tree.remove(Entry{key, 0});
+        CHECK(!tree.contains(Entry{key, 0}));
+    }
+    for (int key : {2, 4, 6})
+    {
+        CHECK(tree.try_insert(Entry{key, key * 10}));
+        CHECK(!tree.try_insert(Entry{key, -1}));
+    }
+    CHECK(tree.size() == 7 && tree.tree_shape_report().size == 7);
+    for (int key = 1; key <= 7; key++)
+    {
+        CHECK(value_of(tree, key) == (key % 2 == 0 ? key * 10 : 0));
+    }
+
+    // the same under contention: every thread removes and inserts its own keys again with a new value each round
+    const int THREADS = 4, KEYS = 2048, ROUNDS = 50;
+    Tree shared;
+    for (int key = 0; key < KEYS; key++)
+    {
+        shared.insert(Entry{key, 0});
+    }
+    std::vector<std::thread> workers;
+    for (int id = 0; id < THREADS; id++)
+    {
+        workers.emplace_back([&, id]() {
+            for (int round = 1; round <= ROUNDS; round++)
+            {
+                for (int key = id; key < KEYS; key += THREADS)
+                {
+                    shared.remove(Entry{key, 0});
+                    shared.insert(Entry{key, round});
+                }
+            }
+        });
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    int count = 0;
+    bool latest = true;
+    shared.in_order_traversal([&](const Entry &entry) {
+        latest = latest && entry.value == ROUNDS;
+        count++;
+    });
+    CHECK(latest && count == KEYS && shared.size() == KEYS);
+    CHECK(shared.tree_shape_report().unbalanced == 0);
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include <functional>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include "../AVLTree.h"
+#include "check.h"
+
+// FrozenTree against std::set for both layouts: the blocks of arithmetic elements (int, double) and the
+// Eytzinger layout (strings, a comparator of its own), at sizes around the block boundaries where the padding is
+
+template <typename Frozen, typename T, typename Less>
+static void check(const Frozen &frozen, const std::set<T, Less> &expected, const std::vector<T> &probes)
+{
+    std::vector<T> elements, reversed;
+    frozen.in_order_traversal([&elements](const T &data) { elements.push_back(data); });
+    frozen.reverse_in_order_traversal([&reversed](const T &data) { reversed.push_back(data); });
+    CHECK(frozen.size() == int(expected.size()) && frozen.isEmpty() == expected.empty());
+    CHECK(elements == std::vector<T>(expected.begin(), expected.end()));
+    CHECK(reversed == std::vector<T>(expected.rbegin(), expected.rend()));
+    CHECK(expected.empty() || (frozen.getMin() == *expected.begin() && frozen.getMax() == *expected.rbegin()));
+    for (const T &probe : probes)
+    {
+        bool present = expected.count(probe) == 1;
+        CHECK(frozen.contains(probe) == present);
+        bool found = true;
+        try
+        {
+            CHECK(frozen.find(probe) == probe);
+        }
+        catch (const typename Frozen::NoSuchElementException &)
+        {
+            found = false;
+        }
+        CHECK(found == present);
+    }
+}
+
+int main()
+{
+    std::mt19937 random(10);
+    for (int size : {0, 1, 2, 15, 16, 17, 255, 272, 273, 289, 1000, 4913, 5000})
+    {
+        std::set<int> keys;
+        while (int(keys.size()) < size)
+        {
+            keys.insert(int(random() % 100000) * 2); // only even keys, the odd ones fall between them
+        }
+        std::vector<int> probes = {-1, 0, 199999, 200000, 200001};
+        for (int i = 0; i < 2000; i++)
+        {
+            probes.push_back(int(random() % 200002) - 1);
+        }
+        probes.insert(probes.end(), keys.begin(), keys.end());
+
+        avl::Tree<int> tree(keys.begin(), keys.end());
+        check(tree.freeze(), keys, probes);
+
+        std::set<double> doubles;
+        std::vector<double> double_probes;
+        for (int key : keys)
+        {
+            doubles.insert(key / 4.0);
+        }
+        for (int probe : probes)
+        {
+            double_probes.push_back(probe / 4.0);
+        }
+        check(avl::FrozenTree<double>(doubles.begin(), doubles.end()), doubles, double_probes);
+
+        std::set<int, std::greater<int>> descending(keys.begin(), keys.end());
+        check(avl::FrozenTree<int, std::greater<int>>(descending.begin(), descending.end()), descending, probes);
+
+        if (size <= 1000)
+        {
+            std::set<std::string> strings;
+            std::vector<std::string> string_probes;
+            for (int key : keys)
+            {
+                strings.insert(std::to_string(key));
+            }
+            for (int probe : probes)
+            {
+                string_probes.push_back(std::to_string(probe));
+            }
+            check(avl::FrozenTree<std::string>(strings.begin(), strings.end()), strings, string_probes);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include "../AVLTree.h"
+#include "check.h"
+
+// insert_batch() inserts small batches one by one and merges the large ones with set_union(), both have to
+// skip the keys already in the tree and the duplicates inside the batch
+
+template <typename Tree, typename T>
+static bool same(const Tree &tree, const std::set<T> &expected)
+{
+    return tree.size() == int(expected.size()) && std::equal(tree.begin(), tree.end(), expected.begin());
+}
+
+int main()
+{
+    std::mt19937 random(11);
+    avl::Tree<int> tree;
+    std::set<int> expected;
+    for (int key = 0; key < 20000; key += 3)
+    {
+        tree.insert(key);
+        expected.insert(key);
+    }
+    for (int size : {0, 1, 5, 60, 100, 5000, 30000})
+    {
+        std::vector<int> batch;
+        for (int i = 0; i < size; i++)
+        {
+            batch.push_back(int(random() % 40000));
+        }
+        if (size > 1)
+        {
+            batch.push_back(batch.front()); // a duplicate inside the batch
+        }
+        int inserted = 0;
+        for (int key : batch)
+        {
+            inserted += expected.insert(key).second;
+        }
+        CHECK(tree.insert_batch(batch) == inserted);
+        CHECK(same(tree, expected));
+
+        std::sort(batch.begin(), batch.end());
+        batch.erase(std::unique(batch.begin(), batch.end()), batch.end());
+        CHECK(tree.insert_batch(batch.begin(), batch.end()) == 0); // sorted, all in the tree already
+    }
+
+    avl::Tree<std::string> words;
+    std::set<std::string> expected_words;
+    for (int i = 0; i < 1000; i++)
+    {
+        words.insert(std::to_string(i));
+        expected_words.insert(std::to_string(i));
+    }
+    std::vector<std::string> batch = {"zz", "5", "aa", "zz", "1000"};
+    CHECK(words.insert_batch(batch) == 3);
+    expected_words.insert(batch.begin(), batch.end());
+    CHECK(same(words, expected_words));
+    CHECK(batch[0] == "zz" && batch[3] == "zz"); // the batch is copied, not moved from
+    return 0;
+}
@@ -0,0 +1,33 @@
+#include <limits>
+#include "../AVLIntervalTree.h"
+#include "check.h"
+
+// the overlap queries must not need a value of T past every interval, infinite endpoints are the largest values
+
+static int stabbed(const avl::IntervalTree<double> &tree, double point)
+{
+    int count = 0;
+    tree.stab(point, [&](const avl::Interval<double> &) { count++; return true; });
+    return count;
+}
+
+int main()
+{
+    const double INF = std::numeric_limits<double>::infinity();
+    avl::IntervalTree<double> tree;
+    tree.insert(5.0, INF);
+    tree.insert(1.0, 7.0);
+    CHECK(stabbed(tree, 5.0) == 2);
+    CHECK(stabbed(tree, 8.0) == 1 && stabbed(tree, INF) == 1 && stabbed(tree, 0.0) == 0);
+
+    tree.insert(INF, INF);
+    tree.insert(-INF, -INF);
+    tree.insert(-INF, 2.0);
+    CHECK(stabbed(tree, INF) == 2 && stabbed(tree, -INF) == 2 && stabbed(tree, 1.5) == 2);
+    int count = 0;
+    tree.find_overlapping(6.0, INF, [&](const avl::Interval<double> &) { count++; return true; });
+    CHECK(count == 3);
+    const avl::Interval<double> *found = tree.find_any_overlapping(100.0, INF);
+    CHECK(found != nullptr && found->low == 5.0 && found->high == INF);
+    return 0;
+}
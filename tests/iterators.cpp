@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <set>
+#include <vector>
+#include "../AVLTree.h"
+#include "check.h"
+
+// the iterators, lower_bound(), upper_bound(), equal_range() and range_traversal() against std::set
+
+int main()
+{
+    std::mt19937 random(6);
+    avl::Tree<int> tree;
+    std::set<int> expected;
+    CHECK(tree.begin() == tree.end() && tree.rbegin() == tree.rend());
+    for (int i = 0; i < 3000; i++)
+    {
+        int key = int(random() % 4000);
+        CHECK(tree.try_insert(key) == expected.insert(key).second);
+        if (i % 4 == 0)
+        {
+            key = int(random() % 4000);
+            CHECK(tree.try_erase(key) == (expected.erase(key) == 1));
+        }
+    }
+
+    CHECK(std::equal(tree.begin(), tree.end(), expected.begin()));
+    CHECK(std::equal(tree.rbegin(), tree.rend(), expected.rbegin()));
+    CHECK(int(std::distance(tree.begin(), tree.end())) == int(expected.size()));
+    CHECK(*std::prev(tree.end()) == *expected.rbegin()); // decrementing end() gives the maximum
+    auto it = tree.end();
+    for (auto reference = expected.rbegin(); reference != expected.rend(); ++reference)
+    {
+        CHECK(*--it == *reference);
+    }
+    CHECK(it == tree.begin());
+
+    for (int key = -1; key <= 4001; key++)
+    {
+        auto lower = tree.lower_bound(key), upper = tree.upper_bound(key);
+        auto expected_lower = expected.lower_bound(key), expected_upper = expected.upper_bound(key);
+        CHECK((lower == tree.end()) == (expected_lower == expected.end()));
+        CHECK(lower == tree.end() || *lower == *expected_lower);
+        CHECK((upper == tree.end()) == (expected_upper == expected.end()));
+        CHECK(upper == tree.end() || *upper == *expected_upper);
+        auto range = tree.equal_range(key);
+        CHECK(range.first == lower && range.second == upper);
+        CHECK(int(std::distance(range.first, range.second)) == int(expected.count(key)));
+    }
+
+    for (int low = -10; low < 4000; low += 71)
+    {
+        int high = low + int(random() % 300);
+        std::vector<int> visited, scanned(expected.lower_bound(low), expected.upper_bound(high));
+        tree.range_traversal(low, high, [&visited](int key) {
+            visited.push_back(key);
+            return true;
+        });
+        CHECK(visited == scanned);
+        // the scan stops once do_something returns false
+        int calls = 0;
+        tree.range_traversal(low, high, [&calls](int) { return ++calls < 3; });
+        CHECK(calls == std::min(3, int(scanned.size())));
+    }
+
+    // only the iterators to removed elements are invalidated
+    auto kept = tree.lower_bound(2000);
+    int value = *kept;
+    for (int key = 0; key < 4000; key++)
+    {
+        if (key != value)
+        {
+            tree.try_erase(key);
+        }
+    }
+    CHECK(*kept == value && tree.begin() == kept && std::next(kept) == tree.end());
+    return 0;
+}
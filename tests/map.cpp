@@ -0,0 +1,118 @@
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "../AVLMap.h"
+#include "check.h"
+
+// avl::Map against std::map, and its lookups and try_emplace() / operator[] never build a value for a key that
+// is already in the map
+
+// counts the values built, copied or moved
+struct Counted
+{
+    static int constructed;
+    int value;
+
+    Counted() : value(0) { constructed++; }
+    explicit Counted(int v) : value(v) { constructed++; }
+    Counted(const Counted &other) : value(other.value) { constructed++; }
+    Counted(Counted &&other) : value(other.value) { constructed++; }
+    Counted &operator=(const Counted &other) = default;
+};
+int Counted::constructed = 0;
+
+typedef avl::Map<std::string, int> StringMap;
+
+static bool same(const StringMap &map, const std::map<std::string, int> &expected)
+{
+    if (map.size() != int(expected.size()))
+    {
+        return false;
+    }
+    auto reference = expected.begin();
+    for (auto it = map.begin(); it != map.end(); ++it, ++reference)
+    {
+        if (it->first != reference->first || it->second != reference->second)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    std::mt19937 random(13);
+    StringMap map;
+    std::map<std::string, int> expected;
+    for (int i = 0; i < 5000; i++)
+    {
+        std::string key = std::to_string(random() % 1000);
+        int value = int(random() % 100);
+        switch (random() % 5)
+        {
+        case 0:
+            CHECK(map.insert_or_assign(key, value) == (expected.count(key) == 0));
+            expected[key] = value;
+            break;
+        case 1:
+            CHECK(map.try_emplace(key, value) == expected.insert(std::make_pair(key, value)).second);
+            break;
+        case 2:
+            map[key] += value;
+            expected[key] += value;
+            break;
+        case 3:
+            CHECK(map.try_erase(key) == (expected.erase(key) == 1));
+            break;
+        default:
+            CHECK(map.contains(key) == (expected.count(key) == 1));
+            CHECK((map.try_find(key) == nullptr) == (expected.count(key) == 0));
+            CHECK(map.try_find(key) == nullptr || *map.try_find(key) == expected[key]);
+        }
+    }
+    CHECK(same(map, expected));
+    for (auto &entry : expected)
+    {
+        CHECK(map.find(entry.first) == entry.second);
+    }
+    auto lower = map.lower_bound("5"), upper = map.upper_bound("5");
+    CHECK(lower == map.end() ? expected.lower_bound("5") == expected.end() : lower->first == expected.lower_bound("5")->first);
+    CHECK(upper == map.end() ? expected.upper_bound("5") == expected.end() : upper->first == expected.upper_bound("5")->first);
+
+    // the values can be changed in a traversal, the keys stay
+    map.in_order_traversal([](const std::string &, int &value) { value = -value; });
+    for (auto &entry : expected)
+    {
+        entry.second = -entry.second;
+    }
+    CHECK(same(map, expected));
+
+    bool thrown = false;
+    try
+    {
+        map.remove("missing");
+    }
+    catch (const StringMap::NoSuchElementException &)
+    {
+        thrown = true;
+    }
+    CHECK(thrown && same(map, expected));
+    map.clear();
+    CHECK(map.isEmpty() && map.begin() == map.end());
+
+    avl::Map<int, Counted> counted;
+    counted[1].value = 10;
+    CHECK(counted.try_emplace(2, 20));
+    int before = Counted::constructed;
+    counted[1].value++;
+    CHECK(!counted.try_emplace(2, 30) && counted.find(2).value == 20);
+    CHECK(counted.contains(1) && counted.try_find(3) == nullptr && counted.find(1).value == 11);
+    CHECK(Counted::constructed == before);
+    std::string moved = "stays";
+    avl::Map<int, std::string> strings;
+    strings.try_emplace(1, "one");
+    CHECK(!strings.try_emplace(1, std::move(moved)) && moved == "stays" && strings.find(1) == "one");
+    return 0;
+}
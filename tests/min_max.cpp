@@ -0,0 +1,121 @@
+#include <random>
+#include <set>
+#include <vector>
+#include "../AVLTree.h"
+#include "check.h"
+
+// the exception-free lookups and updates against std::set, and getMin() / getMax(), which are kept up to date
+// instead of searched, after every kind of change to the tree
+
+typedef avl::Tree<int> Tree;
+
+static bool bounds(const Tree &tree, const std::set<int> &expected)
+{
+    if (expected.empty())
+    {
+        bool thrown_min = false, thrown_max = false;
+        try
+        {
+            tree.getMin();
+        }
+        catch (const Tree::NoSuchElementException &)
+        {
+            thrown_min = true;
+        }
+        try
+        {
+            tree.getMax();
+        }
+        catch (const Tree::NoSuchElementException &)
+        {
+            thrown_max = true;
+        }
+        return tree.isEmpty() && thrown_min && thrown_max;
+    }
+    return tree.size() == int(expected.size()) && tree.getMin() == *expected.begin() && tree.getMax() == *expected.rbegin() &&
+           *tree.begin() == *expected.begin() && *tree.rbegin() == *expected.rbegin();
+}
+
+int main()
+{
+    std::mt19937 random(15);
+    Tree tree;
+    std::set<int> expected;
+    CHECK(bounds(tree, expected) && !tree.contains(0) && tree.try_find(0) == nullptr && !tree.try_erase(0));
+    for (int i = 0; i < 20000; i++)
+    {
+        // a narrow range, so that the minimum and the maximum themselves are often removed
+        int key = int(random() % 200);
+        if (random() % 2 == 0)
+        {
+            CHECK(tree.try_insert(key) == expected.insert(key).second);
+        }
+        else
+        {
+            CHECK(tree.try_erase(key) == (expected.erase(key) == 1));
+        }
+        CHECK(tree.contains(key) == (expected.count(key) == 1));
+        const int *found = tree.try_find(key);
+        CHECK((found == nullptr) == (expected.count(key) == 0) && (found == nullptr || *found == key));
+        CHECK(bounds(tree, expected));
+    }
+
+    // the other ways in and out of the tree
+    std::vector<int> keys;
+    for (int key = 0; key < 1000; key++)
+    {
+        keys.push_back(key);
+    }
+    tree.assign(keys.begin(), keys.end());
+    expected = std::set<int>(keys.begin(), keys.end());
+    CHECK(bounds(tree, expected));
+
+    tree.remove(0);
+    tree.remove(999);
+    tree.extract(1);
+    expected.erase(0);
+    expected.erase(999);
+    expected.erase(1);
+    CHECK(bounds(tree, expected));
+
+    CHECK(tree.erase_range(0, 10) == 9 && tree.erase_range(990, 2000) == 9);
+    expected.erase(expected.begin(), expected.upper_bound(10));
+    expected.erase(expected.lower_bound(990), expected.end());
+    CHECK(bounds(tree, expected));
+
+    Tree greater;
+    tree.split(500, greater);
+    std::set<int> smaller(expected.begin(), expected.lower_bound(500)), larger(expected.upper_bound(500), expected.end());
+    CHECK(bounds(tree, smaller) && bounds(greater, larger));
+    tree.join(tree, 500, greater);
+    CHECK(bounds(tree, expected) && bounds(greater, std::set<int>()));
+
+    Tree range = tree.extract_range(11, 100);
+    CHECK(bounds(range, std::set<int>(expected.begin(), expected.upper_bound(100))));
+    expected.erase(expected.begin(), expected.upper_bound(100));
+    CHECK(bounds(tree, expected));
+    tree.set_union(range);
+    for (int key = 11; key <= 100; key++)
+    {
+        expected.insert(key);
+    }
+    CHECK(bounds(tree, expected) && bounds(range, std::set<int>()));
+
+    tree.relax_balance();
+    for (int key = 11; key < 300; key++)
+    {
+        tree.remove(key);
+        expected.erase(key);
+        CHECK(bounds(tree, expected));
+    }
+    tree.insert(-5);
+    expected.insert(-5);
+    CHECK(bounds(tree, expected));
+    tree.rebalance();
+    CHECK(bounds(tree, expected));
+
+    tree.clear();
+    expected.clear();
+    CHECK(bounds(tree, expected));
+    return 0;
+}
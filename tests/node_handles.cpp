@@ -0,0 +1,127 @@
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../AVLTree.h"
+#include "check.h"
+
+// move-only elements, emplace() without temporaries, moving and swapping whole trees, and node handles that
+// carry an element out of one tree into another (rekeyed on the way) without copying it
+
+// an element that can only be moved, and counts how often one was built
+struct Item
+{
+    static int built;
+    int key;
+    std::unique_ptr<std::string> payload;
+
+    Item(int k, const std::string &text) : key(k), payload(new std::string(text)) { built++; }
+    Item(Item &&other) = default;
+    Item &operator=(Item &&other) = default;
+};
+int Item::built = 0;
+
+struct ByKey
+{
+    typedef void is_transparent;
+    bool operator()(const Item &left, const Item &right) const { return left.key < right.key; }
+    bool operator()(const Item &left, int right) const { return left.key < right; }
+    bool operator()(int left, const Item &right) const { return left < right.key; }
+};
+
+typedef avl::Tree<Item, ByKey> Tree;
+
+static std::vector<int> keys(const Tree &tree)
+{
+    std::vector<int> result;
+    for (const Item &item : tree)
+    {
+        result.push_back(item.key);
+    }
+    return result;
+}
+
+int main()
+{
+    Tree tree;
+    for (int key = 0; key < 100; key++)
+    {
+        tree.emplace(key, std::to_string(key));
+    }
+    CHECK(Item::built == 100);
+    tree.insert(Item(100, "100"));
+    CHECK(Item::built == 101 && tree.size() == 101);
+    bool thrown = false;
+    try
+    {
+        tree.emplace(5, "again");
+    }
+    catch (const Tree::ElementAlreadyExistsException &)
+    {
+        thrown = true;
+    }
+    CHECK(thrown && tree.size() == 101 && *tree.find(5).payload == "5" && Item::built == 102);
+
+    // a handle takes the element out with its node, the element can be rekeyed and inserted elsewhere
+    Tree::NodeHandle handle = tree.extract(7);
+    CHECK(!handle.isEmpty() && handle.value().key == 7 && !tree.contains(7) && tree.size() == 100);
+    const std::string *payload = handle.value().payload.get();
+    handle.value().key = 1007;
+    Tree other;
+    other.insert(std::move(handle));
+    CHECK(handle.isEmpty() && other.size() == 1 && other.find(1007).payload.get() == payload);
+
+    // a failed insertion leaves the handle as it was
+    handle = tree.extract(8);
+    handle.value().key = 9;
+    thrown = false;
+    try
+    {
+        tree.insert(std::move(handle));
+    }
+    catch (const Tree::ElementAlreadyExistsException &)
+    {
+        thrown = true;
+    }
+    CHECK(thrown && !handle.isEmpty() && handle.value().key == 9);
+    handle.value().key = 8;
+    tree.insert(std::move(handle));
+    CHECK(tree.contains(8) && *tree.find(8).payload == "8");
+    thrown = false;
+    try
+    {
+        tree.extract(1000);
+    }
+    catch (const Tree::NoSuchElementException &)
+    {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    // a handle outlives the tree its node came from, and an element never inserted again goes with its handle
+    Tree::NodeHandle survivor;
+    {
+        Tree temporary;
+        temporary.emplace(1, "one");
+        temporary.emplace(2, "two");
+        survivor = temporary.extract(2);
+        Tree::NodeHandle dropped = temporary.extract(1);
+    }
+    other.insert(std::move(survivor));
+    CHECK(*other.find(2).payload == "two" && keys(other) == std::vector<int>({2, 1007}));
+
+    // moving and swapping whole trees
+    std::vector<int> before = keys(tree);
+    Tree moved(std::move(tree));
+    CHECK(tree.isEmpty() && tree.begin() == tree.end() && keys(moved) == before);
+    tree = std::move(other);
+    CHECK(other.isEmpty() && keys(tree) == std::vector<int>({2, 1007}));
+    tree.swap(moved);
+    CHECK(keys(tree) == before && keys(moved) == std::vector<int>({2, 1007}));
+    tree.emplace(-1, "minus one");
+    moved.emplace(3, "three");
+    CHECK(tree.getMin().key == -1 && moved.getMin().key == 2 && moved.getMax().key == 1007);
+    CHECK(Item::built == 106); // the handles and the moves built none
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <iterator>
+#include <random>
+#include <set>
+#include <vector>
+#include "../AVLTree.h"
+#include "check.h"
+
+// select(), rank(), count_less(), count_in_range() and median() against the positions in a std::set, through
+// insertions and removals that rotate the nodes whose sizes they read
+
+int main()
+{
+    std::mt19937 random(4);
+    avl::Tree<int> tree;
+    std::set<int> expected;
+    for (int round = 0; round < 20; round++)
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            int key = int(random() % 5000);
+            if (random() % 3 != 0)
+            {
+                CHECK(tree.try_insert(key) == expected.insert(key).second);
+            }
+            else
+            {
+                CHECK(tree.try_erase(key) == (expected.erase(key) == 1));
+            }
+        }
+        std::vector<int> sorted(expected.begin(), expected.end());
+        for (int k = 0; k < int(sorted.size()); k++)
+        {
+            CHECK(tree.select(k) == sorted[k]);
+            CHECK(tree.rank(sorted[k]) == k);
+        }
+        CHECK(tree.median() == sorted[(sorted.size() - 1) / 2]);
+        for (int key = -1; key <= 5000; key += 13)
+        {
+            int less = int(std::distance(expected.begin(), expected.lower_bound(key)));
+            CHECK(tree.count_less(key) == less);
+            int high = key + int(random() % 200);
+            CHECK(tree.count_in_range(key, high) == int(std::distance(expected.lower_bound(key), expected.upper_bound(high))));
+            CHECK(tree.count_in_range(high, key - 1) == 0);
+        }
+    }
+
+    // out of range and missing elements throw
+    bool thrown = false;
+    try
+    {
+        tree.select(tree.size());
+    }
+    catch (const avl::Tree<int>::NoSuchElementException &)
+    {
+        thrown = true;
+    }
+    CHECK(thrown);
+    thrown = false;
+    try
+    {
+        tree.rank(5001);
+    }
+    catch (const avl::Tree<int>::NoSuchElementException &)
+    {
+        thrown = true;
+    }
+    CHECK(thrown);
+    return 0;
+}
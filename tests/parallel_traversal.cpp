@@ -0,0 +1,106 @@
+#include <atomic>
+#include <string>
+#include <vector>
+#include "../AVLTree.h"
+#include "check.h"
+
+// parallel_for_each() visits every element once, parallel_reduce() combines in order (with a combine that
+// isn't commutative) and parallel_for_each_ordered() delivers in order, on trees below and far above the size
+// that is split between threads, and in relaxed balance mode where the subtree sizes are stale
+
+// the first and the last element of a range and whether the range is sorted, combining them isn't commutative
+struct Run
+{
+    int first, last;
+    bool sorted, empty;
+};
+
+static Run combine(const Run &left, const Run &right)
+{
+    if (left.empty)
+    {
+        return right;
+    }
+    if (right.empty)
+    {
+        return left;
+    }
+    return Run{left.first, right.last, left.sorted && right.sorted && left.last < right.first, false};
+}
+
+static void check(const avl::Tree<int> &tree, const std::vector<int> &expected, int threads)
+{
+    std::vector<std::atomic<int>> visits(expected.empty() ? 1 : expected.back() + 1);
+    for (auto &count : visits)
+    {
+        count.store(0);
+    }
+    tree.parallel_for_each([&visits](int key) { visits[key].fetch_add(1); }, threads);
+    int visited = 0;
+    for (int key : expected)
+    {
+        CHECK(visits[key].load() == 1);
+        visited += visits[key].load();
+    }
+    CHECK(visited == int(expected.size()));
+
+    long long sum = tree.parallel_reduce(0LL, [](int key) { return (long long)key; },
+                                         [](long long a, long long b) { return a + b; }, threads);
+    long long expected_sum = 0;
+    for (int key : expected)
+    {
+        expected_sum += key;
+    }
+    CHECK(sum == expected_sum);
+    Run run = tree.parallel_reduce(Run{0, 0, true, true}, [](int key) { return Run{key, key, true, false}; }, combine, threads);
+    CHECK(run.empty == expected.empty());
+    CHECK(expected.empty() || (run.sorted && run.first == expected.front() && run.last == expected.back()));
+
+    std::vector<std::string> delivered;
+    tree.parallel_for_each_ordered([](int key) { return std::to_string(key); },
+                                   [&delivered](const std::string &text) { delivered.push_back(text); }, threads);
+    CHECK(delivered.size() == expected.size());
+    for (int i = 0; i < int(expected.size()); i++)
+    {
+        CHECK(delivered[i] == std::to_string(expected[i]));
+    }
+}
+
+int main()
+{
+    for (int size : {0, 1, 100, 100000})
+    {
+        std::vector<int> keys;
+        for (int key = 0; key < size; key++)
+        {
+            keys.push_back(key * 3);
+        }
+        avl::Tree<int> tree(keys.begin(), keys.end());
+        for (int threads : {1, 2, 8})
+        {
+            check(tree, keys, threads);
+        }
+    }
+
+    // in relaxed balance mode the tasks are cut on stale sizes, they must still cover the tree exactly once
+    std::vector<int> keys;
+    avl::Tree<int> tree;
+    tree.relax_balance();
+    for (int key = 0; key < 60000; key++)
+    {
+        tree.insert(key);
+        if (key % 3 == 0)
+        {
+            keys.push_back(key);
+        }
+    }
+    for (int key = 0; key < 60000; key++)
+    {
+        if (key % 3 != 0)
+        {
+            tree.remove(key);
+        }
+    }
+    check(tree, keys, 8);
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+#include "../AVLPersistentTree.h"
+#include "check.h"
+
+// every snapshot of a PersistentTree keeps the content it had when it was taken whatever happens to the tree
+// afterwards, and can be read from other threads while the tree is written
+
+typedef avl::PersistentTree<int> Tree;
+
+static bool same(const Tree &tree, const std::set<int> &expected)
+{
+    std::vector<int> elements, reversed;
+    tree.in_order_traversal([&elements](int key) { elements.push_back(key); });
+    tree.reverse_in_order_traversal([&reversed](int key) { reversed.push_back(key); });
+    return tree.size() == int(expected.size()) && elements == std::vector<int>(expected.begin(), expected.end()) &&
+           reversed == std::vector<int>(expected.rbegin(), expected.rend()) &&
+           (expected.empty() || (tree.getMin() == *expected.begin() && tree.getMax() == *expected.rbegin()));
+}
+
+int main()
+{
+    std::mt19937 random(8);
+    Tree tree;
+    std::set<int> expected;
+    std::vector<Tree> versions;
+    std::vector<std::set<int>> expected_versions;
+    for (int round = 0; round < 50; round++)
+    {
+        for (int i = 0; i < 100; i++)
+        {
+            int key = int(random() % 1000);
+            if (random() % 3 != 0 && expected.insert(key).second)
+            {
+                tree.insert(key);
+            }
+            else if (expected.erase(key) == 1)
+            {
+                tree.remove(key);
+            }
+        }
+        versions.push_back(tree.snapshot());
+        expected_versions.push_back(expected);
+    }
+    CHECK(same(tree, expected));
+    for (int i = 0; i < int(versions.size()); i++)
+    {
+        CHECK(same(versions[i], expected_versions[i]));
+    }
+
+    // a copy is a version of its own, writing to it leaves the original alone
+    Tree copy = versions[10];
+    copy.clear();
+    copy.insert(-5);
+    CHECK(same(versions[10], expected_versions[10]) && copy.size() == 1 && copy.contains(-5));
+
+    bool thrown = false;
+    try
+    {
+        tree.insert(*expected.begin());
+    }
+    catch (const Tree::ElementAlreadyExistsException &)
+    {
+        thrown = true;
+    }
+    CHECK(thrown && same(tree, expected));
+    thrown = false;
+    try
+    {
+        tree.remove(-1);
+    }
+    catch (const Tree::NoSuchElementException &)
+    {
+        thrown = true;
+    }
+    CHECK(thrown && same(tree, expected));
+
+    // readers go through a snapshot without locks while the writer keeps changing the tree
+    const Tree snapshot = tree.snapshot();
+    const std::set<int> frozen = expected;
+    std::vector<int> failures(4, 0);
+    std::vector<std::thread> readers;
+    for (int id = 0; id < 4; id++)
+    {
+        readers.emplace_back([&, id]() {
+            for (int pass = 0; pass < 20; pass++)
+            {
+                failures[id] += !same(snapshot, frozen);
+                for (int key = 0; key < 1000; key++)
+                {
+                    failures[id] += snapshot.contains(key) != (frozen.count(key) == 1);
+                }
+            }
+        });
+    }
+    for (int i = 0; i < 20000; i++)
+    {
+        int key = int(random() % 1000);
+        if (expected.insert(key).second)
+        {
+            tree.insert(key);
+        }
+        else
+        {
+            expected.erase(key);
+            tree.remove(key);
+        }
+    }
+    for (auto &reader : readers)
+    {
+        reader.join();
+    }
+    for (int failed : failures)
+    {
+        CHECK(failed == 0);
+    }
+    CHECK(same(tree, expected) && same(snapshot, frozen));
+    return 0;
+}
@@ -0,0 +1,40 @@
+#include "../AVLTree.h"
+#include "check.h"
+
+// the tree returned by extract_range() shares the node pool of its source, dropping it must give its nodes back
+// to the source instead of keeping them with the pool
+
+int main()
+{
+    const int SIZE = 100000, ROUNDS = 200, LOW = SIZE / 4, HIGH = 3 * SIZE / 4;
+    avl::Tree<int> tree;
+    for (int key = 0; key < SIZE; key++)
+    {
+        tree.insert(key);
+    }
+    long before = resident_kb();
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        CHECK(tree.extract_range(LOW, HIGH - 1).size() == HIGH - LOW);
+        CHECK(tree.size() == SIZE - (HIGH - LOW));
+        for (int key = LOW; key < HIGH; key++)
+        {
+            tree.insert(key);
+        }
+    }
+    // a leak keeps half of the tree per round, 200 rounds of 50000 nodes
+    CHECK_MEMORY_BOUNDED(before, 16 * 1024);
+
+    // the extracted tree outlives more changes of its source, and the other way around
+    avl::Tree<int> middle = tree.extract_range(LOW, HIGH - 1);
+    for (int key = 0; key < LOW; key++)
+    {
+        tree.remove(key);
+    }
+    middle.insert(-1);
+    CHECK(middle.size() == HIGH - LOW + 1 && middle.getMin() == -1 && middle.getMax() == HIGH - 1);
+    tree.clear();
+    middle.erase_range(LOW, LOW + 99);
+    CHECK(middle.size() == HIGH - LOW - 99 && tree.isEmpty());
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include <iterator>
+#include <vector>
+#include "../AVLTree.h"
+#include "check.h"
+
+// in relaxed balance mode the subtree sizes are stale until rebalance(), the size of the tree must not be read
+// off the root meanwhile
+
+static int counted(const avl::Tree<int> &tree)
+{
+    return int(std::distance(tree.begin(), tree.end()));
+}
+
+int main()
+{
+    avl::Tree<int> tree;
+    tree.relax_balance();
+    for (int key = 0; key < 1000; key++)
+    {
+        tree.insert(2 * key);
+    }
+    // a small batch goes in one by one, one of its keys is already in the tree
+    std::vector<int> batch = {1, 3, 2001, 0};
+    CHECK(tree.insert_batch(batch.begin(), batch.end()) == 3);
+    CHECK(tree.size() == 1003 && counted(tree) == 1003);
+    CHECK(tree.getMin() == 0 && tree.getMax() == 2001);
+    tree.rebalance();
+    CHECK(tree.size() == 1003 && counted(tree) == 1003);
+
+    // a large batch is merged with set_union()
+    std::vector<int> large;
+    for (int key = 0; key < 1000; key++)
+    {
+        tree.insert(4000 + key);
+        large.push_back(5 + 2 * key);
+    }
+    CHECK(tree.insert_batch(large.begin(), large.end()) == 999); // 2001 is already in
+    CHECK(tree.size() == 3002 && counted(tree) == 3002);
+    tree.rebalance();
+    CHECK(tree.size() == 3002 && counted(tree) == 3002);
+    return 0;
+}
@@ -0,0 +1,38 @@
+#include <iterator>
+#include "../AVLTree.h"
+#include "check.h"
+
+// with ChainedKeys count() reads the length of a chain off the subtree sizes, which are stale in relaxed balance
+// mode until rebalance()
+
+typedef avl::Tree<int, avl::ThreeWayCompare<int>, avl::SlabAllocator, avl::NoAggregate, avl::NoStats, avl::ChainedKeys> Multiset;
+
+int main()
+{
+    const int COPIES = 2000;
+    Multiset tree;
+    tree.relax_balance();
+    for (int key = 0; key < 100; key++)
+    {
+        tree.insert(key);
+    }
+    for (int i = 0; i < COPIES; i++)
+    {
+        tree.insert(50);
+    }
+    CHECK(tree.count(50) == COPIES + 1 && tree.count(49) == 1 && tree.count(100) == 0);
+    CHECK(tree.erase_all(50) == COPIES + 1);
+    CHECK(tree.size() == 99 && int(std::distance(tree.begin(), tree.end())) == 99);
+    CHECK(tree.count(50) == 0 && tree.count(51) == 1);
+
+    for (int i = 0; i < COPIES; i++)
+    {
+        tree.insert(7);
+    }
+    tree.rebalance();
+    CHECK(tree.count(7) == COPIES + 1);
+    tree.insert(7);
+    CHECK(tree.count(7) == COPIES + 2 && tree.erase_all(7) == COPIES + 2);
+    CHECK(tree.size() == 98 && int(std::distance(tree.begin(), tree.end())) == 98);
+    return 0;
+}
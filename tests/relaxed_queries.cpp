@@ -0,0 +1,90 @@
+#include <iterator>
+#include <random>
+#include <set>
+#include <vector>
+#include "../AVLTree.h"
+#include "check.h"
+
+// in relaxed balance mode the sizes and aggregates of the marked nodes are stale until rebalance(), the order
+// statistics and the aggregates must not read them
+
+typedef avl::Tree<int, avl::ThreeWayCompare<int>, avl::SlabAllocator, avl::SumAggregate<long long>> SumTree;
+typedef avl::Tree<int, avl::ThreeWayCompare<int>, avl::SlabAllocator, avl::MaxAggregate<int>> MaxTree;
+
+static void check_queries(const SumTree &tree, const std::set<int> &expected)
+{
+    std::vector<int> sorted(expected.begin(), expected.end());
+    for (int k = 0; k < int(sorted.size()); k += 7)
+    {
+        CHECK(tree.select(k) == sorted[k]);
+        CHECK(tree.rank(sorted[k]) == k);
+    }
+    CHECK(tree.median() == sorted[(sorted.size() - 1) / 2]);
+    long long total = 0;
+    for (int key : sorted)
+    {
+        total += key;
+    }
+    CHECK(tree.aggregate() == total);
+    for (int low = -50; low < 10050; low += 997)
+    {
+        int high = low + 1500;
+        auto first = expected.lower_bound(low), last = expected.upper_bound(high);
+        long long sum = 0;
+        for (auto it = first; it != last; ++it)
+        {
+            sum += *it;
+        }
+        CHECK(tree.count_less(low) == int(std::distance(expected.begin(), first)));
+        CHECK(tree.count_in_range(low, high) == int(std::distance(first, last)));
+        CHECK(tree.aggregate(low, high) == sum);
+    }
+}
+
+int main()
+{
+    std::mt19937 random(7);
+    SumTree tree;
+    std::set<int> expected;
+    for (int key = 0; key < 10000; key += 2)
+    {
+        tree.insert(key);
+        expected.insert(key);
+    }
+    tree.relax_balance();
+    for (int round = 0; round < 5; round++)
+    {
+        for (int i = 0; i < 2000; i++)
+        {
+            int key = int(random() % 10000);
+            if (random() % 2 == 0)
+            {
+                CHECK(tree.try_insert(key) == expected.insert(key).second);
+            }
+            else
+            {
+                CHECK(tree.try_erase(key) == (expected.erase(key) == 1));
+            }
+        }
+        check_queries(tree, expected);
+    }
+    tree.rebalance();
+    check_queries(tree, expected);
+
+    // a subtree whose stale maximum is too small must still be visited
+    MaxTree intervals;
+    for (int key = 0; key < 1000; key++)
+    {
+        intervals.insert(key);
+    }
+    intervals.relax_balance();
+    for (int key = 1000; key < 1200; key++)
+    {
+        intervals.insert(key);
+    }
+    CHECK(intervals.aggregate() == 1199);
+    int visited = 0;
+    intervals.pruned_traversal(2000, [](int max) { return max >= 1100; }, [&visited](int key) { visited += (key >= 1100); return true; });
+    CHECK(visited == 100);
+    return 0;
+}
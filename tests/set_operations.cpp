@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <set>
+#include <vector>
+#include "../AVLTree.h"
+#include "check.h"
+
+// split(), join() and the parallel set operations against std::set and the <algorithm> set operations, the
+// results must be AVL trees with the right sizes
+
+typedef avl::Tree<int> Tree;
+
+static std::set<int> random_set(std::mt19937 &random, int count, int range)
+{
+    std::set<int> result;
+    for (int i = 0; i < count; i++)
+    {
+        result.insert(int(random() % range));
+    }
+    return result;
+}
+
+static bool same(const Tree &tree, const std::set<int> &expected)
+{
+    return tree.size() == int(expected.size()) && std::equal(tree.begin(), tree.end(), expected.begin()) &&
+           tree.tree_shape_report().unbalanced == 0 && (expected.empty() || tree.getMin() == *expected.begin()) &&
+           (expected.empty() || tree.getMax() == *expected.rbegin());
+}
+
+int main()
+{
+    std::mt19937 random(7);
+
+    // split at keys inside, outside and at both ends of the tree, then join the halves back
+    std::set<int> expected = random_set(random, 5000, 20000);
+    Tree tree(expected.begin(), expected.end());
+    for (int key : {-1, *expected.begin(), 7777, *expected.rbegin(), 20001})
+    {
+        Tree greater;
+        bool present = expected.count(key) == 1;
+        CHECK(tree.split(key, greater) == present);
+        std::set<int> smaller(expected.begin(), expected.lower_bound(key)), larger(expected.upper_bound(key), expected.end());
+        CHECK(same(tree, smaller) && same(greater, larger));
+        if (key >= 0 && key <= 20000)
+        {
+            tree.join(tree, key, greater);
+            expected.insert(key);
+        }
+        else
+        { // one of the halves is empty
+            CHECK(tree.isEmpty() || greater.isEmpty());
+            if (tree.isEmpty())
+            {
+                tree.swap(greater);
+            }
+        }
+        CHECK(same(tree, expected) && greater.isEmpty());
+    }
+
+    // joins of trees of very different heights
+    for (int left_size : {0, 1, 10, 3000})
+    {
+        for (int right_size : {0, 1, 10, 3000})
+        {
+            std::vector<int> left_keys, right_keys;
+            for (int i = 0; i < left_size; i++)
+            {
+                left_keys.push_back(i);
+            }
+            for (int i = 0; i < right_size; i++)
+            {
+                right_keys.push_back(left_size + 1 + i);
+            }
+            Tree left(left_keys.begin(), left_keys.end()), right(right_keys.begin(), right_keys.end()), joined;
+            joined.join(left, left_size, right);
+            std::set<int> all;
+            for (int i = 0; i <= left_size + right_size; i++)
+            {
+                all.insert(i);
+            }
+            CHECK(same(joined, all) && left.isEmpty() && right.isEmpty());
+        }
+    }
+
+    // the set operations, sequential and on several threads, of sets of different sizes and overlaps
+    for (int threads : {1, 4})
+    {
+        for (int other_size : {0, 10, 1000, 8000})
+        {
+            std::set<int> first = random_set(random, 5000, 16000), second = random_set(random, other_size, 16000);
+            std::set<int> united, common, difference;
+            std::set_union(first.begin(), first.end(), second.begin(), second.end(), std::inserter(united, united.end()));
+            std::set_intersection(first.begin(), first.end(), second.begin(), second.end(), std::inserter(common, common.end()));
+            std::set_difference(first.begin(), first.end(), second.begin(), second.end(), std::inserter(difference, difference.end()));
+
+            Tree a(first.begin(), first.end()), b(second.begin(), second.end());
+            a.set_union(b, threads);
+            CHECK(same(a, united) && b.isEmpty());
+            Tree c(first.begin(), first.end()), d(second.begin(), second.end());
+            c.set_intersection(d, threads);
+            CHECK(same(c, common) && d.isEmpty());
+            Tree e(first.begin(), first.end()), f(second.begin(), second.end());
+            e.set_difference(f, threads);
+            CHECK(same(e, difference) && f.isEmpty());
+            // the trees share their pools now, they must stay usable after the others are gone
+            a.insert(-1);
+            CHECK(a.contains(-1) && a.size() == int(united.size()) + 1);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include <vector>
+#include "../AVLShardedTree.h"
+#include "check.h"
+
+// check_neighbours() reads the sizes of the shards without their locks, by the time rebalance_pair() holds them
+// the shard that should give elements away may have been emptied by other threads
+
+namespace avl
+{
+    struct ShardedTreeTest
+    {
+        template <typename Tree>
+        static bool rebalance_pair(Tree &tree, int shard, int count) { return tree.rebalance_pair(shard, count); }
+    };
+};
+
+typedef avl::ShardedTree<int> Tree;
+
+static std::vector<int> elements(const Tree &tree)
+{
+    std::vector<int> all;
+    tree.in_order_traversal([&](int key) { all.push_back(key); });
+    return all;
+}
+
+int main()
+{
+    // the right shard is empty, nothing moves (in either direction)
+    Tree tree(std::vector<int>{100});
+    for (int key = 0; key < 10; key++)
+    {
+        tree.insert(key);
+    }
+    CHECK(!avl::ShardedTreeTest::rebalance_pair(tree, 0, -5));
+    CHECK(tree.shard_size(0) == 10 && tree.shard_size(1) == 0);
+    tree.insert(150);
+    CHECK(tree.contains(150) && tree.shard_size(1) == 1);
+
+    // a right shard with one element keeps it
+    CHECK(!avl::ShardedTreeTest::rebalance_pair(tree, 0, -5));
+    CHECK(tree.shard_size(0) == 10 && tree.shard_size(1) == 1);
+
+    // both shards are empty
+    Tree empty(std::vector<int>{100});
+    CHECK(!avl::ShardedTreeTest::rebalance_pair(empty, 0, -5));
+    CHECK(!avl::ShardedTreeTest::rebalance_pair(empty, 0, 5));
+    CHECK(empty.isEmpty() && empty.try_insert(5) && empty.try_insert(500));
+
+    // the inactive shards of a tree built with a number of shards stay inactive
+    Tree spreading(4);
+    for (int key = 0; key < 10; key++)
+    {
+        spreading.insert(key);
+    }
+    CHECK(!avl::ShardedTreeTest::rebalance_pair(spreading, 0, -3));
+    CHECK(spreading.shard_size(0) == 10 && spreading.shard_size(1) == 0);
+
+    // and a move that is still possible goes through, with fewer elements than asked for
+    CHECK(avl::ShardedTreeTest::rebalance_pair(tree, 0, 20));
+    CHECK(tree.shard_size(0) == 0 && tree.shard_size(1) == 11);
+    CHECK(avl::ShardedTreeTest::rebalance_pair(tree, 0, -20));
+    CHECK(tree.shard_size(0) == 10 && tree.shard_size(1) == 1);
+    std::vector<int> expected = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 150};
+    CHECK(elements(tree) == expected);
+    for (int key : expected)
+    {
+        CHECK(tree.contains(key));
+    }
+    return 0;
+}
@@ -0,0 +1,34 @@
+#include "../AVLShardedTree.h"
+#include "check.h"
+
+// a window of keys sliding up through a sharded tree keeps moving elements from one shard to the other, the
+// shards must reuse the nodes they hand over instead of piling them up
+
+int main()
+{
+    const int WINDOW = 20000, STEPS = 2000000;
+    avl::ShardedTree<int> tree(2);
+    for (int key = 0; key < WINDOW; key++)
+    {
+        tree.insert(key);
+    }
+    long before = resident_kb();
+    for (int key = WINDOW; key < WINDOW + STEPS; key++)
+    {
+        tree.insert(key);
+        tree.remove(key - WINDOW);
+    }
+    CHECK(tree.size() == WINDOW);
+    CHECK(tree.shard_size(0) > 0 && tree.shard_size(1) > 0);
+    // a leak keeps every node that moved between the shards, about one per key
+    CHECK_MEMORY_BOUNDED(before, 16 * 1024);
+
+    int expected = STEPS, visited = 0;
+    bool in_order = true;
+    tree.in_order_traversal([&](int key) {
+        in_order = in_order && key == expected++;
+        visited++;
+    });
+    CHECK(in_order && visited == WINDOW);
+    return 0;
+}
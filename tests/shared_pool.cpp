@@ -0,0 +1,41 @@
+#include "../AVLTree.h"
+#include "check.h"
+
+// trees that exchanged nodes share a node pool, a tree that is cleared or destroyed while the pool is still
+// shared has to give its slots back instead of dropping them with the pool
+
+int main()
+{
+    const int SIZE = 100000, ROUNDS = 200;
+    avl::Tree<int> tree;
+    for (int key = 0; key < SIZE; key++)
+    {
+        tree.insert(key);
+    }
+    long before = resident_kb();
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        {
+            avl::Tree<int> greater;
+            tree.split(SIZE / 2, greater);
+        }
+        for (int key = SIZE / 2; key < SIZE; key++)
+        {
+            tree.insert(key);
+        }
+        CHECK(tree.size() == SIZE);
+    }
+    // a leak keeps half of the tree per round, 200 rounds of 50000 nodes
+    CHECK_MEMORY_BOUNDED(before, 16 * 1024);
+
+    // clear() of one of two sharing trees, then the other one still works
+    avl::Tree<int> greater;
+    tree.split(SIZE / 2, greater);
+    greater.clear();
+    for (int key = SIZE / 2; key < SIZE; key++)
+    {
+        tree.insert(key);
+    }
+    CHECK(tree.size() == SIZE && greater.isEmpty());
+    return 0;
+}
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../AVLTree.h"
+#include "check.h"
+
+// snapshots written to a stream and to a file, read back element by element or mapped, with and without the
+// shape, against std::set. broken snapshots throw SnapshotException and leave nothing half read behind
+
+struct Point
+{
+    int x, y;
+    bool operator<(const Point &other) const { return x < other.x || (x == other.x && y < other.y); }
+    bool operator>(const Point &other) const { return other < *this; }
+    bool operator==(const Point &other) const { return x == other.x && y == other.y; }
+};
+
+typedef avl::Tree<Point> Tree;
+
+static bool same(const Tree &tree, const std::set<Point> &expected)
+{
+    return tree.size() == int(expected.size()) && std::equal(tree.begin(), tree.end(), expected.begin()) &&
+           tree.tree_shape_report().unbalanced == 0 &&
+           (expected.empty() || (tree.getMin() == *expected.begin() && tree.getMax() == *expected.rbegin()));
+}
+
+static bool same_shape(const Tree &first, const Tree &second)
+{
+    avl::TreeShapeReport a = first.tree_shape_report(), b = second.tree_shape_report();
+    return a.height == b.height && a.average_depth == b.average_depth && a.left_heavy == b.left_heavy &&
+           a.right_heavy == b.right_heavy;
+}
+
+template <typename Function>
+static bool throws(Function function)
+{
+    try
+    {
+        function();
+    }
+    catch (const avl::SnapshotException &)
+    {
+        return true;
+    }
+    return false;
+}
+
+int main()
+{
+    std::mt19937 random(17);
+    // more elements than fit in the buffer of the writers and readers at once
+    for (int size : {0, 1, 1000, 30000})
+    {
+        std::set<Point> expected;
+        Tree tree;
+        while (int(expected.size()) < size)
+        { // random insertions leave a shape that a perfectly balanced build wouldn't have
+            Point point = {int(random() % 100000), int(random() % 10)};
+            if (expected.insert(point).second)
+            {
+                tree.insert(point);
+            }
+        }
+        for (bool keep_shape : {false, true})
+        {
+            std::stringstream stream;
+            tree.write_snapshot(stream, keep_shape);
+            Tree copy;
+            copy.insert(Point{-1, -1}); // replaced by the snapshot
+            copy.read_snapshot(stream);
+            CHECK(same(copy, expected));
+        }
+    }
+
+    std::set<Point> expected;
+    Tree tree;
+    for (int i = 0; i < 20000; i++)
+    {
+        Point point = {int(random() % 50000), 0};
+        if (expected.insert(point).second)
+        {
+            tree.insert(point);
+        }
+    }
+#ifdef AVL_HAS_MMAP
+    char path[] = "/tmp/avl_snapshot_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    for (bool keep_shape : {false, true})
+    {
+        CHECK(ftruncate(fd, 0) == 0 && lseek(fd, 0, SEEK_SET) == 0);
+        tree.write_snapshot(fd, keep_shape);
+        avl::MappedSnapshot<Point> mapped(path);
+        CHECK(mapped.size() == int(expected.size()) && std::equal(mapped.begin(), mapped.end(), expected.begin()));
+        CHECK((mapped.heights() != nullptr) == keep_shape);
+        CHECK(mapped.contains(*expected.begin()) && !mapped.contains(Point{-1, 0}));
+        Tree loaded;
+        loaded.assign(mapped);
+        CHECK(same(loaded, expected));
+        CHECK(!keep_shape || same_shape(loaded, tree)); // the shape that was written comes back
+
+        CHECK(lseek(fd, 0, SEEK_SET) == 0);
+        Tree read;
+        read.read_snapshot(fd);
+        CHECK(same(read, expected));
+    }
+    // a tree with another order sorts a mapped snapshot first, like assign()
+    avl::Tree<Point, std::greater<Point>> descending;
+    descending.assign(avl::MappedSnapshot<Point, std::greater<Point>>(path));
+    CHECK(descending.size() == int(expected.size()) && std::equal(descending.begin(), descending.end(), expected.rbegin()));
+    close(fd);
+    std::remove(path);
+    CHECK(throws([]() { avl::MappedSnapshot<Point> missing("/nonexistent/avl_snapshot"); }));
+#endif
+
+    std::stringstream written;
+    tree.write_snapshot(written, true);
+    const std::string bytes = written.str();
+
+    // read_snapshot() only takes elements sorted by the comparator of the tree
+    std::stringstream unsorted(bytes);
+    avl::Tree<Point, std::greater<Point>> other;
+    CHECK(throws([&]() { other.read_snapshot(unsorted); }));
+
+    std::string broken = bytes;
+    broken[0] = 'X'; // the magic
+    std::stringstream bad_magic(broken);
+    Tree target;
+    CHECK(throws([&]() { target.read_snapshot(bad_magic); }));
+    std::stringstream truncated(bytes.substr(0, bytes.size() / 2));
+    CHECK(throws([&]() { target.read_snapshot(truncated); }));
+    std::stringstream wrong_type(bytes);
+    avl::Tree<long long> longs;
+    CHECK(throws([&]() { longs.read_snapshot(wrong_type); }));
+    CHECK(target.isEmpty() && longs.isEmpty());
+    return 0;
+}